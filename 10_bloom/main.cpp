@@ -1,11 +1,22 @@
 #include "../common/baseApp.hpp"
+#include "../common/brdfLUT.hpp"
 #include "../common/flyThroughCamera.hpp"
+#include "../common/frameGraph.hpp"
+#include "../common/gaussianKernel.hpp"
+#include "../common/geometryArena.hpp"
 #include "../common/objParser.hpp"
+#include "../common/programReflection.hpp"
+#include "../common/programVariants.hpp"
 #include "../common/texture.hpp"
-#include "../common/renderbuffer.hpp"
 #include "../common/framebuffer.hpp"
+#include "../common/uniformRing.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
 #include <fstream>
+#include <future>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -13,7 +24,11 @@
 #define WINDOW_WIDTH 1366
 #define WINDOW_HEIGHT 768
 
-#define N_ENVIRONMENTS 1
+#define N_ENVIRONMENTS 3
+
+// Environments being decoded ahead of the one being convolved
+#define N_ENVIRONMENT_DECODERS 2
+
 #define N_MATERIAL_TEXTURES 5
 
 #define FBO_ENV_WIDTH 512
@@ -21,8 +36,59 @@
 #define FBO_SPEC_WIDTH 128
 #define FBO_SPEC_HEIGHT 128
 
+// Keeps the prefiltered environments as octahedral maps in R11F_G11F_B10F
+// texture arrays, one layer per environment, instead of RGB16F cube maps.
+// The cube maps are still rendered, but only as an intermediate step
+#define COMPACT_ENVIRONMENTS 1
+#define OCT_ENV_SIZE 1024
+#define OCT_IRR_SIZE 256
+#define OCT_SPEC_SIZE 256
+
+// Environment, irradiance and specular arrays go in
+// this unit and the two following ones
+#define OCT_TEXTURE_UNIT 9
+
+// Uniform block binding points, hardcoded in the shaders as well
+#define FRAME_BLOCK_BINDING 0
+#define VIEW_BLOCK_BINDING 1
+#define OBJECT_BLOCK_BINDING 2
+#define MATERIAL_BLOCK_BINDING 3
+
+// Bytes of uniform blocks pushed per frame
+#define UNIFORM_RING_FRAME_SIZE 4096
+
+// Every static mesh is sub-allocated from one vertex and one index buffer
+#define GEOMETRY_ARENA_VERTEX_BYTES (32 << 20)
+#define GEOMETRY_ARENA_INDICES (4 << 20)
+
+// Levels of the bloom mip chain, the first being half the window
+// size. The chain is shorter when the window is too small for it
+#define BLOOM_LEVELS 6
+#define BLOOM_MAX_LEVELS 8
+
+// The Gaussian blur runs at a fraction of the window size
+#define BLUR_DOWNSCALE 8
+
+// Texels blurred by a workgroup of the compute blur, and the largest
+// radius it supports. Both are defined in its shader by the application
+#define BLUR_TILE_SIZE 128
+#define BLUR_MAX_RADIUS 32
+
+// Fetches per side of the fragment blur at the largest radius, with
+// pairs of texels merged by linear filtering. Defined in its shader
+#define BLUR_MAX_TAPS (BLUR_MAX_RADIUS / 2 + 1)
+
 #define BRDF_LUT_WIDTH 512
 #define BRDF_LUT_HEIGHT 512
+#define BRDF_LUT_SAMPLES 1024
+#define BRDF_LUT_CACHE "cache/brdfLUT.bin"
+
+#define PROGRAM_CACHE "cache/programs"
+
+// Renders the LUT with the brdfConvolution shaders as
+// well and compares it against the CPU integrated one
+#define VALIDATE_BRDF_LUT 0
+#define BRDF_LUT_TOLERANCE 0.005f
 
 void onKey(GLFWwindow* window, int key, int, int action, int mods);
 void onMouseMove(GLFWwindow* window, double xpos, double ypos);
@@ -108,104 +174,51 @@ public:
 		window_width = width;
 		window_height = height;
 
+		// The frame graph allocates the targets of the new size when
+		// the next frame asks for them, and frees the old ones later
 		glViewport(0, 0, window_width, window_height);
-		resizeBloomFramebuffers();
 	}
 
 private:
-	struct StandardPBRProgram
+	enum BlurPath
 	{
-		GLuint id;
-
-		GLint u_model_matrix_loc;
-		GLint u_pv_matrix_loc;
-		GLint u_nor_transform_loc;
-
-		GLint u_view_pos_loc;
-
-		GLint u_irrandiance_sampler_loc;
-		GLint u_specular_sampler_loc;
-		GLint u_brdf_lut_sampler_loc;
-
-		GLint u_has_normal_map_loc;
-		GLint u_has_ao_map_loc;
-		GLint u_has_metallic_map_loc;
-		GLint u_has_roughness_map_loc;
-
-		GLint u_albedo_sampler_loc;
-		GLint u_normal_sampler_loc;
-		GLint u_ao_sampler_loc;
-		GLint u_metallic_sampler_loc;
-		GLint u_roughness_sampler_loc;
-
-		GLint u_metallic_loc;
-		GLint u_roughness_loc;
-
-		GLint u_gamma_loc;
-		GLint u_exposure_loc;
+		BLUR_FRAGMENT = 0,
+		BLUR_COMPUTE = 1,
+		BLUR_MIP_CHAIN = 2
 	};
 
-	struct IrradianceProgram
+	/// std140 mirrors of the uniform blocks in the shaders
+	struct FrameBlock
 	{
-		GLuint id;
-
-		GLint u_view_matrix_loc;
-		GLint u_projection_matrix_loc;
-
-		GLint u_env_map_sampler_loc;
+		float gamma;
+		float exposure;
+		float environment_layer;
+		GLint compact_environment;
 	};
 
-	struct SpecularMapProgram
+	struct ViewBlock
 	{
-		GLuint id;
-
-		GLint u_view_matrix_loc;
-		GLint u_projection_matrix_loc;
-
-		GLint u_env_map_sampler_loc;
-		GLint u_roughness_loc;
-	};
-
-	struct BRDFConvolutionProgram
-	{
-		GLuint id;
-	};
-
-	struct SkyboxProgram
-	{
-		GLint id;
-
-		GLint u_view_matrix_loc;
-		GLint u_projection_matrix_loc;
-
-		GLint u_cube_sampler_loc;
-
-		GLint u_mipmap_level_loc;
-
-		GLint u_gamma_loc;
-		GLint u_exposure_loc;
+		glm::mat4 view_matrix;
+		glm::mat4 projection_matrix;
+		glm::mat4 pv_matrix;
+		glm::vec4 view_pos;
 	};
 
-	struct GaussianBlurProgram
+	// The normal transform is a mat3 padded to a mat4
+	struct ObjectBlock
 	{
-		GLint id;
-
-		GLint u_sampler_loc;
-
-		GLint u_texture_size_loc;
-		GLint u_weights_loc;
-		GLint u_horizontal_loc;
+		glm::mat4 model_matrix;
+		glm::mat4 nor_transform;
 	};
 
-	struct BlenderProgram
+	// The material maps select a program variant instead
+	struct MaterialBlock
 	{
-		GLint id;
-
-		GLint u_scene_sampler_loc;
-		GLint u_blur_sampler_loc;
+		float metallic;
+		float roughness;
 
-		GLint u_gamma_loc;
-		GLint u_exposure_loc;
+		// Blocks are rounded up to a multiple of a vec4
+		float padding[2];
 	};
 
 	bool customInit() override
@@ -215,13 +228,24 @@ private:
 		glfwSetMouseButtonCallback(window, onMouseButton);
 		glfwSetWindowSizeCallback(window, windowResize);
 
+		gl.setProgramCache(PROGRAM_CACHE);
+
+		// The driver compiles the programs while the
+		// CPU side assets below are being loaded
+		if (!submitPrograms())
+		{
+			return false;
+		}
+
+#if !VALIDATE_BRDF_LUT
+		createBRDFLUT();
+#endif
+		createTextures();
+
+		geometry_arena = GeometryArena(GEOMETRY_ARENA_VERTEX_BYTES, GEOMETRY_ARENA_INDICES);
+
 		if (!createStandardPBRProgram() ||
-			!createIrradianceProgram() ||
-			!createSpecularMapProgram() ||
-			!createBRDFConvolutionProgram() ||
-			!createSkyboxProgram() ||
-			!createGaussianBlurProgram() ||
-			!createBlenderProgram() ||
+			!createPrograms() ||
 			!createGeometry() ||
 			!createCube() ||
 			!createQuad())
@@ -229,10 +253,24 @@ private:
 			return false;
 		}
 
-		createEnvironments();
+#if VALIDATE_BRDF_LUT
+		// The validation draws with the quad
 		createBRDFLUT();
-		createTextures();
-		createBloomFramebuffers();
+#endif
+
+		// Compare the first launch against the following ones
+		ProgramCacheStats const& program_stats = gl.getProgramCacheStats();
+
+		std::cout << "Programs ready in " << program_stats.milliseconds
+			<< " ms (" << program_stats.hits << " from cache, "
+			<< program_stats.misses << " compiled)\n\n";
+
+		uniform_ring = UniformBufferRing(UNIFORM_RING_FRAME_SIZE);
+
+		createEnvironments();
+
+		glCreateQueries(GL_TIME_ELAPSED, 2, blur_queries);
+		updateBlurKernel();
 
 		windowResize(window, window_width, window_height);
 
@@ -242,6 +280,9 @@ private:
 		gl.enable(GL_CULL_FACE);
 		gl.enable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
+		// Initialization binds through the raw API and the helper classes
+		gl.invalidateState();
+
 		if (OpenGLContext::checkErrors(__FILE__, __LINE__))
 		{
 			return false;
@@ -255,157 +296,520 @@ private:
 		buildGUI();
 
 		updateCamera(delta_time);
-		glm::vec3 camera_position = camera.new_position;
-		glm::mat4 view_matrix = camera.getViewMatrix();
+		uniform_ring.beginFrame();
 
-		env_cube_texture[current_environment]->bind(0);
-		irr_cube_texture[current_environment]->bind(1);
-		spec_cube_texture[current_environment]->bind(2);
+		FrameBlock frame_block;
+		frame_block.gamma = gamma_correction;
+		frame_block.exposure = exposure;
+		frame_block.environment_layer = current_environment;
+		frame_block.compact_environment = COMPACT_ENVIRONMENTS;
 
-		bloom_framebuffers[0].bind();
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		ViewBlock view_block;
+		view_block.view_matrix = camera.getViewMatrix();
+		view_block.projection_matrix = projection;
+		view_block.pv_matrix = projection * view_block.view_matrix;
+		view_block.view_pos = glm::vec4(camera.new_position, 1.0f);
 
-		drawGeometry(camera_position, view_matrix);
-		drawSkybox(view_matrix);
+		uniform_ring.pushAndBind(FRAME_BLOCK_BINDING, frame_block);
+		uniform_ring.pushAndBind(VIEW_BLOCK_BINDING, view_block);
 
-		blur();
+		bindEnvironment();
 
-		Framebuffer::bindDefault();
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		buildFrameGraph();
+
+		frame_graph.compile(gl);
+		frame_graph.execute(gl, window_width, window_height);
 
-		drawBlended();
+		uniform_ring.endFrame();
 
 		return true;
 	}
 
-	void drawGeometry(
-		glm::vec3 const& camera_position,
-		glm::mat4 const& view_matrix)
+	// Declares the passes of the frame and the targets they use. The
+	// graph keeps the targets in a pool, so a frame like the previous
+	// one allocates nothing
+	void buildFrameGraph()
 	{
-		glUseProgram(standard_pbr.id);
+		frame_graph.reset();
 
-		glUniformMatrix4fv(standard_pbr.u_model_matrix_loc,
-			1, GL_FALSE, glm::value_ptr(model_matrix));
-		glUniformMatrix4fv(standard_pbr.u_pv_matrix_loc,
-			1, GL_FALSE, glm::value_ptr(projection * view_matrix));
-		glUniformMatrix3fv(standard_pbr.u_nor_transform_loc,
-			1, GL_FALSE, glm::value_ptr(glm::mat3(
-				glm::transpose(glm::inverse(model_matrix)))));
+		TransientTextureDesc scene_desc{ window_width, window_height, GL_RGBA16F };
+		TransientTextureDesc depth_desc{ window_width, window_height, GL_DEPTH_COMPONENT24 };
 
-		glUniform3fv(standard_pbr.u_view_pos_loc,
-			1, glm::value_ptr(camera_position));
+		scene_target = frame_graph.createTexture("Scene", scene_desc);
 
-		glUniform1i(standard_pbr.u_irrandiance_sampler_loc, 1);
-		glUniform1i(standard_pbr.u_specular_sampler_loc, 2);
-		glUniform1i(standard_pbr.u_brdf_lut_sampler_loc, 3);
+		FrameGraphResource depth = frame_graph.createTexture("Depth", depth_desc);
 
-		glUniform1i(standard_pbr.u_has_normal_map_loc, has_normal_map);
-		glUniform1i(standard_pbr.u_has_ao_map_loc, has_ao_map);
-		glUniform1i(standard_pbr.u_has_metallic_map_loc, has_metallic_map);
-		glUniform1i(standard_pbr.u_has_roughness_map_loc, has_roughness_map);
+		size_t scene_pass = frame_graph.addPass("Scene", [this]()
+		{
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			drawGeometry();
+			drawSkybox();
+		});
 
-		glUniform1i(standard_pbr.u_albedo_sampler_loc, 4);
-		glUniform1i(standard_pbr.u_normal_sampler_loc, 5);
-		glUniform1i(standard_pbr.u_ao_sampler_loc, 6);
-		glUniform1i(standard_pbr.u_metallic_sampler_loc, 7);
-		glUniform1i(standard_pbr.u_roughness_sampler_loc, 8);
+		frame_graph.write(scene_pass, scene_target);
+		frame_graph.write(scene_pass, depth);
 
-		glUniform1f(standard_pbr.u_metallic_loc, metallic);
-		glUniform1f(standard_pbr.u_roughness_loc, roughness);
+		if (blur_path == BLUR_MIP_CHAIN)
+		{
+			addMipChainPasses();
+		}
+		else
+		{
+			addGaussianBlurPasses();
+		}
+
+		// Without bloom nothing reads the blur, and its passes are culled
+		size_t blend_pass = frame_graph.addPass("Blend", [this]()
+		{
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		glUniform1f(standard_pbr.u_gamma_loc, gamma_correction);
-		glUniform1f(standard_pbr.u_exposure_loc, exposure);
+			drawBlended();
+		});
 
-		glBindVertexArray(geometry.vao_id);
-		glDrawElements(GL_TRIANGLES, geometry.n_indices, GL_UNSIGNED_INT, nullptr);
+		frame_graph.read(blend_pass, scene_target);
+
+		if (bloom)
+		{
+			frame_graph.read(blend_pass, blur_target);
+		}
+
+		// Shown by the GUI after the frame. The blur only with bloom,
+		// since keeping it as an output would keep its passes as well
+		blur_target_shown = show_targets && bloom;
+
+		if (show_targets)
+		{
+			frame_graph.markOutput(scene_target);
+		}
+
+		if (blur_target_shown)
+		{
+			frame_graph.markOutput(blur_target);
+		}
 	}
 
-	void drawSkybox(glm::mat4 const& view_matrix)
+	// Halves the scene into a chain of levels, then walks back up it
+	// adding every level to the tent filtered one below. Each pass has
+	// a fixed number of fetches, and widening the bloom by a level adds
+	// passes a quarter the size of the previous ones
+	void addMipChainPasses()
 	{
-		glDepthFunc(GL_LEQUAL);
+		chain_levels = 1;
+
+		while (chain_levels < bloom_levels &&
+			(window_width >> (chain_levels + 1)) > 0 &&
+			(window_height >> (chain_levels + 1)) > 0)
+		{
+			++chain_levels;
+		}
+
+		std::vector<FrameGraphResource> levels(chain_levels);
+		std::vector<TransientTextureDesc> level_descs(chain_levels);
+
+		int n_passes = 2 * chain_levels - 1;
+		int pass_index = 0;
+
+		FrameGraphResource source = scene_target;
+		glm::vec2 source_size(window_width, window_height);
+
+		for (int i = 0; i < chain_levels; ++i)
+		{
+			level_descs[i] = TransientTextureDesc{ std::max(window_width >> (i + 1), 1),
+				std::max(window_height >> (i + 1), 1), GL_RGBA16F };
+
+			std::string name = "Downsample " + std::to_string(i);
+			levels[i] = frame_graph.createTexture(name, level_descs[i]);
+
+			// The first level reads the scene and takes the Karis average
+			bool first = i == 0;
+			bool last = ++pass_index == n_passes;
+
+			glm::vec2 texel_size = 1.0f / source_size;
+
+			size_t pass = frame_graph.addPass(name, [this, source, texel_size, first, last]()
+			{
+				if (first)
+				{
+					beginBlurTimer();
+				}
+
+				downsample(source, texel_size, first);
+
+				if (last)
+				{
+					endBlurTimer();
+				}
+			});
+
+			frame_graph.read(pass, source);
+			frame_graph.write(pass, levels[i]);
 
-		glUseProgram(skybox_program.id);
+			source = levels[i];
+			source_size = glm::vec2(level_descs[i].width, level_descs[i].height);
+		}
+
+		// The smallest level has nothing below to add
+		blur_target = levels[chain_levels - 1];
 
-		glUniformMatrix4fv(skybox_program.u_view_matrix_loc,
-			1, GL_FALSE, glm::value_ptr(
-				glm::mat4(glm::mat3(view_matrix))));
-		glUniformMatrix4fv(skybox_program.u_projection_matrix_loc,
-			1, GL_FALSE, glm::value_ptr(projection));
+		for (int i = chain_levels - 2; i >= 0; --i)
+		{
+			std::string name = "Upsample " + std::to_string(i);
 
-		glUniform1i(skybox_program.u_cube_sampler_loc, skybox_sampler_unit);
-		glUniform1f(skybox_program.u_mipmap_level_loc, skybox_mipmap_level);
+			FrameGraphResource below = blur_target;
+			FrameGraphResource level = levels[i];
+			blur_target = frame_graph.createTexture(name, level_descs[i]);
 
-		glUniform1f(skybox_program.u_gamma_loc, gamma_correction);
-		glUniform1f(skybox_program.u_exposure_loc, exposure);
+			bool last = ++pass_index == n_passes;
 
-		glBindVertexArray(cube.vao_id);
-		glDrawElements(GL_TRIANGLES, cube.n_indices, GL_UNSIGNED_INT, nullptr);
+			glm::vec2 texel_size = 1.0f /
+				glm::vec2(level_descs[i].width, level_descs[i].height);
 
-		glDepthFunc(GL_LESS);
+			size_t pass = frame_graph.addPass(name, [this, below, level, texel_size, last]()
+			{
+				upsample(below, level, texel_size);
+
+				if (last)
+				{
+					endBlurTimer();
+				}
+			});
+
+			frame_graph.read(pass, below);
+			frame_graph.read(pass, level);
+			frame_graph.write(pass, blur_target);
+		}
 	}
 
-	void blur()
+	// Blurs the scene at a fraction of its size with repeated separable
+	// Gaussian passes. Blur targets live for two passes each and share
+	// two textures whatever the number of passes
+	void addGaussianBlurPasses()
 	{
-		glViewport(0, 0, window_width / 8, window_height / 8);
-
-		glUseProgram(gaussian_blur_program.id);
-		glUniform1i(gaussian_blur_program.u_sampler_loc, 0);
-		glUniform2f(gaussian_blur_program.u_texture_size_loc, window_width / 8, window_height / 8);
-		glUniform1fv(gaussian_blur_program.u_weights_loc, 5, blur_weights);
+		TransientTextureDesc blur_desc{ window_width / BLUR_DOWNSCALE,
+			window_height / BLUR_DOWNSCALE, GL_RGBA16F };
 
-		bloom_render_targets[1].bind(0);
+		blur_target = scene_target;
 
 		for (int i = 0; i < n_blur_passes; ++i)
 		{
-			// Horizontal
-			bloom_framebuffers[1].bind();
+			for (int horizontal = 1; horizontal >= 0; --horizontal)
+			{
+				std::string name = (horizontal ? "Horizontal blur " : "Vertical blur ") +
+					std::to_string(i);
+
+				FrameGraphResource source = blur_target;
+				blur_target = frame_graph.createTexture(name, blur_desc);
+
+				bool first = i == 0 && horizontal;
+				bool last = i == n_blur_passes - 1 && !horizontal;
+
+				FrameGraphResource target = blur_target;
+
+				auto execute = [this, source, target, horizontal, first, last]()
+				{
+					if (first)
+					{
+						beginBlurTimer();
+					}
+
+					if (blur_path == BLUR_COMPUTE)
+					{
+						blurCompute(source, target, horizontal);
+					}
+					else
+					{
+						blur(source, horizontal);
+					}
+
+					if (last)
+					{
+						endBlurTimer();
+					}
+				};
+
+				size_t pass = blur_path == BLUR_COMPUTE ?
+					frame_graph.addComputePass(name, execute) :
+					frame_graph.addPass(name, execute);
+
+				frame_graph.read(pass, source);
+				frame_graph.write(pass, blur_target);
+			}
+		}
+	}
+
+	void drawGeometry()
+	{
+		ObjectBlock object_block;
+		object_block.model_matrix = model_matrix;
+		object_block.nor_transform = glm::mat4(glm::mat3(
+			glm::transpose(glm::inverse(model_matrix))));
+
+		MaterialBlock material_block;
+		material_block.metallic = metallic;
+		material_block.roughness = roughness;
+
+		uniform_ring.pushAndBind(OBJECT_BLOCK_BINDING, object_block);
+		uniform_ring.pushAndBind(MATERIAL_BLOCK_BINDING, material_block);
+
+		// A toggled material option compiles in the background
+		// while the previous variant keeps drawing
+		gl.useProgram(standard_pbr_variants.request(gl, materialKey()));
+
+		gl.bindMesh(geometry);
+		gl.drawMesh(geometry);
+	}
+
+	void drawSkybox()
+	{
+		gl.depthFunc(GL_LEQUAL);
+
+		gl.useProgram(skybox_program.getId());
+
+		gl.setUniform(skybox_program.getId(), skybox_uniforms.cube_sampler,
+			skybox_sampler_unit);
+		gl.setUniform(skybox_program.getId(), skybox_uniforms.mipmap_level,
+			skybox_mipmap_level);
+
+		gl.setUniform(skybox_program.getId(), skybox_uniforms.octahedral_sampler,
+			OCT_TEXTURE_UNIT + skybox_sampler_unit);
+
+		gl.bindMesh(cube);
+		gl.drawMesh(cube);
+
+		gl.depthFunc(GL_LESS);
+	}
+
+	// One direction of a blur pass, reading @source into the target
+	// the frame graph bound, which has the downscaled size. Both may
+	// be the corner of a larger pooled texture. Pairs of taps are
+	// merged by linear filtering, which is exact for the blur targets.
+	// The first pass reads the full size scene, where the merged
+	// taps land between its texels instead and only approximate it
+	void blur(FrameGraphResource source, bool horizontal)
+	{
+		gl.useProgram(gaussian_blur_program.getId());
+		gl.setUniform(gaussian_blur_program.getId(), gaussian_blur_uniforms.sampler, 0);
+		gl.setUniform(gaussian_blur_program.getId(), gaussian_blur_uniforms.texture_size,
+			glm::vec2(window_width / BLUR_DOWNSCALE, window_height / BLUR_DOWNSCALE));
+		gl.setUniform(gaussian_blur_program.getId(), gaussian_blur_uniforms.n_taps,
+			static_cast<int>(blur_linear_kernel.weights.size()));
+		gl.setUniform(gaussian_blur_program.getId(), gaussian_blur_uniforms.weights,
+			static_cast<GLsizei>(blur_linear_kernel.weights.size()),
+			blur_linear_kernel.weights.data());
+		gl.setUniform(gaussian_blur_program.getId(), gaussian_blur_uniforms.offsets,
+			static_cast<GLsizei>(blur_linear_kernel.offsets.size()),
+			blur_linear_kernel.offsets.data());
+		gl.setUniform(gaussian_blur_program.getId(),
+			gaussian_blur_uniforms.horizontal, horizontal ? 1 : 0);
+
+		gl.setUniform(gaussian_blur_program.getId(), gaussian_blur_uniforms.uv_scale,
+			frame_graph.getUVScale(source));
+		gl.setUniform(gaussian_blur_program.getId(), gaussian_blur_uniforms.uv_max,
+			frame_graph.getUVMax(source));
+
+		gl.bindTextureUnit(0, frame_graph.getTexture(source));
+
+		gl.bindMesh(quad);
+		gl.drawMesh(quad);
+	}
+
+	// Same as blur(), loading a tile and its apron into shared memory
+	// once and applying the discrete kernel from there. The radius is
+	// up to BLUR_MAX_RADIUS for the same number of fetches
+	void blurCompute(FrameGraphResource source, FrameGraphResource target, bool horizontal)
+	{
+		GLuint program_id = gaussian_blur_compute_program.getId();
+
+		glm::ivec2 size(window_width / BLUR_DOWNSCALE, window_height / BLUR_DOWNSCALE);
+
+		gl.useProgram(program_id);
 
-			glUniform1i(gaussian_blur_program.u_horizontal_loc, 1);
+		gl.setUniform(program_id, gaussian_blur_compute_uniforms.source, 0);
+		gl.setUniform(program_id, gaussian_blur_compute_uniforms.uv_scale,
+			frame_graph.getUVScale(source));
+		gl.setUniform(program_id, gaussian_blur_compute_uniforms.uv_max,
+			frame_graph.getUVMax(source));
+		gl.setUniform(program_id, gaussian_blur_compute_uniforms.horizontal,
+			horizontal ? 1 : 0);
+		gl.setUniform(program_id, gaussian_blur_compute_uniforms.radius,
+			static_cast<int>(blur_kernel.size()) - 1);
+		gl.setUniform(program_id, gaussian_blur_compute_uniforms.weights,
+			static_cast<GLsizei>(blur_kernel.size()), blur_kernel.data());
 
-			glBindVertexArray(quad.vao_id);
-			glDrawElements(GL_TRIANGLES, quad.n_indices, GL_UNSIGNED_INT, nullptr);
+		glProgramUniform2i(program_id, gaussian_blur_compute_uniforms.size,
+			size.x, size.y);
 
-			bloom_render_targets[2].bind(0);
+		gl.bindTextureUnit(0, frame_graph.getTexture(source));
+		glBindImageTexture(0, frame_graph.getTexture(target), 0, GL_FALSE, 0,
+			GL_WRITE_ONLY, GL_RGBA16F);
+
+		int length = horizontal ? size.x : size.y;
+		int lines = horizontal ? size.y : size.x;
+
+		glDispatchCompute((length + BLUR_TILE_SIZE - 1) / BLUR_TILE_SIZE, lines, 1);
+
+		// Read by the next blur, the blend and the GUI through samplers
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+
+	// A level of the bloom chain from the one above, or from the scene.
+	// @texel_size is the source's
+	void downsample(FrameGraphResource source, glm::vec2 const& texel_size, bool karis_average)
+	{
+		GLuint program_id = bloom_downsample_program.getId();
 
-			// Vertical
-			bloom_framebuffers[2].bind();
+		gl.useProgram(program_id);
 
-			glUniform1i(gaussian_blur_program.u_horizontal_loc, 0);
+		gl.setUniform(program_id, bloom_downsample_uniforms.source, 0);
+		gl.setUniform(program_id, bloom_downsample_uniforms.texel_size, texel_size);
+		gl.setUniform(program_id, bloom_downsample_uniforms.karis_average,
+			karis_average ? 1 : 0);
+		gl.setUniform(program_id, bloom_downsample_uniforms.uv_scale,
+			frame_graph.getUVScale(source));
+		gl.setUniform(program_id, bloom_downsample_uniforms.uv_max,
+			frame_graph.getUVMax(source));
 
-			glBindVertexArray(quad.vao_id);
-			glDrawElements(GL_TRIANGLES, quad.n_indices, GL_UNSIGNED_INT, nullptr);
+		gl.bindTextureUnit(0, frame_graph.getTexture(source));
 
-			bloom_render_targets[3].bind(0);
+		gl.bindMesh(quad);
+		gl.drawMesh(quad);
+	}
+
+	// @level plus the tent filtered @below, the result of the previous
+	// upsample. @texel_size is the target's
+	void upsample(FrameGraphResource below, FrameGraphResource level, glm::vec2 const& texel_size)
+	{
+		GLuint program_id = bloom_upsample_program.getId();
+
+		gl.useProgram(program_id);
+
+		gl.setUniform(program_id, bloom_upsample_uniforms.source, 0);
+		gl.setUniform(program_id, bloom_upsample_uniforms.level, 1);
+		gl.setUniform(program_id, bloom_upsample_uniforms.texel_size, texel_size);
+		gl.setUniform(program_id, bloom_upsample_uniforms.filter_radius,
+			bloom_filter_radius);
+
+		gl.setUniform(program_id, bloom_upsample_uniforms.source_uv_scale,
+			frame_graph.getUVScale(below));
+		gl.setUniform(program_id, bloom_upsample_uniforms.source_uv_max,
+			frame_graph.getUVMax(below));
+		gl.setUniform(program_id, bloom_upsample_uniforms.level_uv_scale,
+			frame_graph.getUVScale(level));
+		gl.setUniform(program_id, bloom_upsample_uniforms.level_uv_max,
+			frame_graph.getUVMax(level));
+
+		gl.bindTextureUnit(0, frame_graph.getTexture(below));
+		gl.bindTextureUnit(1, frame_graph.getTexture(level));
+
+		gl.bindMesh(quad);
+		gl.drawMesh(quad);
+	}
+
+	// Both paths blur with the same Gaussian. The linear kernel is
+	// checked against the discrete one it was merged from
+	void updateBlurKernel()
+	{
+		blur_kernel = gaussianWeights(blur_radius, blur_sigma);
+		blur_linear_kernel = linearSamplingKernel(blur_kernel);
+		blur_kernel_error = linearKernelError(blur_kernel, blur_linear_kernel);
+	}
+
+	// Times every blur pass of the frame with the two queries in turn.
+	// A query is reused only once its result is available, and until
+	// then frames go untimed and the last time is kept, so reading a
+	// result never waits for the GPU
+	void beginBlurTimer()
+	{
+		int query = blur_frames % 2;
+
+		if (blur_query_pending[query])
+		{
+			GLint available = 0;
+			glGetQueryObjectiv(blur_queries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+
+			if (!available)
+			{
+				blur_timing = false;
+				return;
+			}
+
+			GLuint64 elapsed_time;
+			glGetQueryObjectui64v(blur_queries[query], GL_QUERY_RESULT, &elapsed_time);
+
+			blur_ms[blur_query_paths[query]] = elapsed_time / 1000000.0;
+			blur_query_pending[query] = false;
 		}
 
-		glViewport(0, 0, window_width, window_height);
+		blur_query_paths[query] = blur_path;
+		glBeginQuery(GL_TIME_ELAPSED, blur_queries[query]);
+
+		blur_query_pending[query] = true;
+		blur_timing = true;
+
+		++blur_frames;
+	}
+
+	void endBlurTimer()
+	{
+		if (blur_timing)
+		{
+			glEndQuery(GL_TIME_ELAPSED);
+		}
 	}
 
 	void drawBlended()
 	{
-		glUseProgram(blender_program.id);
+		gl.useProgram(blender_program.getId());
+
+		gl.bindTextureUnit(0, frame_graph.getTexture(scene_target));
 
-		bloom_render_targets[0].bind(0);
-		bloom_render_targets[3].bind(1);
+		gl.setUniform(blender_program.getId(), blender_uniforms.scene_uv_scale,
+			frame_graph.getUVScale(scene_target));
+		gl.setUniform(blender_program.getId(), blender_uniforms.scene_uv_max,
+			frame_graph.getUVMax(scene_target));
 
-		glUniform1i(blender_program.u_scene_sampler_loc, 0);
-		glUniform1i(blender_program.u_blur_sampler_loc, 1);
+		if (bloom)
+		{
+			gl.bindTextureUnit(1, frame_graph.getTexture(blur_target));
+
+			gl.setUniform(blender_program.getId(), blender_uniforms.blur_uv_scale,
+				frame_graph.getUVScale(blur_target));
+			gl.setUniform(blender_program.getId(), blender_uniforms.blur_uv_max,
+				frame_graph.getUVMax(blur_target));
+		}
 
-		glUniform1f(blender_program.u_gamma_loc, gamma_correction);
-		glUniform1f(blender_program.u_exposure_loc, exposure);
+		gl.setUniform(blender_program.getId(), blender_uniforms.scene_sampler, 0);
+		gl.setUniform(blender_program.getId(), blender_uniforms.blur_sampler, 1);
+		gl.setUniform(blender_program.getId(), blender_uniforms.bloom, bloom ? 1 : 0);
 
-		glBindVertexArray(quad.vao_id);
-		glDrawElements(GL_TRIANGLES, quad.n_indices, GL_UNSIGNED_INT, nullptr);
+		// The top of the chain is the sum of every level
+		float strength = blur_path == BLUR_MIP_CHAIN ?
+			bloom_strength / chain_levels : bloom_strength;
+
+		gl.setUniform(blender_program.getId(), blender_uniforms.bloom_strength,
+			strength);
+
+		gl.bindMesh(quad);
+		gl.drawMesh(quad);
 	}
 
 	void customDestroy() override
 	{
-		glDeleteProgram(standard_pbr.id);
-		glDeleteProgram(irradiance_program.id);
-		glDeleteProgram(specular_program.id);
-		glDeleteProgram(brdf_convolution_program.id);
-		glDeleteProgram(skybox_program.id);
+		standard_pbr_variants.destroy(gl);
+		gl.deleteProgram(irradiance_program.getId());
+		gl.deleteProgram(specular_program.getId());
+		gl.deleteProgram(skybox_program.getId());
+
+		uniform_ring.destroy();
 
+#if COMPACT_ENVIRONMENTS
+		gl.deleteProgram(octahedral_encode_program.getId());
+
+		env_octahedral_texture.destroy();
+		irr_octahedral_texture.destroy();
+		spec_octahedral_texture.destroy();
+#else
 		for (int i = 0; i < N_ENVIRONMENTS; ++i)
 		{
 			env_cube_texture[i]->destroy();
@@ -417,32 +821,28 @@ private:
 			spec_cube_texture[i]->destroy();
 			delete spec_cube_texture[i];
 		}
+#endif
 
 		brdf_lut.destroy();
 
-		bloom_depth_buffer->destroy();
-		delete bloom_depth_buffer;
+		frame_graph.destroy();
 
-		for (int i = 0; i < 4; ++i)
-		{
-			bloom_render_targets[i].destroy();
-		}
-
-		for (int i = 0; i < 3; ++i)
-		{
-			bloom_framebuffers[i].destroy();
-		}
-
-		delete[] bloom_framebuffers;
+		glDeleteQueries(2, blur_queries);
+		gl.deleteProgram(gaussian_blur_compute_program.getId());
+		gl.deleteProgram(bloom_downsample_program.getId());
+		gl.deleteProgram(bloom_upsample_program.getId());
 
 		for (int i = 0; i < N_MATERIAL_TEXTURES; ++i)
 		{
 			textures[i].destroy();
 		}
 
-		gl.destroyGeometry(geometry);
-		gl.destroyGeometry(cube);
-		gl.destroyGeometry(quad);
+		geometry_arena.release(geometry);
+		geometry_arena.release(cube);
+		geometry_arena.release(quad);
+		gl.destroyVertexLayouts();
+
+		geometry_arena.destroy();
 	}
 
 	void buildGUI()
@@ -452,32 +852,88 @@ private:
 		/// BLOOM
 		Begin("Bloom properties");
 
-		Text("Number of blur passes");
-		SliderInt("", &n_blur_passes, 1, 50);
+		Checkbox("Bloom", &bloom);
+		SliderFloat("Strength", &bloom_strength, 0.0f, 1.0f);
 
-		Text("Blur weights");
+		RadioButton("Mip chain", &blur_path, BLUR_MIP_CHAIN);
+		SameLine();
+		RadioButton("Fragment blur", &blur_path, BLUR_FRAGMENT);
+		SameLine();
+		RadioButton("Compute blur", &blur_path, BLUR_COMPUTE);
 
-		for (int i = 0; i < 5; ++i)
+		if (blur_path == BLUR_MIP_CHAIN)
 		{
-			PushItemWidth(50);
-			InputFloat(std::to_string(i).c_str(), blur_weights + i);
-			SameLine();
+			SliderInt("Levels", &bloom_levels, 1, BLOOM_MAX_LEVELS);
+			SliderFloat("Filter radius", &bloom_filter_radius, 0.5f, 2.0f);
 		}
+		else
+		{
+			Text("Number of blur passes");
+			SliderInt("", &n_blur_passes, 1, 50);
 
-		Dummy(ImVec2(0.0f, 2.0f));
-		Text("Scene - No gamma correction; No tonemapping");
-		Image((void*)(intptr_t)bloom_render_targets[0].getId(),
-			ImVec2(354, 200), ImVec2(0, 1), ImVec2(1, 0));
+			bool kernel_changed = SliderInt("Radius", &blur_radius, 1, BLUR_MAX_RADIUS);
+			kernel_changed |= SliderFloat("Sigma (0 is radius / 3)", &blur_sigma, 0.0f, 16.0f);
 
-		Dummy(ImVec2(0.0f, 2.0f));
-		Text("Brightness");
-		Image((void*)(intptr_t)bloom_render_targets[1].getId(),
-			ImVec2(354, 200), ImVec2(0, 1), ImVec2(1, 0));
+			if (kernel_changed)
+			{
+				updateBlurKernel();
+			}
+
+			Text("Fragment fetches per texel: %zu, discrete: %zu",
+				2u * blur_linear_kernel.weights.size() - 1u, 2u * blur_kernel.size() - 1u);
+			Text("Linear kernel error: %.2e", blur_kernel_error);
+		}
+
+		// Whichever ran last, so switching compares them
+		Text("Bloom (GPU), mip chain: %.3f ms", blur_ms[BLUR_MIP_CHAIN]);
+		Text("Blur (GPU), fragment: %.3f ms", blur_ms[BLUR_FRAGMENT]);
+		Text("Blur (GPU), compute: %.3f ms", blur_ms[BLUR_COMPUTE]);
 
 		Dummy(ImVec2(0.0f, 2.0f));
-		Text("Gaussian blur");
-		Image((void*)(intptr_t)bloom_render_targets[3].getId(),
-			ImVec2(354, 200), ImVec2(0, 1), ImVec2(1, 0));
+		Checkbox("Show targets", &show_targets);
+
+		// Targets of the previous frame, kept alive as outputs
+		if (show_targets && frame_graph.isCompiled())
+		{
+			Dummy(ImVec2(0.0f, 2.0f));
+			Text("Scene - No gamma correction; No tonemapping");
+			showTarget(scene_target);
+
+			if (blur_target_shown)
+			{
+				Dummy(ImVec2(0.0f, 2.0f));
+				Text("Bloom");
+				showTarget(blur_target);
+			}
+		}
+
+		End();
+
+		/// FRAME GRAPH
+		Begin("Frame graph");
+
+		bool bucketed = frame_graph.isBucketed();
+
+		if (Checkbox("Bucketed targets", &bucketed))
+		{
+			frame_graph.setBucketed(bucketed);
+		}
+
+		FrameGraphStats const& graph_stats = frame_graph.getStats();
+
+		Text("Passes: %u (%u culled)", graph_stats.passes, graph_stats.culled_passes);
+		Text("Targets: %u in %u textures", graph_stats.resources, graph_stats.textures);
+		Text("Declared: %.2f MB", graph_stats.declared_bytes / 1048576.0);
+		Text("Aliased: %.2f MB", graph_stats.used_bytes / 1048576.0);
+		Text("Pool: %u textures, %.2f MB", graph_stats.pooled_textures,
+			graph_stats.pooled_bytes / 1048576.0);
+		Text("Created last frame: %u", graph_stats.created_textures);
+
+		if (TreeNode("Passes and targets"))
+		{
+			TextUnformatted(frame_graph.describe().c_str());
+			TreePop();
+		}
 
 		End();
 
@@ -513,10 +969,41 @@ private:
 			SliderFloat("Roughness", &roughness, 0.05f, 1.0f);
 		}
 
+		Dummy(ImVec2(0.0f, 2.0f));
+		Separator();
+
+		Text("Shader variants built: %zu (%zu compiling)", standard_pbr_variants.getCount(),
+			standard_pbr_variants.getPendingCount());
+
+		GeometryArenaStats arena_stats = geometry_arena.getStats();
+
+		Text("Geometry arena: %u meshes, %zu free blocks",
+			arena_stats.meshes, arena_stats.free_blocks);
+		Text("  Vertices %.2f / %.2f MB",
+			arena_stats.vertex_bytes_used / (1024.0f * 1024.0f),
+			arena_stats.vertex_bytes_total / (1024.0f * 1024.0f));
+		Text("  Indices %zu / %zu", arena_stats.indices_used, arena_stats.indices_total);
+
 		End();
 
 		/// ENVIRONMENT
-		Begin("Skybox");
+		Begin("Environment");
+
+		Text("Map");
+
+		Dummy(ImVec2(0.0f, 2.0f));
+		Separator();
+
+		BeginGroup();
+		RadioButton("Gravel Plaza", &current_environment, 0);
+		RadioButton("Paper Mill", &current_environment, 1);
+		RadioButton("Winter Forest", &current_environment, 2);
+		EndGroup();
+
+		Dummy(ImVec2(0.0f, 2.0f));
+		Separator();
+
+		Text("Skybox");
 
 		BeginGroup();
 		RadioButton("Environment map", &skybox_sampler_unit, 0);
@@ -530,6 +1017,15 @@ private:
 			SliderFloat("Mipmap level", &skybox_mipmap_level, 0.0, n_mipmap_levels);
 		}
 
+		Dummy(ImVec2(0.0f, 2.0f));
+		Separator();
+
+		Text("Storage (%d environments)", N_ENVIRONMENTS);
+		Text("%s Cube maps RGB16F: %.2f MB", COMPACT_ENVIRONMENTS ? " " : ">",
+			environmentMemory(false) / (1024.0 * 1024.0));
+		Text("%s Octahedral R11F_G11F_B10F: %.2f MB", COMPACT_ENVIRONMENTS ? ">" : " ",
+			environmentMemory(true) / (1024.0 * 1024.0));
+
 		End();
 
 		/// CAMERA
@@ -612,218 +1108,286 @@ private:
 		mouse_last_y = mouse_y;
 	}
 
-	bool createStandardPBRProgram()
+	bool submitPrograms()
 	{
-		std::vector<ShaderInfo> shaders;
+		std::cout << "Submitting programs ("
+			<< (gl.hasParallelShaderCompile() ? "parallel" : "serial")
+			<< " compile) ...\n\n";
+
+		return
+			submitProgram("irradiance", true, program_builds.irradiance_program) &&
+			submitProgram("specularMap", true, program_builds.specular_program) &&
+#if COMPACT_ENVIRONMENTS
+			submitProgram("octahedralEncode", false,
+				program_builds.octahedral_encode_program) &&
+#endif
+			submitProgram("skybox", false, program_builds.skybox_program) &&
+			submitProgram("gaussianBlur", false, program_builds.gaussian_blur_program,
+				{ "MAX_TAPS " + std::to_string(BLUR_MAX_TAPS) }) &&
+			submitComputeProgram("gaussianBlurCompute",
+				{ "TILE_SIZE " + std::to_string(BLUR_TILE_SIZE),
+				  "MAX_RADIUS " + std::to_string(BLUR_MAX_RADIUS) },
+				program_builds.gaussian_blur_compute_program) &&
+			submitProgram("bloomDownsample", false, program_builds.bloom_downsample_program) &&
+			submitProgram("bloomUpsample", false, program_builds.bloom_upsample_program) &&
+			submitProgram("blender", false, program_builds.blender_program);
+	}
 
-		std::ifstream vs_file("shaders/standardPBR/vs.glsl");
-		std::ifstream fs_file("shaders/standardPBR/fs.glsl");
+	// Finishes the submitted programs in the order the driver completes
+	// them, so the ready ones are checked and reflected while the rest
+	// still compile. Only waits when none of them is ready
+	bool createPrograms()
+	{
+		struct PendingCreate
+		{
+			size_t build;
+			bool (Application::*create)();
+		};
 
-		if (!vs_file)
+		std::vector<PendingCreate> pending{
+			{ program_builds.irradiance_program, &Application::createIrradianceProgram },
+			{ program_builds.specular_program, &Application::createSpecularMapProgram },
+#if COMPACT_ENVIRONMENTS
+			{ program_builds.octahedral_encode_program,
+				&Application::createOctahedralEncodeProgram },
+#endif
+			{ program_builds.skybox_program, &Application::createSkyboxProgram },
+			{ program_builds.gaussian_blur_program, &Application::createGaussianBlurProgram },
+			{ program_builds.gaussian_blur_compute_program,
+				&Application::createGaussianBlurComputeProgram },
+			{ program_builds.bloom_downsample_program,
+				&Application::createBloomDownsampleProgram },
+			{ program_builds.bloom_upsample_program, &Application::createBloomUpsampleProgram },
+			{ program_builds.blender_program, &Application::createBlenderProgram }
+		};
+
+		while (!pending.empty())
 		{
-			std::cerr << "ERROR: Could not open vertex shader\n";
-			return false;
+			size_t next = 0u;
+
+			for (size_t i = 0u; i < pending.size(); ++i)
+			{
+				if (gl.isProgramReady(pending[i].build))
+				{
+					next = i;
+					break;
+				}
+			}
+
+			if (!(this->*pending[next].create)())
+			{
+				return false;
+			}
+
+			pending.erase(pending.begin() + next);
 		}
 
-		if (!fs_file)
+		return true;
+	}
+
+	// Reads the shaders in shaders/@folder and submits them
+	// to the driver. The build is checked by finishProgram
+	bool submitProgram(
+		std::string const& folder,
+		bool has_geometry_shader,
+		size_t& build,
+		std::vector<std::string> const& defines = {})
+	{
+		std::vector<ShaderInfo> shaders;
+
+		if (!readProgram(folder, has_geometry_shader, shaders))
 		{
-			std::cerr << "ERROR: Could not open fragment shader\n";
 			return false;
 		}
 
-		std::cout << "Creating standard pbr program ... ";
+		addDefines(shaders, defines);
 
-		readShader(vs_file, fs_file, shaders);
+		build = gl.submitProgram(shaders);
 
-		bool success;
+		return true;
+	}
 
-		standard_pbr.id = gl.createProgram(shaders, success);
+	bool submitComputeProgram(
+		std::string const& folder,
+		std::vector<std::string> const& defines,
+		size_t& build)
+	{
+		std::ifstream cs_file("shaders/" + folder + "/cs.glsl");
 
-		if (!success)
+		if (!cs_file)
 		{
+			std::cerr << "ERROR: Could not open compute shader of " << folder << '\n';
 			return false;
 		}
 
-		standard_pbr.u_model_matrix_loc =
-			glGetUniformLocation(standard_pbr.id, "u_model_matrix");
-		standard_pbr.u_pv_matrix_loc =
-			glGetUniformLocation(standard_pbr.id, "u_pv_matrix");
-		standard_pbr.u_nor_transform_loc =
-			glGetUniformLocation(standard_pbr.id, "u_nor_transform");
-
-		standard_pbr.u_view_pos_loc =
-			glGetUniformLocation(standard_pbr.id, "u_view_pos");
-
-		standard_pbr.u_irrandiance_sampler_loc =
-			glGetUniformLocation(standard_pbr.id, "u_irradiance_sampler");
-		standard_pbr.u_specular_sampler_loc =
-			glGetUniformLocation(standard_pbr.id, "u_specular_sampler");
-		standard_pbr.u_brdf_lut_sampler_loc =
-			glGetUniformLocation(standard_pbr.id, "u_brdf_lut_sampler");
-
-		standard_pbr.u_has_normal_map_loc =
-			glGetUniformLocation(standard_pbr.id, "u_has_normal_map");
-		standard_pbr.u_has_ao_map_loc =
-			glGetUniformLocation(standard_pbr.id, "u_has_ao_map");
-		standard_pbr.u_has_metallic_map_loc =
-			glGetUniformLocation(standard_pbr.id, "u_has_metallic_map");
-		standard_pbr.u_has_roughness_map_loc =
-			glGetUniformLocation(standard_pbr.id, "u_has_roughness_map");
-
-		standard_pbr.u_albedo_sampler_loc =
-			glGetUniformLocation(standard_pbr.id, "u_albedo_sampler");
-		standard_pbr.u_normal_sampler_loc =
-			glGetUniformLocation(standard_pbr.id, "u_normal_sampler");
-		standard_pbr.u_ao_sampler_loc =
-			glGetUniformLocation(standard_pbr.id, "u_ao_sampler");
-		standard_pbr.u_metallic_sampler_loc =
-			glGetUniformLocation(standard_pbr.id, "u_metallic_sampler");
-		standard_pbr.u_roughness_sampler_loc =
-			glGetUniformLocation(standard_pbr.id, "u_roughness_sampler");
-
-		standard_pbr.u_metallic_loc =
-			glGetUniformLocation(standard_pbr.id, "u_metallic");
-		standard_pbr.u_roughness_loc =
-			glGetUniformLocation(standard_pbr.id, "u_roughness");
-
-		standard_pbr.u_gamma_loc =
-			glGetUniformLocation(standard_pbr.id, "u_gamma");
-		standard_pbr.u_exposure_loc =
-			glGetUniformLocation(standard_pbr.id, "u_exposure");
-
-		assert(standard_pbr.u_model_matrix_loc != -1);
-		assert(standard_pbr.u_pv_matrix_loc != -1);
-		assert(standard_pbr.u_nor_transform_loc != -1);
-
-		assert(standard_pbr.u_view_pos_loc != -1);
-
-		assert(standard_pbr.u_irrandiance_sampler_loc != -1);
-		assert(standard_pbr.u_specular_sampler_loc != -1);
-		assert(standard_pbr.u_brdf_lut_sampler_loc != -1);
-
-		assert(standard_pbr.u_has_normal_map_loc != -1);
-		assert(standard_pbr.u_has_ao_map_loc != -1);
-		assert(standard_pbr.u_has_metallic_map_loc != -1);
-		assert(standard_pbr.u_has_roughness_map_loc != -1);
-
-		assert(standard_pbr.u_albedo_sampler_loc != -1);
-		assert(standard_pbr.u_normal_sampler_loc != -1);
-		assert(standard_pbr.u_ao_sampler_loc != -1);
-		assert(standard_pbr.u_metallic_sampler_loc != -1);
-		assert(standard_pbr.u_roughness_sampler_loc != -1);
-
-		assert(standard_pbr.u_metallic_loc != -1);
-		assert(standard_pbr.u_roughness_loc != -1);
-
-		assert(standard_pbr.u_gamma_loc != -1);
-		assert(standard_pbr.u_exposure_loc != -1);
+		std::vector<ShaderInfo> shaders(1);
 
-		std::cout << "SUCCESS\n";
+		shaders[0].type = GL_COMPUTE_SHADER;
+		readFile(cs_file, shaders[0]);
+
+		addDefines(shaders, defines);
+
+		build = gl.submitProgram(shaders);
 
 		return true;
 	}
 
-	bool createIrradianceProgram()
+	bool readProgram(
+		std::string const& folder,
+		bool has_geometry_shader,
+		std::vector<ShaderInfo>& shaders)
 	{
-		std::vector<ShaderInfo> shaders;
+		std::ifstream vs_file("shaders/" + folder + "/vs.glsl");
+		std::ifstream gs_file;
+		std::ifstream fs_file("shaders/" + folder + "/fs.glsl");
 
-		std::ifstream vs_file("shaders/irradiance/vs.glsl");
-		std::ifstream fs_file("shaders/irradiance/fs.glsl");
+		if (has_geometry_shader)
+		{
+			gs_file.open("shaders/" + folder + "/gs.glsl");
+		}
 
 		if (!vs_file)
 		{
-			std::cerr << "ERROR: Could not open vertex shader\n";
+			std::cerr << "ERROR: Could not open vertex shader of " << folder << '\n';
+			return false;
+		}
+
+		if (has_geometry_shader && !gs_file)
+		{
+			std::cerr << "ERROR: Could not open geometry shader of " << folder << '\n';
 			return false;
 		}
 
 		if (!fs_file)
 		{
-			std::cerr << "ERROR: Could not open fragment shader\n";
+			std::cerr << "ERROR: Could not open fragment shader of " << folder << '\n';
 			return false;
 		}
 
-		std::cout << "Creating irradiance program ... ";
+		if (has_geometry_shader)
+		{
+			readShader(vs_file, gs_file, fs_file, shaders);
+		}
+		else
+		{
+			readShader(vs_file, fs_file, shaders);
+		}
 
-		readShader(vs_file, fs_file, shaders);
+		return true;
+	}
 
-		bool success;
+	bool createStandardPBRProgram()
+	{
+		std::cout << "Creating standard pbr program ... ";
 
-		irradiance_program.id = gl.createProgram(shaders, success);
+		std::vector<ShaderInfo> shaders;
 
-		if (!success)
+		if (!readProgram("standardPBR", false, shaders))
 		{
 			return false;
 		}
 
-		irradiance_program.u_view_matrix_loc =
-			glGetUniformLocation(irradiance_program.id, "u_view_matrix");
-		irradiance_program.u_projection_matrix_loc =
-			glGetUniformLocation(irradiance_program.id, "u_projection_matrix");
+		// Bit i of a material key enables option i
+		standard_pbr_variants = ProgramVariants(shaders, {
+			"NORMAL_MAP",
+			"AO_MAP",
+			"METALLIC_MAP",
+			"ROUGHNESS_MAP",
+			"COMPACT_ENVIRONMENT"
+		});
 
-		irradiance_program.u_env_map_sampler_loc =
-			glGetUniformLocation(irradiance_program.id, "u_env_map_sampler");
+		// Samplers have fixed bindings in the shader, so the
+		// variants don't need any uniform looked up
+		bool built;
+		GLuint program_id = standard_pbr_variants.get(gl, materialKey(), built);
 
-		assert(irradiance_program.u_view_matrix_loc != -1);
-		assert(irradiance_program.u_projection_matrix_loc != -1);
-		assert(irradiance_program.u_env_map_sampler_loc != -1);
+		checkBlockLayouts(ProgramReflection(program_id));
 
-		std::cout << "SUCCESS\n";
+		std::cout << "SUCCESS {" << standard_pbr_variants.describe(materialKey()) << "}\n";
 
 		return true;
 	}
 
-	bool createSpecularMapProgram()
+	// Compares the std140 mirrors with the layout the driver reports
+	void checkBlockLayouts(ProgramReflection const& program) const
 	{
-		std::vector<ShaderInfo> shaders;
+		assert(program.block("FrameBlock").binding == FRAME_BLOCK_BINDING);
+		assert(program.block("ViewBlock").binding == VIEW_BLOCK_BINDING);
+		assert(program.block("ObjectBlock").binding == OBJECT_BLOCK_BINDING);
+		assert(program.block("MaterialBlock").binding == MATERIAL_BLOCK_BINDING);
+
+		assert(program.block("FrameBlock").data_size <= GLint(sizeof(FrameBlock)));
+		assert(program.block("ViewBlock").data_size <= GLint(sizeof(ViewBlock)));
+		assert(program.block("ObjectBlock").data_size <= GLint(sizeof(ObjectBlock)));
+		assert(program.block("MaterialBlock").data_size <= GLint(sizeof(MaterialBlock)));
+
+		assert(program.blockOffset("FrameBlock", "u_exposure") ==
+			GLint(offsetof(FrameBlock, exposure)));
+		assert(program.blockOffset("FrameBlock", "u_environment_layer") ==
+			GLint(offsetof(FrameBlock, environment_layer)));
+		assert(program.blockOffset("FrameBlock", "u_compact_environment") ==
+			GLint(offsetof(FrameBlock, compact_environment)));
+		assert(program.blockOffset("ViewBlock", "u_view_pos") ==
+			GLint(offsetof(ViewBlock, view_pos)));
+		assert(program.blockOffset("ObjectBlock", "u_nor_transform") ==
+			GLint(offsetof(ObjectBlock, nor_transform)));
+		assert(program.blockOffset("MaterialBlock", "u_roughness") ==
+			GLint(offsetof(MaterialBlock, roughness)));
+
+		(void)program;
+	}
+
+	uint32_t materialKey() const
+	{
+		return
+			(has_normal_map ? 1u << 0 : 0u) |
+			(has_ao_map ? 1u << 1 : 0u) |
+			(has_metallic_map ? 1u << 2 : 0u) |
+			(has_roughness_map ? 1u << 3 : 0u) |
+			(COMPACT_ENVIRONMENTS ? 1u << 4 : 0u);
+	}
 
-		std::ifstream vs_file("shaders/specularMap/vs.glsl");
-		std::ifstream fs_file("shaders/specularMap/fs.glsl");
+	bool createIrradianceProgram()
+	{
+		std::cout << "Creating irradiance program ... ";
 
-		if (!vs_file)
-		{
-			std::cerr << "ERROR: Could not open vertex shader\n";
-			return false;
-		}
+		bool success;
 
-		if (!fs_file)
+		GLuint program_id = gl.finishProgram(program_builds.irradiance_program, success);
+
+		if (!success)
 		{
-			std::cerr << "ERROR: Could not open fragment shader\n";
 			return false;
 		}
 
-		std::cout << "Creating specular map program ... ";
+		irradiance_program = ProgramReflection(program_id);
 
-		readShader(vs_file, fs_file, shaders);
+		std::cout << "SUCCESS\n";
+
+		return true;
+	}
+
+	bool createSpecularMapProgram()
+	{
+		std::cout << "Creating specular map program ... ";
 
 		bool success;
 
-		specular_program.id = gl.createProgram(shaders, success);
+		GLuint program_id = gl.finishProgram(program_builds.specular_program, success);
 
 		if (!success)
 		{
 			return false;
 		}
 
-		specular_program.u_view_matrix_loc =
-			glGetUniformLocation(specular_program.id, "u_view_matrix");
-		specular_program.u_projection_matrix_loc =
-			glGetUniformLocation(specular_program.id, "u_projection_matrix");
-
-		specular_program.u_env_map_sampler_loc =
-			glGetUniformLocation(specular_program.id, "u_env_map_sampler");
-		specular_program.u_roughness_loc =
-			glGetUniformLocation(specular_program.id, "u_roughness");
-
-		assert(specular_program.u_view_matrix_loc != -1);
-		assert(specular_program.u_projection_matrix_loc != -1);
-		assert(specular_program.u_env_map_sampler_loc != -1);
-		assert(specular_program.u_roughness_loc != -1);
+		specular_program = ProgramReflection(program_id);
 
 		std::cout << "SUCCESS\n";
 
 		return true;
 	}
 
+#if VALIDATE_BRDF_LUT
 	bool createBRDFConvolutionProgram()
 	{
 		std::vector<ShaderInfo> shaders;
@@ -849,175 +1413,207 @@ private:
 
 		bool success;
 
-		brdf_convolution_program.id = gl.createProgram(shaders, success);
+		GLuint program_id = gl.createProgram(shaders, success);
 
 		if (!success)
 		{
 			return false;
 		}
 
+		brdf_convolution_program = ProgramReflection(program_id);
+
 		std::cout << "SUCCESS\n";
 
 		return true;
 	}
+#endif
 
-	bool createSkyboxProgram()
+#if COMPACT_ENVIRONMENTS
+	bool createOctahedralEncodeProgram()
 	{
-		std::vector<ShaderInfo> shaders;
+		std::cout << "Creating octahedral encode program ... ";
 
-		std::ifstream vs_file("shaders/skybox/vs.glsl");
-		std::ifstream fs_file("shaders/skybox/fs.glsl");
+		bool success;
 
-		if (!vs_file)
+		GLuint program_id = gl.finishProgram(program_builds.octahedral_encode_program, success);
+
+		if (!success)
 		{
-			std::cerr << "ERROR: Could not open vertex shader\n";
 			return false;
 		}
 
-		if (!fs_file)
+		octahedral_encode_program = ProgramReflection(program_id);
+
+		std::cout << "SUCCESS\n";
+
+		return true;
+	}
+#endif
+
+	bool createSkyboxProgram()
+	{
+		std::cout << "Creating skybox program ... ";
+
+		bool success;
+
+		GLuint program_id = gl.finishProgram(program_builds.skybox_program, success);
+
+		if (!success)
 		{
-			std::cerr << "ERROR: Could not open fragment shader\n";
 			return false;
 		}
 
-		std::cout << "Creating skybox program ... ";
+		skybox_program = ProgramReflection(program_id);
+
+		skybox_uniforms.cube_sampler = skybox_program.uniform("u_cube_sampler");
+		skybox_uniforms.mipmap_level = skybox_program.uniform("u_mipmap_level");
+		skybox_uniforms.octahedral_sampler = skybox_program.uniform("u_octahedral_sampler");
+
+		assert(skybox_program.block("FrameBlock").binding == FRAME_BLOCK_BINDING);
+		assert(skybox_program.block("ViewBlock").binding == VIEW_BLOCK_BINDING);
+
+		std::cout << "SUCCESS\n";
+
+		return true;
+	}
 
-		readShader(vs_file, fs_file, shaders);
+	bool createGaussianBlurProgram()
+	{
+		std::cout << "Creating gaussian blur program ... ";
 
 		bool success;
 
-		skybox_program.id = gl.createProgram(shaders, success);
+		GLuint program_id = gl.finishProgram(program_builds.gaussian_blur_program, success);
 
 		if (!success)
 		{
 			return false;
 		}
 
-		skybox_program.u_view_matrix_loc =
-			glGetUniformLocation(skybox_program.id, "u_view_matrix");
-		skybox_program.u_projection_matrix_loc =
-			glGetUniformLocation(skybox_program.id, "u_projection_matrix");
-
-		skybox_program.u_cube_sampler_loc =
-			glGetUniformLocation(skybox_program.id, "u_cube_sampler");
+		gaussian_blur_program = ProgramReflection(program_id);
 
-		skybox_program.u_mipmap_level_loc =
-			glGetUniformLocation(skybox_program.id, "u_mipmap_level");
-
-		skybox_program.u_gamma_loc =
-			glGetUniformLocation(skybox_program.id, "u_gamma");
-		skybox_program.u_exposure_loc =
-			glGetUniformLocation(skybox_program.id, "u_exposure");
-
-		assert(skybox_program.u_view_matrix_loc != -1);
-		assert(skybox_program.u_projection_matrix_loc != -1);
-		assert(skybox_program.u_cube_sampler_loc != -1);
-		assert(skybox_program.u_mipmap_level_loc != -1);
-		assert(skybox_program.u_gamma_loc != -1);
-		assert(skybox_program.u_exposure_loc != -1);
+		gaussian_blur_uniforms.sampler = gaussian_blur_program.uniform("u_sampler");
+		gaussian_blur_uniforms.texture_size = gaussian_blur_program.uniform("u_texture_size");
+		gaussian_blur_uniforms.n_taps = gaussian_blur_program.uniform("u_n_taps");
+		gaussian_blur_uniforms.weights = gaussian_blur_program.uniform("u_weights");
+		gaussian_blur_uniforms.offsets = gaussian_blur_program.uniform("u_offsets");
+		gaussian_blur_uniforms.horizontal = gaussian_blur_program.uniform("u_horizontal");
+		gaussian_blur_uniforms.uv_scale = gaussian_blur_program.uniform("u_uv_scale");
+		gaussian_blur_uniforms.uv_max = gaussian_blur_program.uniform("u_uv_max");
 
 		std::cout << "SUCCESS\n";
 
 		return true;
 	}
 
-	bool createGaussianBlurProgram()
+	bool createGaussianBlurComputeProgram()
 	{
-		std::vector<ShaderInfo> shaders;
+		std::cout << "Creating gaussian blur compute program ... ";
 
-		std::ifstream vs_file("shaders/gaussianBlur/vs.glsl");
-		std::ifstream fs_file("shaders/gaussianBlur/fs.glsl");
+		bool success;
 
-		if (!vs_file)
-		{
-			std::cerr << "ERROR: Could not open vertex shader\n";
-			return false;
-		}
+		GLuint program_id = gl.finishProgram(program_builds.gaussian_blur_compute_program, success);
 
-		if (!fs_file)
+		if (!success)
 		{
-			std::cerr << "ERROR: Could not open fragment shader\n";
 			return false;
 		}
 
-		std::cout << "Creating gaussian blur program ... ";
+		gaussian_blur_compute_program = ProgramReflection(program_id);
 
-		readShader(vs_file, fs_file, shaders);
+		gaussian_blur_compute_uniforms.source = gaussian_blur_compute_program.uniform("u_source");
+		gaussian_blur_compute_uniforms.uv_scale = gaussian_blur_compute_program.uniform("u_uv_scale");
+		gaussian_blur_compute_uniforms.uv_max = gaussian_blur_compute_program.uniform("u_uv_max");
+		gaussian_blur_compute_uniforms.horizontal = gaussian_blur_compute_program.uniform("u_horizontal");
+		gaussian_blur_compute_uniforms.radius = gaussian_blur_compute_program.uniform("u_radius");
+		gaussian_blur_compute_uniforms.weights = gaussian_blur_compute_program.uniform("u_weights");
+		gaussian_blur_compute_uniforms.size = gaussian_blur_compute_program.uniform("u_size");
+
+		std::cout << "SUCCESS\n";
+
+		return true;
+	}
+
+	bool createBloomDownsampleProgram()
+	{
+		std::cout << "Creating bloom downsample program ... ";
 
 		bool success;
 
-		gaussian_blur_program.id = gl.createProgram(shaders, success);
+		GLuint program_id = gl.finishProgram(program_builds.bloom_downsample_program, success);
 
 		if (!success)
 		{
 			return false;
 		}
 
-		gaussian_blur_program.u_sampler_loc =
-			glGetUniformLocation(gaussian_blur_program.id, "u_sampler");
+		bloom_downsample_program = ProgramReflection(program_id);
 
-		gaussian_blur_program.u_texture_size_loc =
-			glGetUniformLocation(gaussian_blur_program.id, "u_texture_size");
-		gaussian_blur_program.u_weights_loc =
-			glGetUniformLocation(gaussian_blur_program.id, "u_weights");
-		gaussian_blur_program.u_horizontal_loc =
-			glGetUniformLocation(gaussian_blur_program.id, "u_horizontal");
-
-		assert(gaussian_blur_program.u_sampler_loc != -1);
-		assert(gaussian_blur_program.u_texture_size_loc != -1);
-		assert(gaussian_blur_program.u_weights_loc != -1);
-		assert(gaussian_blur_program.u_horizontal_loc != -1);
+		bloom_downsample_uniforms.source = bloom_downsample_program.uniform("u_source");
+		bloom_downsample_uniforms.texel_size = bloom_downsample_program.uniform("u_texel_size");
+		bloom_downsample_uniforms.karis_average = bloom_downsample_program.uniform("u_karis_average");
+		bloom_downsample_uniforms.uv_scale = bloom_downsample_program.uniform("u_uv_scale");
+		bloom_downsample_uniforms.uv_max = bloom_downsample_program.uniform("u_uv_max");
 
 		std::cout << "SUCCESS\n";
 
 		return true;
 	}
 
-	bool createBlenderProgram()
+	bool createBloomUpsampleProgram()
 	{
-		std::vector<ShaderInfo> shaders;
+		std::cout << "Creating bloom upsample program ... ";
 
-		std::ifstream vs_file("shaders/blender/vs.glsl");
-		std::ifstream fs_file("shaders/blender/fs.glsl");
+		bool success;
 
-		if (!vs_file)
-		{
-			std::cerr << "ERROR: Could not open vertex shader\n";
-			return false;
-		}
+		GLuint program_id = gl.finishProgram(program_builds.bloom_upsample_program, success);
 
-		if (!fs_file)
+		if (!success)
 		{
-			std::cerr << "ERROR: Could not open fragment shader\n";
 			return false;
 		}
 
-		std::cout << "Creating blender program ... ";
+		bloom_upsample_program = ProgramReflection(program_id);
 
-		readShader(vs_file, fs_file, shaders);
+		bloom_upsample_uniforms.source = bloom_upsample_program.uniform("u_source");
+		bloom_upsample_uniforms.level = bloom_upsample_program.uniform("u_level");
+		bloom_upsample_uniforms.texel_size = bloom_upsample_program.uniform("u_texel_size");
+		bloom_upsample_uniforms.filter_radius = bloom_upsample_program.uniform("u_filter_radius");
+		bloom_upsample_uniforms.source_uv_scale = bloom_upsample_program.uniform("u_source_uv_scale");
+		bloom_upsample_uniforms.source_uv_max = bloom_upsample_program.uniform("u_source_uv_max");
+		bloom_upsample_uniforms.level_uv_scale = bloom_upsample_program.uniform("u_level_uv_scale");
+		bloom_upsample_uniforms.level_uv_max = bloom_upsample_program.uniform("u_level_uv_max");
+
+		std::cout << "SUCCESS\n";
+
+		return true;
+	}
+
+	bool createBlenderProgram()
+	{
+		std::cout << "Creating blender program ... ";
 
 		bool success;
 
-		blender_program.id = gl.createProgram(shaders, success);
+		GLuint program_id = gl.finishProgram(program_builds.blender_program, success);
 
 		if (!success)
 		{
 			return false;
 		}
 
-		blender_program.u_scene_sampler_loc =
-			glGetUniformLocation(blender_program.id, "u_scene_sampler");
-		blender_program.u_blur_sampler_loc =
-			glGetUniformLocation(blender_program.id, "u_blur_sampler");
-		blender_program.u_gamma_loc =
-			glGetUniformLocation(blender_program.id, "u_gamma");
-		blender_program.u_exposure_loc =
-			glGetUniformLocation(blender_program.id, "u_exposure");
+		blender_program = ProgramReflection(program_id);
+
+		blender_uniforms.scene_uv_scale = blender_program.uniform("u_scene_uv_scale");
+		blender_uniforms.scene_uv_max = blender_program.uniform("u_scene_uv_max");
+		blender_uniforms.blur_uv_scale = blender_program.uniform("u_blur_uv_scale");
+		blender_uniforms.blur_uv_max = blender_program.uniform("u_blur_uv_max");
+		blender_uniforms.scene_sampler = blender_program.uniform("u_scene_sampler");
+		blender_uniforms.blur_sampler = blender_program.uniform("u_blur_sampler");
+		blender_uniforms.bloom = blender_program.uniform("u_bloom");
+		blender_uniforms.bloom_strength = blender_program.uniform("u_bloom_strength");
 
-		assert(blender_program.u_scene_sampler_loc != -1);
-		assert(blender_program.u_blur_sampler_loc != -1);
-		assert(blender_program.u_gamma_loc != -1);
-		assert(blender_program.u_exposure_loc != -1);
+		assert(blender_program.block("FrameBlock").binding == FRAME_BLOCK_BINDING);
 
 		std::cout << "SUCCESS\n";
 
@@ -1038,6 +1634,24 @@ private:
 		readFile(fs, shaders[1]);
 	}
 
+	void readShader(
+		std::ifstream& vs,
+		std::ifstream& gs,
+		std::ifstream& fs,
+		std::vector<ShaderInfo>& shaders)
+	{
+		shaders.resize(3);
+
+		shaders[0].type = GL_VERTEX_SHADER;
+		readFile(vs, shaders[0]);
+
+		shaders[1].type = GL_GEOMETRY_SHADER;
+		readFile(gs, shaders[1]);
+
+		shaders[2].type = GL_FRAGMENT_SHADER;
+		readFile(fs, shaders[2]);
+	}
+
 	void readFile(std::ifstream& stream, ShaderInfo& shader_info)
 	{
 		std::string line;
@@ -1075,65 +1689,13 @@ private:
 		std::cout << "DONE\n";
 	}
 
-	void createBloomFramebuffersProc()
-	{
-		bloom_framebuffers[0].attachRenderbuffer(GL_DEPTH_ATTACHMENT, *bloom_depth_buffer);
-
-		// Bloom rt
-		for (int i = 0; i < 2; ++i)
-		{
-			bloom_render_targets[i] = Texture2D(window_width, window_height, GL_RGBA16F, 
-				GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_LINEAR, GL_LINEAR);
-
-			bloom_framebuffers[0].attachTexture(GL_COLOR_ATTACHMENT0 + i, bloom_render_targets[i], 0);
-		}
-
-		GLenum attachments[]
-		{
-			GL_COLOR_ATTACHMENT0,
-			GL_COLOR_ATTACHMENT1
-		};
-
-		glNamedFramebufferDrawBuffers(bloom_framebuffers[0].getId(), 2, attachments);
-
-		bloom_framebuffers[0].checkStatus();
-
-		// Gaussian blur rt
-		for (int i = 0; i < 2; ++i)
-		{
-			bloom_render_targets[i + 2] = Texture2D(window_width / 8, window_height / 8, GL_RGBA16F,
-				GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_LINEAR, GL_LINEAR);
-
-			bloom_framebuffers[i + 1].attachTexture(GL_COLOR_ATTACHMENT0, bloom_render_targets[i + 2], 0);
-			bloom_framebuffers[i + 1].checkStatus();
-		}
-	}
-
-	void createBloomFramebuffers()
-	{
-		std::cout << "Creating bloom framebuffers ... ";
-
-		bloom_framebuffers = new Framebuffer[3];
-		bloom_depth_buffer = new Renderbuffer(GL_DEPTH_COMPONENT24, window_width, window_height);
-
-		createBloomFramebuffersProc();
-
-		std::cout << "DONE\n";
-	}
-
-	void resizeBloomFramebuffers()
+	// Flipped, and cropped to the corner of the pooled texture
+	void showTarget(FrameGraphResource target)
 	{
-		bloom_depth_buffer->destroy();
-		delete bloom_depth_buffer;
-
-		bloom_depth_buffer = new Renderbuffer(GL_DEPTH_COMPONENT24, window_width, window_height);
-
-		for (int i = 0; i < 4; ++i)
-		{
-			bloom_render_targets[i].destroy();
-		}
+		glm::vec2 uv_scale = frame_graph.getUVScale(target);
 
-		createBloomFramebuffersProc();
+		ImGui::Image((void*)(intptr_t)frame_graph.getTexture(target),
+			ImVec2(354, 200), ImVec2(0, uv_scale.y), ImVec2(uv_scale.x, 0));
 	}
 
 	bool createGeometry()
@@ -1169,8 +1731,7 @@ private:
 			f_buffers[2].values,
 			f_buffers[3].values);
 
-		geometry = gl.createPackedStaticGeometry(
-			standard_pbr.id, f_buffers, i_buffers, indices, success);
+		geometry = gl.createStaticGeometry(geometry_arena, f_buffers, i_buffers, indices, success);
 
 		if (!success)
 		{
@@ -1227,8 +1788,7 @@ private:
 
 		bool success;
 
-		cube = gl.createPackedStaticGeometry(
-			irradiance_program.id, f_buffers, i_buffers, indices, success);
+		cube = gl.createStaticGeometry(geometry_arena, f_buffers, i_buffers, indices, success);
 
 		if (!success)
 		{
@@ -1275,9 +1835,7 @@ private:
 
 		bool success;
 
-		quad = gl.createPackedStaticGeometry(
-			gaussian_blur_program.id, f_buffers,
-			i_buffers, indices, success);
+		quad = gl.createStaticGeometry(geometry_arena, f_buffers, i_buffers, indices, success);
 
 		if (!success)
 		{
@@ -1295,9 +1853,17 @@ private:
 
 		std::vector<std::pair<std::string, std::string>> files
 		{
+			{
+				"../res/environmentMaps/gravelPlaza.hdr",
+				"../res/environmentMaps/gravelPlazaIrradiance.hdr",
+			},
 			{
 				"../res/environmentMaps/paperMill.hdr",
 				"../res/environmentMaps/paperMillIrradiance.hdr",
+			},
+			{
+				"../res/environmentMaps/winterForest.hdr",
+				"../res/environmentMaps/winterForestIrradiance.hdr",
 			}
 		};
 
@@ -1335,26 +1901,167 @@ private:
 				glm::vec3(0.0f, -1.0f, 0.0f))
 		};
 
+		// The HDR files are decoded on worker threads while the GL thread
+		// convolves the environments that are already decoded. At most
+		// N_ENVIRONMENT_DECODERS decoded images wait in memory at a time
+		struct DecodedEnvironment
+		{
+			HDRImage env_image;
+			HDRImage irr_image;
+			double decode_ms;
+		};
+
+		auto start = std::chrono::steady_clock::now();
+
+		std::vector<std::future<DecodedEnvironment>> decoded(files.size());
+
+		auto decode = [&files](size_t index)
+		{
+			return std::async(std::launch::async, [&files, index]()
+			{
+				auto start = std::chrono::steady_clock::now();
+
+				DecodedEnvironment environment;
+				environment.env_image = decodeHDRImage(files[index].first, true);
+				environment.irr_image = decodeHDRImage(files[index].second, true);
+
+				std::chrono::duration<double, std::milli> elapsed =
+					std::chrono::steady_clock::now() - start;
+
+				environment.decode_ms = elapsed.count();
+
+				return environment;
+			});
+		};
+
+		for (size_t i = 0; i < files.size() && i < N_ENVIRONMENT_DECODERS; ++i)
+		{
+			decoded[i] = decode(i);
+		}
+
+#if COMPACT_ENVIRONMENTS
+		env_octahedral_texture = Texture2DArray(
+			OCT_ENV_SIZE,
+			OCT_ENV_SIZE,
+			N_ENVIRONMENTS,
+			GL_R11F_G11F_B10F,
+			GL_CLAMP_TO_EDGE,
+			GL_CLAMP_TO_EDGE,
+			GL_LINEAR,
+			GL_LINEAR);
+
+		irr_octahedral_texture = Texture2DArray(
+			OCT_IRR_SIZE,
+			OCT_IRR_SIZE,
+			N_ENVIRONMENTS,
+			GL_R11F_G11F_B10F,
+			GL_CLAMP_TO_EDGE,
+			GL_CLAMP_TO_EDGE,
+			GL_LINEAR,
+			GL_LINEAR);
+
+		spec_octahedral_texture = Texture2DArray(
+			OCT_SPEC_SIZE,
+			OCT_SPEC_SIZE,
+			N_ENVIRONMENTS,
+			GL_R11F_G11F_B10F,
+			GL_CLAMP_TO_EDGE,
+			GL_CLAMP_TO_EDGE,
+			GL_LINEAR_MIPMAP_LINEAR,
+			GL_LINEAR);
+#endif
+
+		double decode_ms = 0.0;
+		double convolution_ms = 0.0;
+
 		for (size_t i = 0; i < files.size(); ++i)
 		{
-			createEnvironmentCubeMap(i, env_projection, env_views, files[i]);
+			DecodedEnvironment environment = decoded[i].get();
+
+			if (i + N_ENVIRONMENT_DECODERS < files.size())
+			{
+				decoded[i + N_ENVIRONMENT_DECODERS] = decode(i + N_ENVIRONMENT_DECODERS);
+			}
+
+			auto convolution_start = std::chrono::steady_clock::now();
+
+			createEnvironmentCubeMap(i, env_projection, env_views,
+				environment.env_image, environment.irr_image);
+
+#if COMPACT_ENVIRONMENTS
+			encodeOctahedralEnvironment(i);
+#endif
+
+			std::chrono::duration<double, std::milli> elapsed =
+				std::chrono::steady_clock::now() - convolution_start;
+
+			decode_ms += environment.decode_ms;
+			convolution_ms += elapsed.count();
+
+			freeHDRImage(environment.env_image);
+			freeHDRImage(environment.irr_image);
 		}
 
-		env_cube_texture[current_environment]->bind(0);
-		irr_cube_texture[current_environment]->bind(1);
-		spec_cube_texture[current_environment]->bind(2);
+		std::chrono::duration<double, std::milli> total =
+			std::chrono::steady_clock::now() - start;
+
+		std::cout << "Environments ready in " << total.count() << " ms (decoding "
+			<< decode_ms << " ms, convolution " << convolution_ms << " ms)\n";
+
+		bindEnvironment();
 
 		std::cout << "\n";
 	}
 
+	void bindEnvironment()
+	{
+#if COMPACT_ENVIRONMENTS
+		gl.bindTextureUnit(OCT_TEXTURE_UNIT, env_octahedral_texture.getId());
+		gl.bindTextureUnit(OCT_TEXTURE_UNIT + 1, irr_octahedral_texture.getId());
+		gl.bindTextureUnit(OCT_TEXTURE_UNIT + 2, spec_octahedral_texture.getId());
+#else
+		gl.bindTextureUnit(0, env_cube_texture[current_environment]->getId());
+		gl.bindTextureUnit(1, irr_cube_texture[current_environment]->getId());
+		gl.bindTextureUnit(2, spec_cube_texture[current_environment]->getId());
+#endif
+	}
+
+	// Bytes taken by the prefiltered environments in each storage mode.
+	// RGB16F is counted at 6 bytes per texel, although drivers usually pad it to 8
+	size_t environmentMemory(bool compact) const
+	{
+		auto texels = [](size_t size, bool mipmapped)
+		{
+			size_t total = 0;
+
+			do
+			{
+				total += size * size;
+				size /= 2;
+			} while (mipmapped && size > 0);
+
+			return total;
+		};
+
+		if (compact)
+		{
+			return N_ENVIRONMENTS * 4 * (texels(OCT_ENV_SIZE, false) +
+				texels(OCT_IRR_SIZE, false) + texels(OCT_SPEC_SIZE, true));
+		}
+
+		return N_ENVIRONMENTS * 6 * 6 * (2 * texels(FBO_ENV_WIDTH, false) +
+			texels(FBO_SPEC_WIDTH, true));
+	}
+
 	void createEnvironmentCubeMap(
 		size_t index,
 		glm::mat4 const& env_projection,
 		glm::mat4 const* env_views,
-		std::pair<std::string, std::string> const& files)
+		HDRImage const& env_image,
+		HDRImage const& irr_image)
 	{
 		std::cout << "Creating environment cube map: "
-			<< files.first << " ... ";
+			<< env_image.path << " ... ";
 
 		env_cube_texture[index] = new Empty16FTextureCube(
 			FBO_ENV_WIDTH,
@@ -1384,77 +2091,71 @@ private:
 			true);
 
 		env_source_texture[index] = new TextureHDREnvironment(
-			files.first,
+			env_image,
 			GL_CLAMP_TO_EDGE,
 			GL_CLAMP_TO_EDGE,
 			GL_LINEAR,
-			GL_LINEAR,
-			true);
+			GL_LINEAR);
 
 		irr_source_texture[index] = new TextureHDREnvironment(
-			files.second,
+			irr_image,
 			GL_CLAMP_TO_EDGE,
 			GL_CLAMP_TO_EDGE,
 			GL_LINEAR,
-			GL_LINEAR,
-			true);
+			GL_LINEAR);
 
-		Renderbuffer env_renderbuffer(GL_DEPTH_COMPONENT24, FBO_ENV_WIDTH, FBO_ENV_HEIGHT);
+		// The cube is rendered from the inside with depth testing disabled,
+		// so no depth attachment is needed (a renderbuffer couldn't be
+		// attached to a layered framebuffer anyway)
 		Framebuffer env_framebuffer;
 
-		env_framebuffer.attachRenderbuffer(GL_DEPTH_ATTACHMENT, env_renderbuffer);
-
 		env_source_texture[index]->bind(0);
 		irr_source_texture[index]->bind(1);
 
-		glUseProgram(irradiance_program.id);
+		glUseProgram(irradiance_program.getId());
 
-		glUniformMatrix4fv(irradiance_program.u_projection_matrix_loc,
+		glUniformMatrix4fv(irradiance_program.uniform("u_projection_matrix"),
 			1, GL_FALSE, glm::value_ptr(env_projection));
+		glUniformMatrix4fv(irradiance_program.uniform("u_view_matrices"),
+			6, GL_FALSE, glm::value_ptr(env_views[0]));
 
 		glViewport(0, 0, FBO_ENV_WIDTH, FBO_ENV_HEIGHT);
 
 		env_framebuffer.bind();
 
-		for (int i = 0; i < 6; ++i)
-		{
-			glUniformMatrix4fv(irradiance_program.u_view_matrix_loc,
-				1, GL_FALSE, glm::value_ptr(env_views[i]));
-			glUniform1i(irradiance_program.u_env_map_sampler_loc, 0);
-
-			env_framebuffer.attachCubeMapTexture(
-				GL_COLOR_ATTACHMENT0, *env_cube_texture[index], 0, i);
-			env_framebuffer.checkStatus();
-
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		gl.bindMesh(cube);
 
-			glBindVertexArray(cube.vao_id);
-			glDrawElements(GL_TRIANGLES, cube.n_indices, GL_UNSIGNED_INT, nullptr);
+		// Each draw covers all six faces through gl_Layer
+		glUniform1i(irradiance_program.uniform("u_env_map_sampler"), 0);
 
-			glUniform1i(irradiance_program.u_env_map_sampler_loc, 1);
+		env_framebuffer.attachLayeredTexture(
+			GL_COLOR_ATTACHMENT0, *env_cube_texture[index], 0);
+		env_framebuffer.checkStatus();
 
-			env_framebuffer.attachCubeMapTexture(
-				GL_COLOR_ATTACHMENT0, *irr_cube_texture[index], 0, i);
-			env_framebuffer.checkStatus();
+		glClear(GL_COLOR_BUFFER_BIT);
+		gl.drawMesh(cube);
 
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glUniform1i(irradiance_program.uniform("u_env_map_sampler"), 1);
 
-			glBindVertexArray(cube.vao_id);
-			glDrawElements(GL_TRIANGLES, cube.n_indices, GL_UNSIGNED_INT, nullptr);
-		}
+		env_framebuffer.attachLayeredTexture(
+			GL_COLOR_ATTACHMENT0, *irr_cube_texture[index], 0);
+		env_framebuffer.checkStatus();
 
-		env_renderbuffer.destroy();
+		glClear(GL_COLOR_BUFFER_BIT);
+		gl.drawMesh(cube);
 
 		std::cout << "specular map ... ";
 
 		env_cube_texture[index]->bind(0);
 
-		glUseProgram(specular_program.id);
+		glUseProgram(specular_program.getId());
 
-		glUniformMatrix4fv(specular_program.u_projection_matrix_loc,
+		glUniformMatrix4fv(specular_program.uniform("u_projection_matrix"),
 			1, GL_FALSE, glm::value_ptr(env_projection));
+		glUniformMatrix4fv(specular_program.uniform("u_view_matrices"),
+			6, GL_FALSE, glm::value_ptr(env_views[0]));
 
-		glUniform1i(specular_program.u_env_map_sampler_loc, 0);
+		glUniform1i(specular_program.uniform("u_env_map_sampler"), 0);
 
 		int n_mipmap_levels = 1 +
 			floor(std::log2(std::max(FBO_SPEC_WIDTH, FBO_SPEC_HEIGHT)));
@@ -1464,34 +2165,19 @@ private:
 		for (int i = 0; i < n_mipmap_levels; ++i)
 		{
 			float r = (float)i / (float)(n_mipmap_levels - 1);
-			glUniform1f(specular_program.u_roughness_loc, r);
+			glUniform1f(specular_program.uniform("u_roughness"), r);
 
-			Renderbuffer rb(GL_DEPTH_COMPONENT24, mip_width, mip_height);
-
-			env_framebuffer.detachCubeMapTexture(GL_COLOR_ATTACHMENT0);
-			env_framebuffer.attachRenderbuffer(GL_DEPTH_ATTACHMENT, rb);
+			env_framebuffer.attachLayeredTexture(
+				GL_COLOR_ATTACHMENT0, *spec_cube_texture[index], i);
+			env_framebuffer.checkStatus();
 
 			glViewport(0, 0, mip_width, mip_height);
 
-			for (int j = 0; j < 6; ++j)
-			{
-				glUniformMatrix4fv(specular_program.u_view_matrix_loc,
-					1, GL_FALSE, glm::value_ptr(env_views[j]));
-
-				env_framebuffer.attachCubeMapTexture(
-					GL_COLOR_ATTACHMENT0, *spec_cube_texture[index], i, j);
-				env_framebuffer.checkStatus();
-
-				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-				glBindVertexArray(cube.vao_id);
-				glDrawElements(GL_TRIANGLES, cube.n_indices, GL_UNSIGNED_INT, nullptr);
-			}
+			glClear(GL_COLOR_BUFFER_BIT);
+			gl.drawMesh(cube);
 
 			mip_width /= 2;
 			mip_height /= 2;
-
-			rb.destroy();
 		}
 
 		env_source_texture[index]->destroy();
@@ -1507,10 +2193,88 @@ private:
 		std::cout << "DONE\n";
 	}
 
+#if COMPACT_ENVIRONMENTS
+	// Resamples the cube maps of environment @index into layer @index
+	// of the octahedral arrays, one mip level at a time, and then
+	// releases the cube maps
+	void encodeOctahedralEnvironment(size_t index)
+	{
+		std::cout << "Encoding octahedral maps ... ";
+
+		Framebuffer oct_framebuffer;
+
+		glUseProgram(octahedral_encode_program.getId());
+		glUniform1i(octahedral_encode_program.uniform("u_cube_sampler"), 0);
+
+		oct_framebuffer.bind();
+
+		gl.bindMesh(quad);
+
+		auto encode = [&](Texture& cube, int n_cube_levels, Texture2DArray& octahedral)
+		{
+			cube.bind(0);
+
+			int size = octahedral.getWidth();
+			int level = 0;
+
+			// The octahedral maps are twice as wide as a cube face, so
+			// level i of both covers roughly the same solid angle per texel
+			do
+			{
+				glUniform1f(octahedral_encode_program.uniform("u_mipmap_level"),
+					std::min(level, n_cube_levels - 1));
+
+				oct_framebuffer.attachTextureLayer(
+					GL_COLOR_ATTACHMENT0, octahedral, level, index);
+				oct_framebuffer.checkStatus();
+
+				glViewport(0, 0, size, size);
+				gl.drawMesh(quad);
+
+				size /= 2;
+				++level;
+			} while (n_cube_levels > 1 && size > 0);
+		};
+
+		int n_spec_levels = 1 +
+			floor(std::log2(std::max(FBO_SPEC_WIDTH, FBO_SPEC_HEIGHT)));
+
+		encode(*env_cube_texture[index], 1, env_octahedral_texture);
+		encode(*irr_cube_texture[index], 1, irr_octahedral_texture);
+		encode(*spec_cube_texture[index], n_spec_levels, spec_octahedral_texture);
+
+		oct_framebuffer.destroy();
+
+		Framebuffer::bindDefault();
+
+		env_cube_texture[index]->destroy();
+		delete env_cube_texture[index];
+
+		irr_cube_texture[index]->destroy();
+		delete irr_cube_texture[index];
+
+		spec_cube_texture[index]->destroy();
+		delete spec_cube_texture[index];
+
+		std::cout << "DONE\n";
+	}
+#endif
+
+	// The LUT is integrated on the CPU the first time and cached on disk
 	void createBRDFLUT()
 	{
 		std::cout << "Creating BRDF LUT ... ";
 
+		auto start = std::chrono::steady_clock::now();
+
+		bool from_cache;
+
+		std::vector<float> lut = loadBRDFLUT(BRDF_LUT_CACHE,
+			BRDF_LUT_WIDTH, BRDF_LUT_HEIGHT, BRDF_LUT_SAMPLES, from_cache);
+
+		std::chrono::duration<double, std::milli> elapsed =
+			std::chrono::steady_clock::now() - start;
+
 		brdf_lut = Texture2D(
 			BRDF_LUT_WIDTH,
 			BRDF_LUT_HEIGHT,
@@ -1520,43 +2284,109 @@ private:
 			GL_LINEAR,
 			GL_LINEAR);
 
-		Renderbuffer lut_renderbuffer(GL_DEPTH_COMPONENT24, BRDF_LUT_WIDTH, BRDF_LUT_HEIGHT);
+		glTextureSubImage2D(brdf_lut.getId(), 0, 0, 0,
+			BRDF_LUT_WIDTH, BRDF_LUT_HEIGHT, GL_RG, GL_FLOAT, lut.data());
+
+		brdf_lut.bind(3);
+
+		std::cout << (from_cache ? "loaded from cache" : "integrated")
+			<< " in " << elapsed.count() << " ms ... ";
+
+#if VALIDATE_BRDF_LUT
+		validateBRDFLUT(lut);
+#endif
+
+		std::cout << "DONE\n";
+	}
+
+#if VALIDATE_BRDF_LUT
+	void validateBRDFLUT(std::vector<float> const& lut)
+	{
+		if (!createBRDFConvolutionProgram())
+		{
+			return;
+		}
+
+		Texture2D gpu_lut(
+			BRDF_LUT_WIDTH,
+			BRDF_LUT_HEIGHT,
+			GL_RG32F,
+			GL_CLAMP_TO_EDGE,
+			GL_CLAMP_TO_EDGE,
+			GL_LINEAR,
+			GL_LINEAR);
 
 		Framebuffer lut_framebuffer;
-		lut_framebuffer.attachTexture(GL_COLOR_ATTACHMENT0, brdf_lut, 0);
-		lut_framebuffer.attachRenderbuffer(GL_DEPTH_ATTACHMENT, lut_renderbuffer);
+		lut_framebuffer.attachTexture(GL_COLOR_ATTACHMENT0, gpu_lut, 0);
 		lut_framebuffer.bind();
 
 		glViewport(0, 0, BRDF_LUT_WIDTH, BRDF_LUT_HEIGHT);
 
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glClear(GL_COLOR_BUFFER_BIT);
 
-		glUseProgram(brdf_convolution_program.id);
+		glUseProgram(brdf_convolution_program.getId());
 
-		glBindVertexArray(quad.vao_id);
-		glDrawElements(GL_TRIANGLES, quad.n_indices, GL_UNSIGNED_INT, nullptr);
+		gl.bindMesh(quad);
+		gl.drawMesh(quad);
 
-		lut_renderbuffer.destroy();
-		lut_framebuffer.destroy();
+		std::vector<float> gpu_values(lut.size());
 
-		Framebuffer::bindDefault();
+		glGetTextureImage(gpu_lut.getId(), 0, GL_RG, GL_FLOAT,
+			gpu_values.size() * sizeof(float), gpu_values.data());
 
-		brdf_lut.bind(3);
+		float max_error = 0.0f;
 
-		std::cout << "DONE\n";
+		for (size_t i = 0; i < lut.size(); ++i)
+		{
+			max_error = std::max(max_error, std::abs(lut[i] - gpu_values[i]));
+		}
+
+		std::cout << "max error against the shader: " << max_error
+			<< (max_error <= BRDF_LUT_TOLERANCE ? " (OK)" : " (FAILED)")
+			<< " ... ";
+
+		lut_framebuffer.destroy();
+		gpu_lut.destroy();
+
+		glDeleteProgram(brdf_convolution_program.getId());
+
+		Framebuffer::bindDefault();
 	}
+#endif
 
 	/// Bloom stuff
-	Framebuffer* bloom_framebuffers;
-	Renderbuffer* bloom_depth_buffer;
-	Texture bloom_render_targets[4];
+	FrameGraph frame_graph;
+
+	// Declared by the graph of the last frame
+	FrameGraphResource scene_target = 0u;
+	FrameGraphResource blur_target = 0u;
+	bool blur_target_shown = false;
+
+	bool bloom = true;
+	bool show_targets = true;
+	float bloom_strength = 0.04f;
+
+	int blur_path = BLUR_MIP_CHAIN;
+
+	int bloom_levels = BLOOM_LEVELS;
+	int chain_levels = 1; // Fewer on small windows
+	float bloom_filter_radius = 1.0f;
 
 	int n_blur_passes = 5;
+	int blur_radius = 8;
+	float blur_sigma = 0.0f;
 
-	float blur_weights[5]
-	{
-		0.227027, 0.1945946, 0.1216216, 0.054054, 0.016216
-	};
+	// Center and one side
+	std::vector<float> blur_kernel;
+	LinearKernel blur_linear_kernel;
+	float blur_kernel_error = 0.0f;
+
+	GLuint blur_queries[2];
+	int blur_query_paths[2];
+	bool blur_query_pending[2] = {};
+	bool blur_timing = false; // Whether this frame's blur is timed
+	unsigned blur_frames = 0u; // Timed ones
+	double blur_ms[3] = {}; // Per path
 
 	/// Environment
 	int current_environment = 0;
@@ -1568,16 +2398,110 @@ private:
 	TextureHDREnvironment* env_source_texture[N_ENVIRONMENTS];
 	TextureHDREnvironment* irr_source_texture[N_ENVIRONMENTS];
 
+#if COMPACT_ENVIRONMENTS
+	Texture2DArray env_octahedral_texture;
+	Texture2DArray irr_octahedral_texture;
+	Texture2DArray spec_octahedral_texture;
+#endif
+
 	Texture brdf_lut;
 
+	/// Uniform blocks
+	UniformBufferRing uniform_ring;
+
 	/// Programs
-	StandardPBRProgram standard_pbr;
-	IrradianceProgram irradiance_program;
-	SpecularMapProgram specular_program;
-	BRDFConvolutionProgram brdf_convolution_program;
-	SkyboxProgram skybox_program;
-	GaussianBlurProgram gaussian_blur_program;
-	BlenderProgram blender_program;
+	struct ProgramBuilds
+	{
+		size_t irradiance_program;
+		size_t specular_program;
+		size_t octahedral_encode_program;
+		size_t skybox_program;
+		size_t gaussian_blur_program;
+		size_t gaussian_blur_compute_program;
+		size_t bloom_downsample_program;
+		size_t bloom_upsample_program;
+		size_t blender_program;
+	} program_builds;
+
+	ProgramVariants standard_pbr_variants;
+	ProgramReflection irradiance_program;
+	ProgramReflection specular_program;
+#if COMPACT_ENVIRONMENTS
+	ProgramReflection octahedral_encode_program;
+#endif
+#if VALIDATE_BRDF_LUT
+	ProgramReflection brdf_convolution_program;
+#endif
+	ProgramReflection skybox_program;
+	ProgramReflection gaussian_blur_program;
+	ProgramReflection gaussian_blur_compute_program;
+	ProgramReflection bloom_downsample_program;
+	ProgramReflection bloom_upsample_program;
+	ProgramReflection blender_program;
+
+	// Locations of the uniforms set every frame, resolved once after linking
+	struct SkyboxUniforms
+	{
+		GLint cube_sampler;
+		GLint mipmap_level;
+		GLint octahedral_sampler;
+	} skybox_uniforms;
+
+	struct GaussianBlurUniforms
+	{
+		GLint sampler;
+		GLint texture_size;
+		GLint n_taps;
+		GLint weights;
+		GLint offsets;
+		GLint horizontal;
+		GLint uv_scale;
+		GLint uv_max;
+	} gaussian_blur_uniforms;
+
+	struct GaussianBlurComputeUniforms
+	{
+		GLint source;
+		GLint uv_scale;
+		GLint uv_max;
+		GLint horizontal;
+		GLint radius;
+		GLint weights;
+		GLint size;
+	} gaussian_blur_compute_uniforms;
+
+	struct BloomDownsampleUniforms
+	{
+		GLint source;
+		GLint texel_size;
+		GLint karis_average;
+		GLint uv_scale;
+		GLint uv_max;
+	} bloom_downsample_uniforms;
+
+	struct BloomUpsampleUniforms
+	{
+		GLint source;
+		GLint level;
+		GLint texel_size;
+		GLint filter_radius;
+		GLint source_uv_scale;
+		GLint source_uv_max;
+		GLint level_uv_scale;
+		GLint level_uv_max;
+	} bloom_upsample_uniforms;
+
+	struct BlenderUniforms
+	{
+		GLint scene_uv_scale;
+		GLint scene_uv_max;
+		GLint blur_uv_scale;
+		GLint blur_uv_max;
+		GLint scene_sampler;
+		GLint blur_sampler;
+		GLint bloom;
+		GLint bloom_strength;
+	} blender_uniforms;
 
 	/// Material
 	Texture textures[N_MATERIAL_TEXTURES];
@@ -1595,6 +2519,7 @@ private:
 	float skybox_mipmap_level = 0;
 
 	/// Object properties
+	GeometryArena geometry_arena;
 	DeviceMesh geometry;
 	DeviceMesh cube;
 	DeviceMesh quad;
@@ -4,19 +4,42 @@ in vec2 v_tex;
 
 uniform sampler2D u_scene_sampler;
 uniform sampler2D u_blur_sampler;
+uniform bool u_bloom;
 
-uniform float u_gamma;
-uniform float u_exposure;
+// Fraction of the blurred scene mixed into the scene, so
+// the bloom spreads the energy of a pixel instead of adding
+uniform float u_bloom_strength;
+
+// Both targets are the lower left corner of their textures
+uniform vec2 u_scene_uv_scale;
+uniform vec2 u_scene_uv_max;
+uniform vec2 u_blur_uv_scale;
+uniform vec2 u_blur_uv_max;
+
+// Bound by the application from its uniform buffer ring
+layout (std140, binding = 0) uniform FrameBlock
+{
+	float u_gamma;
+	float u_exposure;
+	float u_environment_layer;
+	bool u_compact_environment;
+};
 
 out vec4 out_color;
 
 void main()
 {
-	vec3 scene = texture(u_scene_sampler, v_tex).rgb;
-	vec3 blur = texture(u_blur_sampler, v_tex).rgb;
+	vec3 scene = texture(u_scene_sampler, min(v_tex * u_scene_uv_scale, u_scene_uv_max)).rgb;
+
+	if (u_bloom)
+	{
+		vec3 blur = texture(u_blur_sampler, min(v_tex * u_blur_uv_scale, u_blur_uv_max)).rgb;
+		scene = mix(scene, blur, u_bloom_strength);
+	}
 
-	scene += vec3(1.0) - exp(-blur * u_exposure);
+	// Tonemapping
+	vec3 color = vec3(1.0) - exp(-scene * u_exposure);
 
-	out_color = vec4(pow(scene.rgb, vec3(1.0 / u_gamma)), 1.0);
+	out_color = vec4(pow(color, vec3(1.0 / u_gamma)), 1.0);
 }
 
@@ -1,7 +1,7 @@
 #version 450 core
 
 layout (location = 0) in vec3 a_pos;
-layout (location = 1) in vec2 a_tex;
+layout (location = 2) in vec2 a_tex;
 
 out vec2 v_tex;
 
@@ -0,0 +1,77 @@
+#version 450 core
+
+in vec2 v_tex;
+
+uniform sampler2D u_source;
+
+// Size of a texel of the source, twice the target's
+uniform vec2 u_texel_size;
+
+// Set for the first level, which reads the scene
+uniform bool u_karis_average;
+
+// The source is the lower left corner of its texture
+uniform vec2 u_uv_scale;
+uniform vec2 u_uv_max;
+
+out vec4 out_color;
+
+vec3 sampleSource(vec2 uv)
+{
+	return texture(u_source, min(uv * u_uv_scale, u_uv_max)).rgb;
+}
+
+// Averaging by these keeps a single very bright texel
+// from flickering through the whole chain as it moves
+float karisWeight(vec3 color)
+{
+	return 1.0 / (1.0 + dot(color, vec3(0.2126, 0.7152, 0.0722)));
+}
+
+void main()
+{
+	vec2 t = u_texel_size;
+
+	// 13 bilinear fetches covering 6x6 texels (Jimenez 2014)
+	vec3 a = sampleSource(v_tex + t * vec2(-2.0, 2.0));
+	vec3 b = sampleSource(v_tex + t * vec2(0.0, 2.0));
+	vec3 c = sampleSource(v_tex + t * vec2(2.0, 2.0));
+	vec3 d = sampleSource(v_tex + t * vec2(-2.0, 0.0));
+	vec3 e = sampleSource(v_tex);
+	vec3 f = sampleSource(v_tex + t * vec2(2.0, 0.0));
+	vec3 g = sampleSource(v_tex + t * vec2(-2.0, -2.0));
+	vec3 h = sampleSource(v_tex + t * vec2(0.0, -2.0));
+	vec3 i = sampleSource(v_tex + t * vec2(2.0, -2.0));
+	vec3 j = sampleSource(v_tex + t * vec2(-1.0, 1.0));
+	vec3 k = sampleSource(v_tex + t * vec2(1.0, 1.0));
+	vec3 l = sampleSource(v_tex + t * vec2(-1.0, -1.0));
+	vec3 m = sampleSource(v_tex + t * vec2(1.0, -1.0));
+
+	// Five overlapping 4x4 boxes, the center one counting half
+	vec3 boxes[5] = vec3[](
+		(j + k + l + m) * 0.25,
+		(a + b + d + e) * 0.25,
+		(b + c + e + f) * 0.25,
+		(d + e + g + h) * 0.25,
+		(e + f + h + i) * 0.25);
+
+	float weights[5] = float[](0.5, 0.125, 0.125, 0.125, 0.125);
+
+	vec3 result = vec3(0.0);
+	float weight_sum = 0.0;
+
+	for (int n = 0; n < 5; ++n)
+	{
+		float weight = weights[n];
+
+		if (u_karis_average)
+		{
+			weight *= karisWeight(boxes[n]);
+		}
+
+		result += boxes[n] * weight;
+		weight_sum += weight;
+	}
+
+	out_color = vec4(result / weight_sum, 1.0);
+}
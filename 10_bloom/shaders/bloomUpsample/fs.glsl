@@ -0,0 +1,50 @@
+#version 450 core
+
+in vec2 v_tex;
+
+// The next smaller level of the chain, already upsampled up to it
+uniform sampler2D u_source;
+
+// The downsampled level the size of the target
+uniform sampler2D u_level;
+
+// Distance between the taps of the tent, in texels of the target
+uniform vec2 u_texel_size;
+uniform float u_filter_radius;
+
+// Both are the lower left corner of their textures
+uniform vec2 u_source_uv_scale;
+uniform vec2 u_source_uv_max;
+uniform vec2 u_level_uv_scale;
+uniform vec2 u_level_uv_max;
+
+out vec4 out_color;
+
+vec3 sampleSource(vec2 uv)
+{
+	return texture(u_source, min(uv * u_source_uv_scale, u_source_uv_max)).rgb;
+}
+
+void main()
+{
+	vec2 t = u_texel_size * u_filter_radius;
+
+	// 3x3 tent, 1 2 1 / 2 4 2 / 1 2 1
+	vec3 result = sampleSource(v_tex) * 4.0;
+
+	result += (sampleSource(v_tex + vec2(-t.x, 0.0)) +
+		sampleSource(v_tex + vec2(t.x, 0.0)) +
+		sampleSource(v_tex + vec2(0.0, -t.y)) +
+		sampleSource(v_tex + vec2(0.0, t.y))) * 2.0;
+
+	result += sampleSource(v_tex + vec2(-t.x, -t.y)) +
+		sampleSource(v_tex + vec2(t.x, -t.y)) +
+		sampleSource(v_tex + vec2(-t.x, t.y)) +
+		sampleSource(v_tex + vec2(t.x, t.y));
+
+	// Added to the level here rather than with blending, since
+	// every target of the frame graph is written by one pass
+	vec3 level = texture(u_level, min(v_tex * u_level_uv_scale, u_level_uv_max)).rgb;
+
+	out_color = vec4(level + result / 16.0, 1.0);
+}
@@ -4,34 +4,41 @@ in vec2 v_tex;
 
 uniform sampler2D u_sampler;
 
+// MAX_TAPS is defined by the application
+
 uniform vec2 u_texture_size;
-uniform float u_weights[5];
 uniform bool u_horizontal;
 
+// Center first, then one side. Each tap but the center one falls
+// between two texels, which linear filtering weights for us
+uniform int u_n_taps;
+uniform float u_weights[MAX_TAPS];
+uniform float u_offsets[MAX_TAPS];
+
+// The source is the lower left corner of its texture
+uniform vec2 u_uv_scale;
+uniform vec2 u_uv_max;
+
 out vec4 out_color;
 
+vec3 sampleSource(vec2 uv)
+{
+	return texture(u_sampler, min(uv * u_uv_scale, u_uv_max)).rgb;
+}
+
 void main()
 {
-	vec2 tex_offset = 1.0 / u_texture_size;
-	vec3 result = texture(u_sampler, v_tex).rgb * u_weights[0];
+	vec2 texel = 1.0 / u_texture_size;
+	vec2 direction = u_horizontal ? vec2(texel.x, 0.0) : vec2(0.0, texel.y);
 
-	if (u_horizontal)
-	{
-		for (int i = 1; i < 5; ++i)
-		{
-			result += texture(u_sampler, v_tex + vec2(tex_offset.x * i, 0.0)).rgb * u_weights[i];
-			result += texture(u_sampler, v_tex - vec2(tex_offset.x * i, 0.0)).rgb * u_weights[i];
-		}
-	}
-	else
+	vec3 result = sampleSource(v_tex) * u_weights[0];
+
+	for (int i = 1; i < u_n_taps; ++i)
 	{
-		for (int i = 1; i < 5; ++i)
-		{
-			result += texture(u_sampler, v_tex + vec2(0.0, tex_offset.y * i)).rgb * u_weights[i];
-			result += texture(u_sampler, v_tex - vec2(0.0, tex_offset.y * i)).rgb * u_weights[i];
-		}
+		vec2 offset = direction * u_offsets[i];
+
+		result += (sampleSource(v_tex + offset) + sampleSource(v_tex - offset)) * u_weights[i];
 	}
 
 	out_color = vec4(result, 1.0);
 }
-
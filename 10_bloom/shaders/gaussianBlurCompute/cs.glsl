@@ -0,0 +1,65 @@
+#version 450 core
+
+// TILE_SIZE and MAX_RADIUS are defined by the application
+
+// A workgroup per tile of a row, or of a column for the vertical
+// direction. The tile is along the direction of the blur
+layout (local_size_x = TILE_SIZE) in;
+
+layout (rgba16f, binding = 0) uniform writeonly image2D u_target;
+
+uniform sampler2D u_source;
+
+// The source is the lower left corner of its texture
+uniform vec2 u_uv_scale;
+uniform vec2 u_uv_max;
+
+// Of the target, which the source is sampled at
+uniform ivec2 u_size;
+
+uniform bool u_horizontal;
+
+// Center weight first, then one side
+uniform int u_radius;
+uniform float u_weights[MAX_RADIUS + 1];
+
+// The tile and an apron of the radius on both sides
+shared vec3 tile[TILE_SIZE + 2 * MAX_RADIUS];
+
+void main()
+{
+	ivec2 along = u_horizontal ? ivec2(1, 0) : ivec2(0, 1);
+	ivec2 across = ivec2(1) - along;
+
+	int line = int(gl_WorkGroupID.y);
+	int tile_start = int(gl_WorkGroupID.x) * TILE_SIZE;
+	int local = int(gl_LocalInvocationID.x);
+
+	// Every texel is fetched once, instead of once per tap
+	for (int i = local; i < TILE_SIZE + 2 * u_radius; i += TILE_SIZE)
+	{
+		ivec2 texel = along * (tile_start - u_radius + i) + across * line;
+		vec2 uv = (vec2(texel) + 0.5) / vec2(u_size);
+
+		tile[i] = texture(u_source, min(uv * u_uv_scale, u_uv_max)).rgb;
+	}
+
+	barrier();
+
+	ivec2 texel = along * (tile_start + local) + across * line;
+
+	if (any(greaterThanEqual(texel, u_size)))
+	{
+		return;
+	}
+
+	int center = local + u_radius;
+	vec3 result = tile[center] * u_weights[0];
+
+	for (int i = 1; i <= u_radius; ++i)
+	{
+		result += (tile[center + i] + tile[center - i]) * u_weights[i];
+	}
+
+	imageStore(u_target, texel, vec4(result, 1.0));
+}
@@ -1,6 +1,6 @@
 #version 450 core
 
-in vec3 v_local_position;
+in vec3 g_local_position;
 
 uniform sampler2D u_env_map_sampler;
 
@@ -8,7 +8,7 @@ out vec4 out_color;
 
 void main()
 {
-	vec3 pos = normalize(v_local_position);
+	vec3 pos = normalize(g_local_position);
 
 	vec2 uv = vec2(atan(pos.z, pos.x), asin(pos.y));
 	uv *= vec2(0.1591, 0.3183);
@@ -0,0 +1,34 @@
+#version 450 core
+
+in vec2 v_tex;
+
+uniform samplerCube u_cube_sampler;
+uniform float u_mipmap_level;
+
+out vec4 out_color;
+
+vec2 signNotZero(vec2 v)
+{
+	return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// The upper hemisphere (+y) maps to the inner diamond
+// and the lower one is folded over the corners
+vec3 octahedralDecode(vec2 uv)
+{
+	vec2 p = uv * 2.0 - 1.0;
+	vec3 dir = vec3(p.x, 1.0 - abs(p.x) - abs(p.y), p.y);
+
+	if (dir.y < 0.0)
+	{
+		dir.xz = (1.0 - abs(p.yx)) * signNotZero(p);
+	}
+
+	return normalize(dir);
+}
+
+void main()
+{
+	vec3 dir = octahedralDecode(v_tex);
+	out_color = vec4(textureLod(u_cube_sampler, dir, u_mipmap_level).rgb, 1.0);
+}
@@ -5,29 +5,54 @@ in vec3 v_tex;
 uniform samplerCube u_cube_sampler;
 uniform float u_mipmap_level;
 
-uniform float u_gamma;
-uniform float u_exposure;
+uniform sampler2DArray u_octahedral_sampler;
 
+// Bound by the application from its uniform buffer ring
+layout (std140, binding = 0) uniform FrameBlock
+{
+	float u_gamma;
+	float u_exposure;
+	float u_environment_layer;
+	bool u_compact_environment;
+};
+
+// HDR, tonemapped by the blender after the bloom
 layout(location = 0) out vec4 out_color;
-layout(location = 1) out vec4 out_bright;
 
-void main()
+vec2 signNotZero(vec2 v)
 {
-	vec3 tex = pow(textureLod(u_cube_sampler, v_tex, u_mipmap_level).rgb, vec3(u_gamma));
+	return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Inverse of octahedralDecode in the octahedralEncode shader
+vec2 octahedralEncode(vec3 dir)
+{
+	vec2 p = dir.xz / (abs(dir.x) + abs(dir.y) + abs(dir.z));
+
+	if (dir.y < 0.0)
+	{
+		p = (1.0 - abs(p.yx)) * signNotZero(p);
+	}
 
-	// Tonemapping render target 0
-	out_color = vec4(vec3(1.0) - exp(-tex * u_exposure), 1.0);
+	return p * 0.5 + 0.5;
+}
 
-	// Bloom
-	float brightness = dot(out_color.rgb, vec3(0.2126, 0.7152, 0.0722));
+void main()
+{
+	vec3 tex;
 
-	if (brightness > 1.0)
+	if (u_compact_environment)
 	{
-		out_bright = vec4(tex, 1.0);
+		tex = textureLod(u_octahedral_sampler, vec3(octahedralEncode(v_tex),
+			u_environment_layer), u_mipmap_level).rgb;
 	}
 	else
 	{
-		out_bright = vec4(0.0, 0.0, 0.0, 1.0);
+		tex = textureLod(u_cube_sampler, v_tex, u_mipmap_level).rgb;
 	}
+
+	tex = pow(tex, vec3(u_gamma));
+
+	out_color = vec4(tex, 1.0);
 }
 
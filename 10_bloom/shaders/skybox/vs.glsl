@@ -2,14 +2,20 @@
 
 layout (location = 0) in vec3 a_pos;
 
-uniform mat4 u_view_matrix;
-uniform mat4 u_projection_matrix;
+// Bound by the application from its uniform buffer ring
+layout (std140, binding = 1) uniform ViewBlock
+{
+	mat4 u_view_matrix;
+	mat4 u_projection_matrix;
+	mat4 u_pv_matrix;
+	vec4 u_view_pos;
+};
 
 out vec3 v_tex;
 
 void main()
 {
 	v_tex = a_pos;
-	gl_Position = (u_projection_matrix * u_view_matrix * vec4(a_pos, 1.0)).xyww;
+	gl_Position = (u_projection_matrix * mat4(mat3(u_view_matrix)) * vec4(a_pos, 1.0)).xyww;
 }
 
@@ -2,7 +2,7 @@
 
 #define PI 3.1415926535
 
-in vec3 v_local_position;
+in vec3 g_local_position;
 
 uniform samplerCube u_env_map_sampler;
 uniform float u_roughness;
@@ -49,7 +49,7 @@ vec3 importanceSampleGGX(vec2 xi, vec3 n, float roughness)
 
 void main()
 {
-	vec3 n = normalize(v_local_position);
+	vec3 n = normalize(g_local_position);
 	vec3 r = n;
 	vec3 v = r;
 
@@ -0,0 +1,30 @@
+#version 450 core
+
+// One invocation per cube map face, so the whole
+// cube is rendered with a single draw call
+layout (triangles, invocations = 6) in;
+layout (triangle_strip, max_vertices = 3) out;
+
+in vec3 v_local_position[];
+
+uniform mat4 u_view_matrices[6];
+uniform mat4 u_projection_matrix;
+
+out vec3 g_local_position;
+
+void main()
+{
+	mat4 pv_matrix = u_projection_matrix * u_view_matrices[gl_InvocationID];
+
+	for (int i = 0; i < 3; ++i)
+	{
+		gl_Layer = gl_InvocationID;
+
+		g_local_position = v_local_position[i];
+		gl_Position = pv_matrix * vec4(v_local_position[i], 1.0);
+
+		EmitVertex();
+	}
+
+	EndPrimitive();
+}
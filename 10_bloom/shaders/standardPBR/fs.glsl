@@ -6,31 +6,71 @@ in vec2 v_tex;
 in vec3 v_world_pos;
 in mat3 v_tbn;
 
-uniform vec3 u_view_pos;
-
-uniform samplerCube u_irradiance_sampler;
-uniform samplerCube u_specular_sampler;
-uniform sampler2D u_brdf_lut_sampler;
+// Bound by the application from its uniform buffer ring
+layout (std140, binding = 0) uniform FrameBlock
+{
+	float u_gamma;
+	float u_exposure;
+	float u_environment_layer;
+	bool u_compact_environment;
+};
 
-uniform bool u_has_normal_map;
-uniform bool u_has_ao_map;
-uniform bool u_has_metallic_map;
-uniform bool u_has_roughness_map;
+layout (std140, binding = 1) uniform ViewBlock
+{
+	mat4 u_view_matrix;
+	mat4 u_projection_matrix;
+	mat4 u_pv_matrix;
+	vec4 u_view_pos;
+};
+
+// Used for the properties without a map
+layout (std140, binding = 3) uniform MaterialBlock
+{
+	float u_metallic;
+	float u_roughness;
+};
+
+// Variants are selected by the application, which injects
+// NORMAL_MAP, AO_MAP, METALLIC_MAP, ROUGHNESS_MAP and
+// COMPACT_ENVIRONMENT defines after the #version line.
+// Texture units match the ones the application binds
+#ifdef COMPACT_ENVIRONMENT
+// Octahedral maps, one environment per layer
+layout (binding = 10) uniform sampler2DArray u_irradiance_octahedral_sampler;
+layout (binding = 11) uniform sampler2DArray u_specular_octahedral_sampler;
+#else
+layout (binding = 1) uniform samplerCube u_irradiance_sampler;
+layout (binding = 2) uniform samplerCube u_specular_sampler;
+#endif
+
+layout (binding = 3) uniform sampler2D u_brdf_lut_sampler;
+
+layout (binding = 4) uniform sampler2D u_albedo_sampler;
+layout (binding = 5) uniform sampler2D u_normal_sampler;
+layout (binding = 6) uniform sampler2D u_ao_sampler;
+layout (binding = 7) uniform sampler2D u_metallic_sampler;
+layout (binding = 8) uniform sampler2D u_roughness_sampler;
+
+// HDR, tonemapped by the blender after the bloom
+layout (location = 0) out vec4 out_color;
 
-uniform sampler2D u_albedo_sampler;
-uniform sampler2D u_normal_sampler;
-uniform sampler2D u_ao_sampler;
-uniform sampler2D u_metallic_sampler;
-uniform sampler2D u_roughness_sampler;
+vec2 signNotZero(vec2 v)
+{
+	return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
 
-uniform float u_metallic;
-uniform float u_roughness;
+// Inverse of octahedralDecode in the octahedralEncode shader
+vec2 octahedralEncode(vec3 dir)
+{
+	vec2 p = dir.xz / (abs(dir.x) + abs(dir.y) + abs(dir.z));
 
-uniform float u_gamma;
-uniform float u_exposure;
+	if (dir.y < 0.0)
+	{
+		p = (1.0 - abs(p.yx)) * signNotZero(p);
+	}
 
-layout (location = 0) out vec4 out_color;
-layout (location = 1) out vec4 out_bright;
+	return p * 0.5 + 0.5;
+}
 
 vec3 fresnelSchlick(float h_dot_v, vec3 f_0, float roughness)
 {
@@ -40,49 +80,52 @@ vec3 fresnelSchlick(float h_dot_v, vec3 f_0, float roughness)
 void main()
 {
 	vec3 albedo = pow(texture(u_albedo_sampler, v_tex).rgb, vec3(u_gamma));
-	float ao = 1.0;
-	float metallic = u_metallic;
-	float roughness = u_roughness;
-
-	if (u_has_ao_map)
-	{
-		ao = texture(u_ao_sampler, v_tex).r;
-	}
 
-	if (u_has_metallic_map)
-	{
-		metallic = texture(u_metallic_sampler, v_tex).r;
-	}
+#ifdef AO_MAP
+	float ao = texture(u_ao_sampler, v_tex).r;
+#else
+	float ao = 1.0;
+#endif
 
-	if (u_has_roughness_map)
-	{
-		roughness = texture(u_roughness_sampler, v_tex).r;
-	}
+#ifdef METALLIC_MAP
+	float metallic = texture(u_metallic_sampler, v_tex).r;
+#else
+	float metallic = u_metallic;
+#endif
 
-	vec3 n;
+#ifdef ROUGHNESS_MAP
+	float roughness = texture(u_roughness_sampler, v_tex).r;
+#else
+	float roughness = u_roughness;
+#endif
 
-	if (u_has_normal_map)
-	{
-		n = normalize(texture(u_normal_sampler, v_tex).rgb * 2.0 - 1.0);
-	}
-	else
-	{
-		n = vec3(0.0, 0.0, 1.0);
-	}
+#ifdef NORMAL_MAP
+	vec3 n = normalize(texture(u_normal_sampler, v_tex).rgb * 2.0 - 1.0);
+#else
+	vec3 n = vec3(0.0, 0.0, 1.0);
+#endif
 
 	n = v_tbn * n;
-	vec3 v = normalize(u_view_pos - v_world_pos);
+	vec3 v = normalize(u_view_pos.xyz - v_world_pos);
 	float n_dot_v = max(dot(n, v), 0.0);
 
 	vec3 f_0 = mix(vec3(0.04), albedo, metallic);
 	vec3 f = fresnelSchlick(n_dot_v, f_0, roughness);
 	vec3 k_d = (vec3(1.0) - f) * (1.0 - metallic);
 
-	vec3 irradiance = texture(u_irradiance_sampler, n).rgb;
-	vec3 env_diffuse = irradiance * albedo;
-
 	vec3 r = reflect(-v, n);
+
+#ifdef COMPACT_ENVIRONMENT
+	vec3 irradiance = textureLod(u_irradiance_octahedral_sampler,
+		vec3(octahedralEncode(n), u_environment_layer), 0.0).rgb;
+	vec3 prefiltered_color = textureLod(u_specular_octahedral_sampler,
+		vec3(octahedralEncode(r), u_environment_layer), roughness * 4.0).rgb;
+#else
+	vec3 irradiance = texture(u_irradiance_sampler, n).rgb;
 	vec3 prefiltered_color = textureLod(u_specular_sampler, r, roughness * 4.0).rgb;
+#endif
+
+	vec3 env_diffuse = irradiance * albedo;
 
 	f = fresnelSchlick(n_dot_v, f_0, roughness);
 	vec2 env_brdf = texture(u_brdf_lut_sampler, vec2(n_dot_v, roughness)).rg;
@@ -90,19 +133,6 @@ void main()
 
 	vec3 radiance = (k_d * env_diffuse + env_specular) * ao;
 
-	// Tonemapping render target 0
-	out_color = vec4(vec3(1.0) - exp(-radiance * u_exposure), 1.0);
-
-	// Bloom
-	float brightness = dot(radiance.rgb, vec3(0.2126, 0.7152, 0.0722));
-
-	if (brightness > 1.0)
-	{
-		out_bright = vec4(radiance, 1.0);
-	}
-	else
-	{
-		out_bright = vec4(0.0, 0.0, 0.0, 1.0);
-	}
+	out_color = vec4(radiance, 1.0);
 }
 
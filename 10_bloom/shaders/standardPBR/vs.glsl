@@ -5,9 +5,20 @@ layout (location = 1) in vec3 a_nor;
 layout (location = 2) in vec2 a_tex;
 layout (location = 3) in vec3 a_tan;
 
-uniform mat4 u_model_matrix;
-uniform mat4 u_pv_matrix;
-uniform mat3 u_nor_transform;
+// Bound by the application from its uniform buffer ring
+layout (std140, binding = 1) uniform ViewBlock
+{
+	mat4 u_view_matrix;
+	mat4 u_projection_matrix;
+	mat4 u_pv_matrix;
+	vec4 u_view_pos;
+};
+
+layout (std140, binding = 2) uniform ObjectBlock
+{
+	mat4 u_model_matrix;
+	mat4 u_nor_transform;
+};
 
 out mat3 v_tbn;
 out vec2 v_tex;
@@ -15,9 +26,10 @@ out vec3 v_world_pos;
 
 void main()
 {
+	mat3 nor_transform = mat3(u_nor_transform);
 
-	vec3 n = normalize(u_nor_transform * a_nor);
-	vec3 t = normalize(u_nor_transform * a_tan);
+	vec3 n = normalize(nor_transform * a_nor);
+	vec3 t = normalize(nor_transform * a_tan);
 	t = normalize(t - dot(t, n) * n);
 	vec3 b = normalize(cross(n, t));
 
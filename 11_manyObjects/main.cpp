@@ -0,0 +1,1952 @@
+#include "../common/baseApp.hpp"
+#include "../common/culling.hpp"
+#include "../common/flyThroughCamera.hpp"
+#include "../common/framebuffer.hpp"
+#include "../common/geometryArena.hpp"
+#include "../common/gpuTimer.hpp"
+#include "../common/hiZPyramid.hpp"
+#include "../common/occlusionRasterizer.hpp"
+#include "../common/objParser.hpp"
+#include "../common/programReflection.hpp"
+#include "../common/renderQueue.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+#define WINDOW_WIDTH 1366
+#define WINDOW_HEIGHT 768
+
+// The objects are laid on a square grid of side GRID_SIZE, which
+// can be changed up to MAX_GRID_SIZE. The default is large enough
+// for the balls alone to pass 10,000 once a quarter are cubes
+#define GRID_SIZE 116
+#define MAX_GRID_SIZE 200
+#define GRID_SPACING 2.5f
+
+// Every fourth object is a cube, the rest are material balls
+#define N_MESHES 2
+#define CUBE_FREQUENCY 4
+
+// Metallic and roughness steps of the material table. Materials
+// repeat over the grid in blocks of MATERIAL_STEPS^2 objects
+#define MATERIAL_STEPS 8
+
+// Materials on the diagonal of the table are translucent. Only
+// the render queue draws them blended, the other modes ignore it
+#define TRANSLUCENT_ALPHA 0.4f
+
+// Distance from the camera mapped to the farthest
+// sort key depth, the far plane of the projection
+#define QUEUE_MAX_DEPTH 1000.0f
+
+#define OBJECT_BUFFER_BINDING 0
+#define MATERIAL_BUFFER_BINDING 1
+#define VISIBLE_BUFFER_BINDING 2
+#define BOUNDS_BUFFER_BINDING 3
+#define COMMAND_BUFFER_BINDING 4
+#define DRAW_BUFFER_BINDING 5
+#define DRAW_COUNT_BINDING 0
+#define CULL_STATS_BINDING 6
+
+// local_size_x of the culling shader
+#define CULL_GROUP_SIZE 64
+
+// The CPU tests read back the first level of the
+// Hi-Z pyramid at most this wide
+#define HIZ_READBACK_WIDTH 256
+
+// Resolution of the software occlusion buffer, and the
+// renders averaged by each step of its benchmark
+#define OCCLUSION_BUFFER_WIDTH 320
+#define OCCLUSION_BUFFER_HEIGHT 180
+#define OCCLUSION_BENCHMARK_RUNS 20
+
+#define GEOMETRY_ARENA_VERTEX_BYTES (16 << 20)
+#define GEOMETRY_ARENA_INDICES (4 << 20)
+
+void onKey(GLFWwindow* window, int key, int, int action, int mods);
+void onMouseMove(GLFWwindow* window, double xpos, double ypos);
+void onMouseButton(GLFWwindow* window, int button, int action, int);
+void windowResize(GLFWwindow* window, int width, int height);
+
+class Application : public BaseApplication
+{
+public:
+	Application(
+		std::string const& title = "Application",
+		int window_width = 800,
+		int window_height = 600,
+		bool show_info = true,
+		bool fullscreen = false)
+		:
+		BaseApplication(
+			title,
+			window_width,
+			window_height,
+			show_info,
+			fullscreen)
+	{
+		amb_light_color = glm::vec3(0.03f, 0.03f, 0.03f);
+
+		dir_light_direction = glm::vec3(-1.0f, -1.0f, -0.5f);
+		dir_light_color = glm::vec3(1.0f, 1.0f, 1.0f);
+
+		camera = FlyThroughCamera(glm::vec3(0.0f, 30.0f, 0.0f), 45.0f, -30.0f);
+		camera.move_speed = 20.0f;
+	}
+
+	~Application()
+	{}
+
+	void moveForward(bool state)
+	{
+		forward = state;
+	}
+
+	void moveBackward(bool state)
+	{
+		backward = state;
+	}
+
+	void moveLeft(bool state)
+	{
+		left = state;
+	}
+
+	void moveRight(bool state)
+	{
+		right = state;
+	}
+
+	void moveUp(bool state)
+	{
+		up = state;
+	}
+
+	void moveDown(bool state)
+	{
+		down = state;
+	}
+
+	void updateMousePos(double x, double y)
+	{
+		mouse_x = x;
+		mouse_y = y;
+	}
+
+	void mouseGrab(bool state)
+	{
+		mouse_grab = state;
+	}
+
+	void fastCamera(bool fast)
+	{
+		camera.fast(fast);
+	}
+
+	void setProjection(glm::mat4&& proj)
+	{
+		projection = proj;
+	}
+
+	void setWindowSize(int width, int height)
+	{
+		window_width = width;
+		window_height = height;
+
+		glViewport(0, 0, window_width, window_height);
+
+		destroySceneTargets();
+		createSceneTargets();
+
+		// The render targets were recreated and may reuse old names
+		gl.invalidateState();
+	}
+
+private:
+	/// std430 mirrors of the shader storage blocks
+	// Array elements are rounded up to a multiple of a vec4
+	struct ObjectData
+	{
+		glm::mat4 model_matrix;
+		GLint material;
+		GLint padding[3];
+	};
+
+	struct MaterialData
+	{
+		glm::vec4 albedo;
+		float metallic;
+		float roughness;
+		float padding[2];
+	};
+
+	// Objects and triangles rejected by each test. Counted by the CPU
+	// paths, and by the culling shader in a buffer of the same layout
+	struct CullStats
+	{
+		GLuint frustum_objects;
+		GLuint frustum_triangles;
+		GLuint occlusion_objects;
+		GLuint occlusion_triangles;
+	};
+
+	// Element of the instance stream, read as vertex attributes
+	struct InstanceData
+	{
+		glm::mat4 model_matrix;
+		GLint material;
+	};
+
+	// Locations of the uniforms set every frame, resolved once after linking
+	struct SceneUniforms
+	{
+		GLint pv_matrix;
+		GLint view_pos;
+		GLint amb_light_color;
+		GLint dir_light_direction;
+		GLint dir_light_color;
+		GLint gamma;
+		GLint exposure;
+
+		// Only used by the batched program
+		GLint first_object = -1;
+		GLint material = -1;
+	};
+
+	enum DrawMode
+	{
+		DRAW_DIRECT = 0,
+		DRAW_INSTANCED = 1,
+		DRAW_MULTI_INDIRECT = 2,
+		DRAW_QUEUED = 3
+	};
+
+	// Passes of the render queue, in submission order
+	enum RenderPass
+	{
+		PASS_OPAQUE = 0,
+		PASS_TRANSLUCENT = 1
+	};
+
+	enum CullingMode
+	{
+		CULLING_OFF = 0,
+		CULLING_SCALAR = 1,
+		CULLING_SIMD = 2,
+		CULLING_BVH = 3,
+		CULLING_GPU = 4
+	};
+
+	enum HiZBuild
+	{
+		HIZ_COMPUTE = 0,
+		HIZ_FRAGMENT = 1
+	};
+
+	// What the CPU culling paths test against
+	enum OcclusionSource
+	{
+		OCCLUSION_HIZ = 0,
+		OCCLUSION_RASTERIZER = 1
+	};
+
+	bool customInit() override
+	{
+		glfwSetKeyCallback(window, onKey);
+		glfwSetCursorPosCallback(window, onMouseMove);
+		glfwSetMouseButtonCallback(window, onMouseButton);
+		glfwSetWindowSizeCallback(window, windowResize);
+
+		scene_framebuffer = new Framebuffer();
+		createSceneTargets();
+
+		rasterizer = new OcclusionRasterizer(OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT);
+		occlusion_threads = static_cast<int>(rasterizer->getThreadCount());
+
+		windowResize(window, window_width, window_height);
+
+		if (!gl.hasExtension("GL_ARB_shader_draw_parameters"))
+		{
+			std::cerr << "ERROR: GL_ARB_shader_draw_parameters is not supported\n";
+			return false;
+		}
+
+		geometry_arena = GeometryArena(GEOMETRY_ARENA_VERTEX_BYTES, GEOMETRY_ARENA_INDICES);
+
+		if (!createProgram("batched", batched_program) ||
+			!createProgram("instanced", instanced_program) ||
+			!createComputeProgram("cull", cull_program) ||
+			!createComputeProgram("hiZ", hiz_program) ||
+			!createProgram("hiZFragment", hiz_fragment_program) ||
+			!createMaterialBall() ||
+			!createCube())
+		{
+			return false;
+		}
+
+		resolveUniforms();
+
+		createMaterials();
+		createObjects();
+
+		// The draw count is reset before every culling pass
+		GLuint zero = 0u;
+
+		glCreateBuffers(1, &draw_count_buffer);
+		glNamedBufferStorage(draw_count_buffer, sizeof(GLuint), &zero, GL_DYNAMIC_STORAGE_BIT);
+
+		CullStats zero_stats = {};
+
+		glCreateBuffers(1, &cull_stats_buffer);
+		glNamedBufferStorage(cull_stats_buffer, sizeof(CullStats), &zero_stats,
+			GL_DYNAMIC_STORAGE_BIT);
+
+		// The draw count followed by the stats
+		glCreateBuffers(2, count_readback_buffers);
+
+		for (int i = 0; i < 2; ++i)
+		{
+			glNamedBufferStorage(count_readback_buffers[i],
+				sizeof(GLuint) + sizeof(CullStats), nullptr, 0);
+		}
+
+		glClearColor(0.10, 0.25, 0.15, 1.0);
+
+		// Only enabled by the translucent pass of the render queue
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+		gl.enable(GL_DEPTH_TEST);
+		gl.enable(GL_CULL_FACE);
+
+		if (OpenGLContext::checkErrors(__FILE__, __LINE__))
+		{
+			return false;
+		}
+
+		return true;
+	}
+
+	bool customLoop(double delta_time) override
+	{
+		gl.bindFramebuffer(scene_framebuffer->getId());
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		buildGUI();
+
+		if (grid_size != built_grid_size)
+		{
+			destroyObjects();
+			createObjects();
+		}
+
+		updateCamera(delta_time);
+
+		glm::vec3 camera_position = camera.new_position;
+		glm::mat4 view_matrix = camera.getViewMatrix();
+
+		glm::mat4 pv_matrix = projection * view_matrix;
+
+		if (culling_mode == CULLING_GPU)
+		{
+			cullObjectsGPU(pv_matrix);
+		}
+		else
+		{
+			cullObjects(pv_matrix);
+			updateVisibleObjects();
+		}
+
+		// GPU culling always draws with one indirect count call from
+		// the batched buffers, whatever the draw mode was left at
+		bool instanced = culling_mode != CULLING_GPU && draw_mode == DRAW_INSTANCED;
+
+		ProgramReflection const& program = instanced ? instanced_program : batched_program;
+		SceneUniforms const& uniforms = instanced ? instanced_uniforms : batched_uniforms;
+
+		GLuint program_id = program.getId();
+
+		gl.useProgram(program_id);
+
+		gl.setUniform(program_id, uniforms.pv_matrix,
+			projection * view_matrix);
+		gl.setUniform(program_id, uniforms.view_pos,
+			camera_position);
+
+		gl.setUniform(program_id, uniforms.amb_light_color,
+			amb_light_color);
+		gl.setUniform(program_id, uniforms.dir_light_direction,
+			dir_light_direction);
+		gl.setUniform(program_id, uniforms.dir_light_color,
+			dir_light_color);
+
+		gl.setUniform(program_id, uniforms.gamma, gamma_correction);
+		gl.setUniform(program_id, uniforms.exposure, exposure);
+
+		drawObjects();
+
+		glBlitNamedFramebuffer(scene_framebuffer->getId(), 0,
+			0, 0, window_width, window_height,
+			0, 0, window_width, window_height,
+			GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+		// For the occlusion tests of the next frames. The CPU tests
+		// read a small level back, a few frames late
+		if (culling_mode != CULLING_OFF && occlusion_culling)
+		{
+			buildHiZ();
+
+			hiz_pv_matrix = pv_matrix;
+			hiz_valid = true;
+
+			if (culling_mode != CULLING_GPU && occlusion_source == OCCLUSION_HIZ)
+			{
+				hiz.requestReadback(hiz_readback_level, pv_matrix);
+			}
+		}
+		else
+		{
+			hiz_valid = false;
+		}
+
+		gl.bindFramebuffer(0u);
+
+		return true;
+	}
+
+	void buildHiZ()
+	{
+		hiz_timer.begin();
+
+		if (hiz_build == HIZ_FRAGMENT)
+		{
+			gl.disable(GL_DEPTH_TEST);
+			hiz.buildWithFragments(gl, hiz_fragment_program, scene_depth);
+			gl.enable(GL_DEPTH_TEST);
+		}
+		else
+		{
+			hiz.build(gl, hiz_program, scene_depth);
+		}
+
+		hiz_timer.end();
+	}
+
+	// Fills visible_objects with the indices of the objects that
+	// intersect the frustum, in object order. Those hidden behind the
+	// latest Hi-Z readback, or behind the cubes rasterized on the CPU,
+	// are dropped too. The lists aren't timed
+	void cullObjects(glm::mat4 const& pv_matrix)
+	{
+		if (!freeze_culling)
+		{
+			culling_frustum = extractFrustum(pv_matrix);
+		}
+
+		CullingVolume volume = static_cast<CullingVolume>(culling_volume);
+
+		// Keeps the most recent readback that's ready
+		while (hiz.fetchReadback(hiz_readback))
+		{}
+
+		bool occlusion = culling_mode != CULLING_OFF && occlusion_culling;
+
+		bool software_occlusion = occlusion && occlusion_source == OCCLUSION_RASTERIZER;
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		switch (culling_mode)
+		{
+		case CULLING_OFF:
+			std::fill(object_visible.begin(), object_visible.end(), 1u);
+			break;
+
+		case CULLING_SCALAR:
+			cullScalar(culling_frustum, object_bounds, volume, object_visible);
+			break;
+
+		case CULLING_SIMD:
+			cullSIMD(culling_frustum, object_bounds, volume, object_visible);
+			break;
+
+		case CULLING_BVH:
+			bvh.cull(culling_frustum, volume, object_visible);
+			break;
+		}
+
+		if (software_occlusion)
+		{
+			renderOccluders(pv_matrix);
+		}
+
+		cull_stats = CullStats();
+
+		for (size_t i = 0u; i < n_objects; ++i)
+		{
+			GLuint n_triangles = commands[i].count / 3u;
+			glm::vec3 center(object_bounds.center_x[i], object_bounds.center_y[i],
+				object_bounds.center_z[i]);
+			glm::vec3 extent(object_bounds.extent_x[i], object_bounds.extent_y[i],
+				object_bounds.extent_z[i]);
+
+			if (!object_visible[i])
+			{
+				++cull_stats.frustum_objects;
+				cull_stats.frustum_triangles += n_triangles;
+			}
+			else if (software_occlusion ? rasterizer->isOccluded(center, extent) :
+				occlusion && isOccluded(hiz_readback, center, extent))
+			{
+				object_visible[i] = 0u;
+
+				++cull_stats.occlusion_objects;
+				cull_stats.occlusion_triangles += n_triangles;
+			}
+		}
+
+		auto end = std::chrono::high_resolution_clock::now();
+		cull_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+		visible_objects.clear();
+
+		for (size_t i = 0u; i < n_objects; ++i)
+		{
+			if (object_visible[i])
+			{
+				visible_objects.push_back(static_cast<GLuint>(i));
+			}
+		}
+
+		n_visible = visible_objects.size();
+	}
+
+	// The cubes that survived the frustum test are the occluders. The
+	// balls are too thin to hide much. Each cube hides the objects
+	// behind it but never itself, its box being nearer than its faces
+	void renderOccluders(glm::mat4 const& pv_matrix)
+	{
+		occluders.clear();
+
+		size_t first = mesh_first_objects[1];
+
+		for (size_t i = first; i < first + mesh_object_counts[1]; ++i)
+		{
+			if (object_visible[i])
+			{
+				occluders.push_back(Occluder{ &cube_occluder, instances[i].model_matrix });
+			}
+		}
+
+		occluder_pv_matrix = pv_matrix;
+
+		rasterizer->setActiveThreads(static_cast<unsigned>(occlusion_threads));
+		rasterizer->clear();
+		rasterizer->render(occluders, pv_matrix);
+	}
+
+	// Renders the latest occluders with every thread count, reporting
+	// the triangles rasterized per millisecond by each thread
+	void benchmarkRasterizer()
+	{
+		unsigned n_threads = rasterizer->getThreadCount();
+
+		benchmark_results.assign(n_threads, 0.0);
+
+		std::cout << "Occlusion rasterizer, " << occluders.size() << " occluders, " <<
+			(rasterizer->hasAVX2() ? "AVX2" : "scalar") << " coverage\n";
+
+		for (unsigned i = 1u; i <= n_threads; ++i)
+		{
+			rasterizer->setActiveThreads(i);
+
+			double total_ms = 0.0;
+			unsigned triangles = 0u;
+
+			for (int j = 0; j < OCCLUSION_BENCHMARK_RUNS; ++j)
+			{
+				rasterizer->clear();
+				rasterizer->render(occluders, occluder_pv_matrix);
+
+				total_ms += rasterizer->getStats().render_ms;
+				triangles = rasterizer->getStats().triangles;
+			}
+
+			double ms = total_ms / OCCLUSION_BENCHMARK_RUNS;
+
+			benchmark_results[i - 1u] = triangles / std::max(ms, 0.000001) / i;
+
+			std::cout << "    " << i << " threads: " << ms << " ms, " <<
+				benchmark_results[i - 1u] << " triangles/ms/core\n";
+		}
+
+		// Leaves the buffer as the culling found it
+		rasterizer->setActiveThreads(static_cast<unsigned>(occlusion_threads));
+		rasterizer->clear();
+		rasterizer->render(occluders, occluder_pv_matrix);
+	}
+
+	// Culls in a compute shader that appends the commands of the
+	// visible objects to the indirect buffer, counting them in
+	// draw_count_buffer. The calls issued don't depend on the number
+	// of objects. Objects hidden in the depth of the previous frame
+	// are rejected too, so those uncovered by a fast camera motion
+	// can pop in a frame late
+	void cullObjectsGPU(glm::mat4 const& pv_matrix)
+	{
+		if (!freeze_culling)
+		{
+			culling_frustum = extractFrustum(pv_matrix);
+		}
+
+		// The CPU path must upload its lists again when it takes over
+		visible_dirty = true;
+
+		// The count and stats of a previous frame are read once its fence
+		// has signaled. A readback still in flight is left alone, and the
+		// count of this frame isn't copied, rather than waiting for it
+		GLuint readback = count_readback_buffers[next_count_readback % 2];
+		GLsync& readback_fence = count_readback_fences[next_count_readback % 2];
+
+		if (readback_fence)
+		{
+			GLenum status = glClientWaitSync(readback_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+
+			if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+			{
+				glDeleteSync(readback_fence);
+				readback_fence = nullptr;
+
+				GLuint count;
+				glGetNamedBufferSubData(readback, 0, sizeof(GLuint), &count);
+				glGetNamedBufferSubData(readback, sizeof(GLuint), sizeof(CullStats),
+					&cull_stats);
+
+				n_visible = count;
+			}
+		}
+
+		cull_timer.begin();
+
+		GLuint zero = 0u;
+		CullStats zero_stats = {};
+
+		glNamedBufferSubData(draw_count_buffer, 0, sizeof(GLuint), &zero);
+		glNamedBufferSubData(cull_stats_buffer, 0, sizeof(CullStats), &zero_stats);
+
+		GLuint program_id = cull_program.getId();
+
+		gl.useProgram(program_id);
+
+		glProgramUniform4fv(program_id, cull_uniforms.planes, 6,
+			glm::value_ptr(culling_frustum.planes[0]));
+
+		gl.setUniform(program_id, cull_uniforms.n_objects,
+			static_cast<int>(n_objects));
+		gl.setUniform(program_id, cull_uniforms.volume, culling_volume);
+
+		bool occlusion = occlusion_culling && hiz_valid;
+
+		gl.setUniform(program_id, cull_uniforms.occlusion, occlusion ? 1 : 0);
+
+		if (occlusion)
+		{
+			gl.setUniform(program_id, cull_uniforms.hiz_pv_matrix, hiz_pv_matrix);
+			gl.setUniform(program_id, cull_uniforms.hiz_levels, hiz.getLevels());
+
+			gl.bindTextureUnit(0u, hiz.getTexture().getId());
+		}
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_BUFFER_BINDING, visible_buffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BOUNDS_BUFFER_BINDING, bounds_buffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BUFFER_BINDING, command_buffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_BUFFER_BINDING, indirect_buffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_STATS_BINDING, cull_stats_buffer);
+		glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, DRAW_COUNT_BINDING, draw_count_buffer);
+
+		glDispatchCompute(static_cast<GLuint>(
+			(n_objects + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE), 1u, 1u);
+
+		// The draw reads the commands, their count and the visible list,
+		// and the count and stats are copied out for the GUI
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT |
+			GL_ATOMIC_COUNTER_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+		if (!readback_fence)
+		{
+			glCopyNamedBufferSubData(draw_count_buffer, readback, 0, 0, sizeof(GLuint));
+			glCopyNamedBufferSubData(cull_stats_buffer, readback, 0, sizeof(GLuint),
+				sizeof(CullStats));
+
+			readback_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+			++next_count_readback;
+		}
+
+		cull_timer.end();
+	}
+
+	// Uploads the visible list, and the instances and commands of the
+	// visible objects, when it differs from the one last uploaded. The
+	// list stays in object order, so the objects of a mesh are still a
+	// contiguous range of it
+	void updateVisibleObjects()
+	{
+		if (!visible_dirty && visible_objects == uploaded_objects)
+		{
+			return;
+		}
+
+		visible_dirty = false;
+		uploaded_objects = visible_objects;
+
+		for (int i = 0; i < N_MESHES; ++i)
+		{
+			auto first = std::lower_bound(visible_objects.begin(), visible_objects.end(),
+				static_cast<GLuint>(mesh_first_objects[i]));
+			auto last = std::lower_bound(first, visible_objects.end(),
+				static_cast<GLuint>(mesh_first_objects[i] + mesh_object_counts[i]));
+
+			mesh_first_visible[i] = first - visible_objects.begin();
+			mesh_visible_counts[i] = last - first;
+		}
+
+		if (visible_objects.empty())
+		{
+			return;
+		}
+
+		std::vector<InstanceData> visible_instances;
+		std::vector<DrawElementsIndirectCommand> visible_commands;
+
+		visible_instances.reserve(visible_objects.size());
+		visible_commands.reserve(visible_objects.size());
+
+		for (auto it : visible_objects)
+		{
+			visible_instances.push_back(instances[it]);
+			visible_commands.push_back(commands[it]);
+		}
+
+		glNamedBufferSubData(visible_buffer, 0,
+			visible_objects.size() * sizeof(GLuint), visible_objects.data());
+		glNamedBufferSubData(instance_buffer, 0,
+			visible_instances.size() * sizeof(InstanceData), visible_instances.data());
+		glNamedBufferSubData(indirect_buffer, 0,
+			visible_commands.size() * sizeof(DrawElementsIndirectCommand),
+			visible_commands.data());
+	}
+
+	// The GPU time is measured with a timer query, read
+	// back once it's available to avoid stalling
+	void drawObjects()
+	{
+		draw_timer.begin();
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BUFFER_BINDING, object_buffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BUFFER_BINDING, material_buffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_BUFFER_BINDING, visible_buffer);
+
+		if (culling_mode == CULLING_GPU)
+		{
+			drawIndirectCount();
+		}
+		else
+		{
+			switch (draw_mode)
+			{
+			case DRAW_DIRECT:
+				drawDirect();
+				break;
+
+			case DRAW_INSTANCED:
+				drawInstanced();
+				break;
+
+			case DRAW_MULTI_INDIRECT:
+				drawMultiIndirect();
+				break;
+
+			case DRAW_QUEUED:
+				drawQueued();
+				break;
+			}
+		}
+
+		auto end = std::chrono::high_resolution_clock::now();
+		draw_cpu_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+		draw_timer.end();
+	}
+
+	// One draw and one uniform update per visible object
+	void drawDirect()
+	{
+		GLuint program_id = batched_program.getId();
+
+		// Both meshes live in the arena with the same layout,
+		// so binding one of them binds the buffers of all
+		gl.bindMesh(meshes[0]);
+
+		for (int i = 0; i < N_MESHES; ++i)
+		{
+			for (size_t j = 0u; j < mesh_visible_counts[i]; ++j)
+			{
+				gl.setUniform(program_id, batched_uniforms.first_object,
+					static_cast<int>(mesh_first_visible[i] + j));
+				gl.drawMesh(meshes[i]);
+			}
+		}
+
+		n_draw_calls = static_cast<unsigned>(visible_objects.size());
+	}
+
+	// One draw per mesh. The visible objects of a mesh
+	// are contiguous in the instance stream
+	void drawInstanced()
+	{
+		n_draw_calls = 0u;
+
+		for (int i = 0; i < N_MESHES; ++i)
+		{
+			if (mesh_visible_counts[i] == 0u)
+			{
+				continue;
+			}
+
+			gl.bindMesh(instanced_meshes[i]);
+			gl.drawMeshInstanced(instanced_meshes[i],
+				static_cast<GLsizei>(mesh_visible_counts[i]),
+				static_cast<GLuint>(mesh_first_visible[i]));
+
+			++n_draw_calls;
+		}
+	}
+
+	// One draw for everything, each command being a visible object
+	void drawMultiIndirect()
+	{
+		if (visible_objects.empty())
+		{
+			n_draw_calls = 0u;
+			return;
+		}
+
+		gl.setUniform(batched_program.getId(),
+			batched_uniforms.first_object, 0);
+
+		gl.bindMesh(meshes[0]);
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr,
+			static_cast<GLsizei>(visible_objects.size()), sizeof(DrawElementsIndirectCommand));
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+		n_draw_calls = 1u;
+	}
+
+	// One draw per visible object, in render queue order. Every draw
+	// sets its pass state, program, material and mesh through the state
+	// cache, so unsorted draws issue a call each time one of them changes
+	void drawQueued()
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		render_queue.clear();
+
+		for (size_t i = 0u; i < visible_objects.size(); ++i)
+		{
+			GLuint object = visible_objects[i];
+
+			unsigned mesh = object >= mesh_first_objects[1] ? 1u : 0u;
+			unsigned material = static_cast<unsigned>(instances[object].material);
+			bool translucent = material_translucent[material];
+
+			glm::vec3 center(object_bounds.center_x[object], object_bounds.center_y[object],
+				object_bounds.center_z[object]);
+
+			float depth = glm::length(center - camera.new_position) / QUEUE_MAX_DEPTH;
+
+			// There's a single program, so that field is always 0
+			render_queue.push(makeSortKey(
+				translucent ? PASS_TRANSLUCENT : PASS_OPAQUE,
+				translucent ? BACK_TO_FRONT : FRONT_TO_BACK,
+				0u, material, mesh, depth), static_cast<uint32_t>(i));
+		}
+
+		unsorted_queue_stats = render_queue.countStateChanges();
+
+		if (sort_draws)
+		{
+			render_queue.sort();
+		}
+
+		queue_stats = render_queue.countStateChanges();
+
+		auto end = std::chrono::high_resolution_clock::now();
+		queue_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+		GLuint program_id = batched_program.getId();
+
+		unsigned pass = ~0u;
+
+		for (size_t i = 0u; i < render_queue.getSize(); ++i)
+		{
+			uint64_t key = render_queue.getKey(i);
+
+			if (sortKeyPass(key) != pass)
+			{
+				pass = sortKeyPass(key);
+
+				if (pass == PASS_TRANSLUCENT)
+				{
+					gl.enable(GL_BLEND);
+					glDepthMask(GL_FALSE);
+				}
+				else
+				{
+					gl.disable(GL_BLEND);
+					glDepthMask(GL_TRUE);
+				}
+			}
+
+			DeviceMesh const& mesh = meshes[sortKeyMesh(key)];
+
+			gl.useProgram(program_id);
+			gl.setUniform(program_id, batched_uniforms.material, static_cast<int>(sortKeyMaterial(key)));
+			gl.bindMesh(mesh);
+
+			gl.setUniform(program_id, batched_uniforms.first_object,
+				static_cast<int>(render_queue.getDraw(i)));
+			gl.drawMesh(mesh);
+		}
+
+		gl.disable(GL_BLEND);
+		glDepthMask(GL_TRUE);
+
+		// The other modes read the material of the object
+		gl.setUniform(program_id, batched_uniforms.material, -1);
+
+		n_draw_calls = static_cast<unsigned>(render_queue.getSize());
+	}
+
+	// The commands and their count were written by the culling shader
+	void drawIndirectCount()
+	{
+		gl.setUniform(batched_program.getId(),
+			batched_uniforms.first_object, 0);
+
+		gl.bindMesh(meshes[0]);
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer);
+		glBindBuffer(GL_PARAMETER_BUFFER, draw_count_buffer);
+
+		gl.multiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, 0, 0,
+			static_cast<GLsizei>(n_objects), sizeof(DrawElementsIndirectCommand));
+
+		glBindBuffer(GL_PARAMETER_BUFFER, 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+		n_draw_calls = 1u;
+	}
+
+	void customDestroy() override
+	{
+		gl.deleteProgram(batched_program.getId());
+		gl.deleteProgram(instanced_program.getId());
+		gl.deleteProgram(cull_program.getId());
+		gl.deleteProgram(hiz_program.getId());
+		gl.deleteProgram(hiz_fragment_program.getId());
+
+		destroyObjects();
+
+		glDeleteBuffers(1, &material_buffer);
+		glDeleteBuffers(1, &draw_count_buffer);
+		glDeleteBuffers(1, &cull_stats_buffer);
+		glDeleteBuffers(2, count_readback_buffers);
+
+		for (GLsync fence : count_readback_fences)
+		{
+			if (fence)
+			{
+				glDeleteSync(fence);
+			}
+		}
+
+		draw_timer.destroy();
+		cull_timer.destroy();
+		hiz_timer.destroy();
+
+		destroySceneTargets();
+		scene_framebuffer->destroy();
+		delete scene_framebuffer;
+
+		rasterizer->destroy();
+		delete rasterizer;
+
+		for (int i = 0; i < N_MESHES; ++i)
+		{
+			geometry_arena.release(meshes[i]);
+		}
+
+		gl.destroyVertexLayouts();
+
+		geometry_arena.destroy();
+	}
+
+	void buildGUI()
+	{
+		using namespace ImGui;
+
+		/// OBJECTS
+		Begin("Objects");
+
+		SliderInt("Grid size", &grid_size, 1, MAX_GRID_SIZE);
+		Text("%zu objects", n_objects);
+
+		Dummy(ImVec2(0.0f, 2.0f));
+		Separator();
+
+		Text("Draw mode");
+
+		if (culling_mode == CULLING_GPU)
+		{
+			Text("glMultiDrawElementsIndirectCount, from the culling shader");
+		}
+		else
+		{
+			RadioButton("glDrawElementsBaseVertex per object", &draw_mode, DRAW_DIRECT);
+			RadioButton("glDrawElementsInstanced per mesh", &draw_mode, DRAW_INSTANCED);
+			RadioButton("glMultiDrawElementsIndirect", &draw_mode, DRAW_MULTI_INDIRECT);
+			RadioButton("Render queue, one draw per object", &draw_mode, DRAW_QUEUED);
+		}
+
+		if (culling_mode != CULLING_GPU && draw_mode == DRAW_QUEUED)
+		{
+			Checkbox("Sort draws", &sort_draws);
+
+			Text("Queue build and sort: %.3f ms", queue_ms);
+			Text("Changes       Culling order   Submitted");
+			Text("Passes        %13u   %9u", unsorted_queue_stats.pass_changes,
+				queue_stats.pass_changes);
+			Text("Programs      %13u   %9u", unsorted_queue_stats.program_changes,
+				queue_stats.program_changes);
+			Text("Materials     %13u   %9u", unsorted_queue_stats.material_changes,
+				queue_stats.material_changes);
+			Text("Meshes        %13u   %9u", unsorted_queue_stats.mesh_changes,
+				queue_stats.mesh_changes);
+		}
+
+		Dummy(ImVec2(0.0f, 2.0f));
+		Separator();
+
+		Text("Culling");
+		RadioButton("Off", &culling_mode, CULLING_OFF);
+		RadioButton("Scalar loop", &culling_mode, CULLING_SCALAR);
+		RadioButton(cullingUsesAVX() ? "AVX loop, 8 objects per test" :
+			"SSE loop, 4 objects per test", &culling_mode, CULLING_SIMD);
+		RadioButton("BVH, 4 children per test", &culling_mode, CULLING_BVH);
+
+		if (gl.hasIndirectCount())
+		{
+			RadioButton("Compute shader", &culling_mode, CULLING_GPU);
+		}
+		else
+		{
+			Text("Compute shader culling needs indirect count support");
+		}
+
+		Dummy(ImVec2(0.0f, 2.0f));
+
+		RadioButton("Spheres", &culling_volume, CULL_SPHERES);
+		SameLine();
+		RadioButton("Boxes", &culling_volume, CULL_BOXES);
+
+		Checkbox("Freeze frustum", &freeze_culling);
+
+		if (culling_mode != CULLING_OFF)
+		{
+			Checkbox("Occlusion culling", &occlusion_culling);
+		}
+
+		if (culling_mode != CULLING_OFF && culling_mode != CULLING_GPU && occlusion_culling)
+		{
+			RadioButton("Hi-Z readback", &occlusion_source, OCCLUSION_HIZ);
+			SameLine();
+			RadioButton("Software rasterizer", &occlusion_source, OCCLUSION_RASTERIZER);
+		}
+
+		bool software_occlusion = culling_mode != CULLING_OFF &&
+			culling_mode != CULLING_GPU && occlusion_culling &&
+			occlusion_source == OCCLUSION_RASTERIZER;
+
+		if (software_occlusion)
+		{
+			OcclusionRasterizerStats const& stats = rasterizer->getStats();
+
+			SliderInt("Threads", &occlusion_threads, 1,
+				static_cast<int>(rasterizer->getThreadCount()));
+
+			Text("%dx%d, %s coverage", rasterizer->getWidth(), rasterizer->getHeight(),
+				rasterizer->hasAVX2() ? "AVX2" : "scalar");
+			Text("%zu occluders, %u triangles", occluders.size(), stats.triangles);
+			Text("Rasterization: %.3f ms, %.1f triangles/ms/core", stats.render_ms,
+				stats.triangles / std::max(stats.render_ms, 0.000001) / stats.threads);
+
+			if (Button("Benchmark"))
+			{
+				benchmarkRasterizer();
+			}
+
+			for (size_t i = 0u; i < benchmark_results.size(); ++i)
+			{
+				Text("    %zu threads: %.1f triangles/ms/core", i + 1u, benchmark_results[i]);
+			}
+		}
+		else if (culling_mode != CULLING_OFF && occlusion_culling)
+		{
+			RadioButton("Compute reduction", &hiz_build, HIZ_COMPUTE);
+			SameLine();
+			RadioButton("Fragment reduction", &hiz_build, HIZ_FRAGMENT);
+
+			Text("Hi-Z build (GPU): %.3f ms", hiz_timer.getMilliseconds());
+
+			if (culling_mode == CULLING_GPU)
+			{
+				Text("Tested against the pyramid of the previous frame");
+			}
+			else
+			{
+				Text("Tested against level %d (%dx%d), read back asynchronously",
+					hiz_readback.level, hiz_readback.width, hiz_readback.height);
+			}
+		}
+
+		Dummy(ImVec2(0.0f, 2.0f));
+		Separator();
+
+		Text("Visible: %zu", n_visible);
+		Text("Culled: %zu", n_objects - std::min(n_visible, n_objects));
+		Text("Frustum rejected: %u objects, %u triangles",
+			cull_stats.frustum_objects, cull_stats.frustum_triangles);
+		Text("Occlusion rejected: %u objects, %u triangles",
+			cull_stats.occlusion_objects, cull_stats.occlusion_triangles);
+
+		if (culling_mode == CULLING_GPU)
+		{
+			Text("Cull time (GPU): %.3f ms", cull_timer.getMilliseconds());
+		}
+		else
+		{
+			Text("Cull time: %.3f ms", cull_ms);
+		}
+
+		if (culling_mode == CULLING_BVH)
+		{
+			BVHStats bvh_stats = bvh.getStats();
+
+			Text("BVH nodes: %u (%u visited)", bvh_stats.nodes, bvh_stats.visited_nodes);
+			Text("Objects tested in leaves: %u", bvh_stats.tested_objects);
+		}
+
+		Dummy(ImVec2(0.0f, 2.0f));
+		Separator();
+
+		Text("Draw calls: %u", n_draw_calls);
+		Text("CPU submission: %.3f ms", draw_cpu_ms);
+		Text("GPU: %.3f ms", draw_timer.getMilliseconds());
+
+		End();
+
+		/// LIGHTS
+		Begin("Lights");
+
+		ColorPicker3("Ambient", glm::value_ptr(amb_light_color));
+
+		Dummy(ImVec2(0.0f, 2.0f));
+		Separator();
+
+		SliderFloat("Direction X", &dir_light_direction.x, -1.0f, 1.0f);
+		SliderFloat("Direction Y", &dir_light_direction.y, -1.0f, 1.0f);
+		SliderFloat("Direction Z", &dir_light_direction.z, -1.0f, 1.0f);
+		ColorPicker3("Directional", glm::value_ptr(dir_light_color));
+
+		End();
+
+		/// CAMERA
+		Begin("Camera");
+
+		Dummy(ImVec2(0.0f, 2.0f));
+
+		Text("To move the camera use WASD and QE keys");
+		Text("To look around click and drag with RMB");
+
+		Dummy(ImVec2(0.0f, 2.0f));
+		Separator();
+
+		SliderFloat("Move Speed", &camera.move_speed, 1.0f, 100.0f);
+		SliderFloat("Look Speed", &camera.look_speed, 1.0f, 20.0f);
+
+		Dummy(ImVec2(0.0f, 2.0f));
+		Separator();
+
+		SliderFloat("Gamma", &gamma_correction, 0.1f, 5.0f);
+		SliderFloat("Exposure", &exposure, 0.1f, 5.0f);
+
+		End();
+	}
+
+	void updateCamera(float delta_time)
+	{
+		if (forward)
+		{
+			camera.move(CameraDirection::FORWARD, delta_time);
+		}
+		else if (backward)
+		{
+			camera.move(CameraDirection::BACKWARD, delta_time);
+		}
+
+		if (left)
+		{
+			camera.move(CameraDirection::LEFT, delta_time);
+		}
+		else if (right)
+		{
+			camera.move(CameraDirection::RIGHT, delta_time);
+		}
+
+		if (up)
+		{
+			camera.move(CameraDirection::UP, delta_time);
+		}
+		else if (down)
+		{
+			camera.move(CameraDirection::DOWN, delta_time);
+		}
+
+		if (mouse_grab)
+		{
+			camera.look(mouse_last_x - mouse_x, mouse_last_y - mouse_y, delta_time);
+		}
+
+		mouse_last_x = mouse_x;
+		mouse_last_y = mouse_y;
+	}
+
+	// Looked up once, so that drawing doesn't hash uniform names
+	SceneUniforms sceneUniforms(ProgramReflection const& program) const
+	{
+		SceneUniforms uniforms;
+
+		uniforms.pv_matrix = program.uniform("u_pv_matrix");
+		uniforms.view_pos = program.uniform("u_view_pos");
+		uniforms.amb_light_color = program.uniform("u_amb_light_color");
+		uniforms.dir_light_direction = program.uniform("u_dir_light_direction");
+		uniforms.dir_light_color = program.uniform("u_dir_light_color");
+		uniforms.gamma = program.uniform("u_gamma");
+		uniforms.exposure = program.uniform("u_exposure");
+
+		return uniforms;
+	}
+
+	void resolveUniforms()
+	{
+		instanced_uniforms = sceneUniforms(instanced_program);
+
+		batched_uniforms = sceneUniforms(batched_program);
+		batched_uniforms.first_object = batched_program.uniform("u_first_object");
+		batched_uniforms.material = batched_program.uniform("u_material");
+
+		cull_uniforms.planes = cull_program.uniform("u_planes");
+		cull_uniforms.n_objects = cull_program.uniform("u_n_objects");
+		cull_uniforms.volume = cull_program.uniform("u_volume");
+		cull_uniforms.occlusion = cull_program.uniform("u_occlusion");
+		cull_uniforms.hiz_pv_matrix = cull_program.uniform("u_hiz_pv_matrix");
+		cull_uniforms.hiz_levels = cull_program.uniform("u_hiz_levels");
+	}
+
+	bool createComputeProgram(std::string const& folder, ProgramReflection& program)
+	{
+		std::ifstream cs_file("shaders/" + folder + "/cs.glsl");
+
+		if (!cs_file)
+		{
+			std::cerr << "ERROR: Could not open compute shader\n";
+			return false;
+		}
+
+		std::cout << "Creating " << folder << " program ... ";
+
+		std::vector<ShaderInfo> shaders(1);
+
+		shaders[0].type = GL_COMPUTE_SHADER;
+		readFile(cs_file, shaders[0]);
+
+		bool success;
+
+		GLuint program_id = gl.createProgram(shaders, success);
+
+		if (!success)
+		{
+			return false;
+		}
+
+		program = ProgramReflection(program_id);
+
+		std::cout << "SUCCESS\n";
+
+		return true;
+	}
+
+	bool createProgram(std::string const& folder, ProgramReflection& program)
+	{
+		std::vector<ShaderInfo> shaders;
+
+		std::ifstream vs_file("shaders/" + folder + "/vs.glsl");
+		std::ifstream fs_file("shaders/" + folder + "/fs.glsl");
+
+		if (!vs_file)
+		{
+			std::cerr << "ERROR: Could not open vertex shader\n";
+			return false;
+		}
+
+		if (!fs_file)
+		{
+			std::cerr << "ERROR: Could not open fragment shader\n";
+			return false;
+		}
+
+		std::cout << "Creating " << folder << " program ... ";
+
+		readShader(vs_file, fs_file, shaders);
+
+		bool success;
+
+		GLuint program_id = gl.createProgram(shaders, success);
+
+		if (!success)
+		{
+			return false;
+		}
+
+		program = ProgramReflection(program_id);
+
+		std::cout << "SUCCESS\n";
+
+		return true;
+	}
+
+	void readShader(
+		std::ifstream& vs,
+		std::ifstream& fs,
+		std::vector<ShaderInfo>& shaders)
+	{
+		shaders.resize(2);
+
+		shaders[0].type = GL_VERTEX_SHADER;
+		readFile(vs, shaders[0]);
+
+		shaders[1].type = GL_FRAGMENT_SHADER;
+		readFile(fs, shaders[1]);
+	}
+
+	void readFile(std::ifstream& stream, ShaderInfo& shader_info)
+	{
+		std::string line;
+
+		while (std::getline(stream, line))
+		{
+			shader_info.source += line + "\n";
+		}
+	}
+
+	// The scene is drawn off screen, so that its depth can be sampled
+	void createSceneTargets()
+	{
+		scene_color = Texture2D(window_width, window_height, GL_RGBA8,
+			GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_LINEAR, GL_LINEAR);
+		scene_depth = Texture2D(window_width, window_height, GL_DEPTH_COMPONENT32F,
+			GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_NEAREST, GL_NEAREST);
+
+		scene_framebuffer->attachTexture(GL_COLOR_ATTACHMENT0, scene_color, 0);
+		scene_framebuffer->attachTexture(GL_DEPTH_ATTACHMENT, scene_depth, 0);
+		scene_framebuffer->checkStatus();
+
+		hiz = HiZPyramid(window_width, window_height);
+		hiz_valid = false;
+
+		hiz_readback_level = 0;
+
+		while ((hiz.getWidth() >> hiz_readback_level) > HIZ_READBACK_WIDTH)
+		{
+			++hiz_readback_level;
+		}
+	}
+
+	void destroySceneTargets()
+	{
+		scene_color.destroy();
+		scene_depth.destroy();
+		hiz.destroy();
+	}
+
+	bool createMaterialBall()
+	{
+		std::cout << "Creating material ball ... ";
+
+		std::vector<BufferInfo<float>> f_buffers;
+		std::vector<BufferInfo<int>> i_buffers;
+		std::vector<unsigned> indices;
+
+		bool success = parseOBJ("../res/materialBall/mesh.obj", f_buffers, indices);
+
+		if (!success)
+		{
+			return false;
+		}
+
+		// Shaded without textures, only positions and normals are needed
+		f_buffers.resize(2);
+		f_buffers[0].attribute_name = "a_pos";
+		f_buffers[1].attribute_name = "a_nor";
+
+		meshes[0] = gl.createStaticGeometry(geometry_arena,
+			f_buffers, i_buffers, indices, success);
+
+		if (!success)
+		{
+			return false;
+		}
+
+		std::cout << "SUCCESS\n";
+
+		return true;
+	}
+
+	bool createCube()
+	{
+		std::vector<float> positions;
+		std::vector<float> normals;
+		std::vector<unsigned> indices;
+
+		// Four vertices per face, so that the normals are flat
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			for (int sign = -1; sign <= 1; sign += 2)
+			{
+				glm::vec3 normal(0.0f);
+				normal[axis] = static_cast<float>(sign);
+
+				glm::vec3 u(0.0f);
+				glm::vec3 v(0.0f);
+				u[(axis + 1) % 3] = 1.0f;
+				v[(axis + 2) % 3] = 1.0f;
+
+				// Keeps the winding counter clockwise seen from outside
+				if (sign < 0)
+				{
+					std::swap(u, v);
+				}
+
+				unsigned first = static_cast<unsigned>(positions.size() / 3u);
+
+				glm::vec3 corners[4] = {
+					normal - u - v,
+					normal + u - v,
+					normal + u + v,
+					normal - u + v
+				};
+
+				for (auto& corner : corners)
+				{
+					positions.insert(positions.end(),
+						{ corner.x * 0.5f, corner.y * 0.5f, corner.z * 0.5f });
+					normals.insert(normals.end(), { normal.x, normal.y, normal.z });
+				}
+
+				indices.insert(indices.end(), {
+					first, first + 1, first + 2,
+					first, first + 2, first + 3 });
+			}
+		}
+
+		std::vector<BufferInfo<float>> f_buffers
+		{
+			{ "a_pos", 3, positions },
+			{ "a_nor", 3, normals }
+		};
+
+		std::vector<BufferInfo<int>> i_buffers;
+
+		bool success;
+
+		meshes[1] = gl.createStaticGeometry(geometry_arena,
+			f_buffers, i_buffers, indices, success);
+
+		// Rasterized on the CPU as an occluder
+		cube_occluder.positions = positions;
+		cube_occluder.indices = indices;
+
+		return success;
+	}
+
+	// Metallic grows along one axis of the table and roughness
+	// along the other. Albedos are random
+	void createMaterials()
+	{
+		std::vector<MaterialData> materials(MATERIAL_STEPS * MATERIAL_STEPS);
+
+		std::mt19937 generator(7u);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		for (int i = 0; i < MATERIAL_STEPS; ++i)
+		{
+			for (int j = 0; j < MATERIAL_STEPS; ++j)
+			{
+				MaterialData& material = materials[i * MATERIAL_STEPS + j];
+
+				material.albedo = glm::vec4(unit(generator), unit(generator), unit(generator),
+					i == j ? TRANSLUCENT_ALPHA : 1.0f);
+				material.metallic = j / (MATERIAL_STEPS - 1.0f);
+				material.roughness = 0.05f + 0.95f * i / (MATERIAL_STEPS - 1.0f);
+			}
+		}
+
+		material_translucent.clear();
+
+		for (auto& it : materials)
+		{
+			material_translucent.push_back(it.albedo.a < 1.0f);
+		}
+
+		glCreateBuffers(1, &material_buffer);
+		glNamedBufferStorage(material_buffer,
+			materials.size() * sizeof(MaterialData), materials.data(), 0);
+	}
+
+	// Lays the objects on the grid with random orientations. They're
+	// stored grouped by mesh, so that each mesh is a contiguous range
+	// of the instance stream, and described three ways: as storage
+	// buffer entries, instance attributes and indirect commands. The
+	// last two are uploaded for the visible objects only, every time
+	// the visible set changes
+	void createObjects()
+	{
+		built_grid_size = grid_size;
+		n_objects = static_cast<size_t>(grid_size) * grid_size;
+
+		std::vector<InstanceData> mesh_objects[N_MESHES];
+
+		std::mt19937 generator(42u);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		float half_extent = 0.5f * GRID_SPACING * (grid_size - 1);
+
+		for (size_t i = 0u; i < n_objects; ++i)
+		{
+			size_t x = i % grid_size;
+			size_t z = i / grid_size;
+
+			glm::vec3 position(
+				x * GRID_SPACING - half_extent,
+				0.0f,
+				z * GRID_SPACING - half_extent);
+
+			InstanceData object;
+
+			object.model_matrix =
+				glm::translate(glm::mat4(1.0f), position) *
+				glm::rotate(glm::mat4(1.0f), glm::radians(360.0f * unit(generator)),
+					glm::vec3(0.0f, 1.0f, 0.0f));
+
+			object.material = static_cast<GLint>(
+				(z % MATERIAL_STEPS) * MATERIAL_STEPS + x % MATERIAL_STEPS);
+
+			mesh_objects[i % CUBE_FREQUENCY == 0u ? 1 : 0].push_back(object);
+		}
+
+		std::vector<ObjectData> objects;
+		std::vector<Bounds> bounds;
+
+		instances.clear();
+		commands.clear();
+
+		instances.reserve(n_objects);
+		objects.reserve(n_objects);
+		commands.reserve(n_objects);
+		bounds.reserve(n_objects);
+
+		for (int i = 0; i < N_MESHES; ++i)
+		{
+			mesh_first_objects[i] = instances.size();
+			mesh_object_counts[i] = mesh_objects[i].size();
+
+			for (auto& it : mesh_objects[i])
+			{
+				instances.push_back(it);
+
+				ObjectData object;
+				object.model_matrix = it.model_matrix;
+				object.material = it.material;
+				objects.push_back(object);
+
+				DrawElementsIndirectCommand command;
+				command.count = static_cast<GLuint>(meshes[i].n_indices);
+				command.instance_count = 1u;
+				command.first_index = meshes[i].first_index;
+				command.base_vertex = meshes[i].base_vertex;
+				command.base_instance = 0u;
+				commands.push_back(command);
+
+				bounds.push_back(transformBounds(meshes[i].bounds, it.model_matrix));
+			}
+		}
+
+		object_bounds.resize(n_objects);
+
+		for (size_t i = 0u; i < n_objects; ++i)
+		{
+			object_bounds.set(i, bounds[i]);
+		}
+
+		bvh.build(bounds);
+
+		object_visible.assign(n_objects, 0u);
+		visible_dirty = true;
+
+		// Center and sphere radius, then half extent, per object
+		std::vector<glm::vec4> gpu_bounds;
+		gpu_bounds.reserve(2u * n_objects);
+
+		for (auto& it : bounds)
+		{
+			glm::vec3 center = 0.5f * (it.min + it.max);
+			glm::vec3 extent = 0.5f * (it.max - it.min);
+
+			gpu_bounds.push_back(glm::vec4(center, it.radius));
+			gpu_bounds.push_back(glm::vec4(extent, 0.0f));
+		}
+
+		glCreateBuffers(1, &bounds_buffer);
+		glNamedBufferStorage(bounds_buffer,
+			gpu_bounds.size() * sizeof(glm::vec4), gpu_bounds.data(), 0);
+
+		glCreateBuffers(1, &command_buffer);
+		glNamedBufferStorage(command_buffer,
+			commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), 0);
+
+		glCreateBuffers(1, &object_buffer);
+		glNamedBufferStorage(object_buffer,
+			objects.size() * sizeof(ObjectData), objects.data(), 0);
+
+		// Sized for every object being visible
+		glCreateBuffers(1, &visible_buffer);
+		glNamedBufferStorage(visible_buffer,
+			n_objects * sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+		glCreateBuffers(1, &instance_buffer);
+		glNamedBufferStorage(instance_buffer,
+			n_objects * sizeof(InstanceData), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+		glCreateBuffers(1, &indirect_buffer);
+		glNamedBufferStorage(indirect_buffer,
+			n_objects * sizeof(DrawElementsIndirectCommand), nullptr,
+			GL_DYNAMIC_STORAGE_BIT);
+
+		// The model matrix takes a location per column
+		std::vector<VertexAttribute> instance_attributes;
+
+		for (GLuint i = 0u; i < 4u; ++i)
+		{
+			instance_attributes.push_back(VertexAttribute{
+				ATTRIBUTE_INSTANCE_MODEL + i, 4, GL_FLOAT,
+				static_cast<GLuint>(i * sizeof(glm::vec4)), INSTANCE_BINDING });
+		}
+
+		instance_attributes.push_back(VertexAttribute{
+			ATTRIBUTE_INSTANCE_MATERIAL, 1, GL_INT,
+			static_cast<GLuint>(offsetof(InstanceData, material)), INSTANCE_BINDING });
+
+		// Copies that read the instance stream. They share the
+		// arena ranges of the meshes, so they aren't destroyed
+		for (int i = 0; i < N_MESHES; ++i)
+		{
+			instanced_meshes[i] = meshes[i];
+
+			gl.setInstanceStream(instanced_meshes[i], instance_attributes,
+				sizeof(InstanceData), instance_buffer);
+		}
+	}
+
+	void destroyObjects()
+	{
+		glDeleteBuffers(1, &object_buffer);
+		glDeleteBuffers(1, &visible_buffer);
+		glDeleteBuffers(1, &instance_buffer);
+		glDeleteBuffers(1, &indirect_buffer);
+		glDeleteBuffers(1, &bounds_buffer);
+		glDeleteBuffers(1, &command_buffer);
+
+		object_buffer = 0u;
+		visible_buffer = 0u;
+		instance_buffer = 0u;
+		indirect_buffer = 0u;
+		bounds_buffer = 0u;
+		command_buffer = 0u;
+
+		// The instance buffer may be attached to a shared VAO
+		gl.invalidateState();
+	}
+
+	/// Programs
+	ProgramReflection batched_program;
+	ProgramReflection instanced_program;
+	ProgramReflection cull_program;
+	ProgramReflection hiz_program;
+	ProgramReflection hiz_fragment_program;
+
+	// Locations of the uniforms set every frame
+	SceneUniforms batched_uniforms;
+	SceneUniforms instanced_uniforms;
+
+	struct CullUniforms
+	{
+		GLint planes;
+		GLint n_objects;
+		GLint volume;
+		GLint occlusion;
+		GLint hiz_pv_matrix;
+		GLint hiz_levels;
+	} cull_uniforms;
+
+	/// Render targets
+	Framebuffer* scene_framebuffer = nullptr;
+	Texture2D scene_color;
+	Texture2D scene_depth;
+
+	/// Geometry
+	GeometryArena geometry_arena;
+	DeviceMesh meshes[N_MESHES];
+	DeviceMesh instanced_meshes[N_MESHES];
+
+	/// Objects
+	int grid_size = GRID_SIZE;
+	int built_grid_size = 0;
+	size_t n_objects = 0u;
+
+	GLuint material_buffer = 0u;
+	GLuint object_buffer = 0u;
+	GLuint visible_buffer = 0u;
+	GLuint instance_buffer = 0u;
+	GLuint indirect_buffer = 0u;
+
+	// Kept to gather the visible objects from
+	std::vector<InstanceData> instances;
+	std::vector<DrawElementsIndirectCommand> commands;
+
+	// Range of the objects of each mesh
+	size_t mesh_first_objects[N_MESHES];
+	size_t mesh_object_counts[N_MESHES];
+
+	// Indexed by material
+	std::vector<uint8_t> material_translucent;
+
+	/// Culling
+	int culling_mode = CULLING_SIMD;
+	int culling_volume = CULL_SPHERES;
+	bool freeze_culling = false;
+	Frustum culling_frustum;
+
+	// World space bounds, in object order
+	BoundsArrays object_bounds;
+	BoundingVolumeHierarchy bvh;
+
+	std::vector<uint8_t> object_visible;
+	std::vector<GLuint> visible_objects;
+	std::vector<GLuint> uploaded_objects;
+	bool visible_dirty = true;
+
+	// Range of the visible objects of each mesh in visible_objects
+	size_t mesh_first_visible[N_MESHES] = {};
+	size_t mesh_visible_counts[N_MESHES] = {};
+
+	size_t n_visible = 0u;
+	double cull_ms = 0.0;
+	CullStats cull_stats = {};
+
+	/// GPU culling
+	GLuint bounds_buffer = 0u;
+	GLuint command_buffer = 0u;
+	GLuint draw_count_buffer = 0u;
+	GLuint count_readback_buffers[2];
+	GLsync count_readback_fences[2] = {};
+	unsigned next_count_readback = 0u;
+
+	GPUTimer cull_timer;
+
+	GLuint cull_stats_buffer = 0u;
+
+	/// Occlusion culling
+	bool occlusion_culling = true;
+	int hiz_build = HIZ_COMPUTE;
+
+	HiZPyramid hiz;
+	glm::mat4 hiz_pv_matrix;
+	bool hiz_valid = false;
+
+	int hiz_readback_level = 0;
+	HiZReadback hiz_readback;
+
+	GPUTimer hiz_timer;
+
+	/// Software occlusion
+	int occlusion_source = OCCLUSION_HIZ;
+	int occlusion_threads = 1;
+
+	OcclusionRasterizer* rasterizer = nullptr;
+	OccluderMesh cube_occluder;
+
+	std::vector<Occluder> occluders;
+	glm::mat4 occluder_pv_matrix;
+
+	// Triangles per ms per thread, by thread count
+	std::vector<double> benchmark_results;
+
+	/// Statistics
+	int draw_mode = DRAW_MULTI_INDIRECT;
+	unsigned n_draw_calls = 0u;
+	double draw_cpu_ms = 0.0;
+
+	GPUTimer draw_timer;
+
+	/// Render queue
+	RenderQueue render_queue;
+	bool sort_draws = true;
+	double queue_ms = 0.0;
+
+	RenderQueueStats unsorted_queue_stats;
+	RenderQueueStats queue_stats;
+
+	/// Lights
+	glm::vec3 amb_light_color;
+	glm::vec3 dir_light_direction;
+	glm::vec3 dir_light_color;
+
+	/// Camera
+	FlyThroughCamera camera;
+
+	bool forward = false;
+	bool backward = false;
+	bool left = false;
+	bool right = false;
+	bool up = false;
+	bool down = false;
+
+	float gamma_correction = 2.2f;
+	float exposure = 1.0f;
+
+	/// Application state
+	bool mouse_grab = false;
+	double mouse_x;
+	double mouse_y;
+	double mouse_last_x = 0.0f;
+	double mouse_last_y = 0.0f;
+
+	glm::mat4 projection;
+};
+
+void onKey(GLFWwindow* window, int key, int, int action, int mods)
+{
+	auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
+
+	app->fastCamera((mods & GLFW_MOD_SHIFT) == GLFW_MOD_SHIFT);
+
+	switch (key)
+	{
+		case GLFW_KEY_W:
+			app->moveForward(action != GLFW_RELEASE);
+			break;
+
+		case GLFW_KEY_A:
+			app->moveLeft(action != GLFW_RELEASE);
+			break;
+
+		case GLFW_KEY_S:
+			app->moveBackward(action != GLFW_RELEASE);
+			break;
+
+		case GLFW_KEY_D:
+			app->moveRight(action != GLFW_RELEASE);
+			break;
+
+		case GLFW_KEY_Q:
+			app->moveUp(action != GLFW_RELEASE);
+			break;
+
+		case GLFW_KEY_E:
+			app->moveDown(action != GLFW_RELEASE);
+			break;
+
+		case GLFW_KEY_ESCAPE:
+			app->close();
+	}
+}
+
+void onMouseMove(GLFWwindow* window, double xpos, double ypos)
+{
+	auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
+
+	app->updateMousePos(xpos, ypos);
+}
+
+void onMouseButton(GLFWwindow* window, int button, int action, int)
+{
+	auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
+
+	if (button == GLFW_MOUSE_BUTTON_RIGHT)
+	{
+		if (action != GLFW_RELEASE)
+		{
+			glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+			app->mouseGrab(true);
+		}
+		else
+		{
+			glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+			app->mouseGrab(false);
+		}
+	}
+}
+
+void windowResize(GLFWwindow* window, int width, int height)
+{
+	auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
+
+	if (width > 0 && height > 0)
+	{
+		app->setProjection(glm::perspective(
+			glm::radians(60.0f), (float)width / height, 0.1f, 1000.0f));
+
+		app->setWindowSize(width, height);
+	}
+}
+
+int main()
+{
+	Application app("Many Objects", WINDOW_WIDTH, WINDOW_HEIGHT);
+
+	if (app.init())
+	{
+		app.run();
+		app.destroy();
+	}
+}
@@ -0,0 +1,98 @@
+#version 450 core
+
+#define PI 3.1415926535
+
+struct MaterialData
+{
+	vec4 albedo;
+	float metallic;
+	float roughness;
+};
+
+layout (std430, binding = 1) readonly buffer MaterialBuffer
+{
+	MaterialData materials[];
+};
+
+in vec3 v_world_pos;
+in vec3 v_normal;
+flat in int v_material;
+
+uniform vec3 u_view_pos;
+
+uniform vec3 u_amb_light_color;
+uniform vec3 u_dir_light_direction;
+uniform vec3 u_dir_light_color;
+
+uniform float u_gamma;
+uniform float u_exposure;
+
+out vec4 out_color;
+
+vec3 fresnelSchlick(float h_dot_v, vec3 f_0)
+{
+	return f_0 + (1.0 - f_0) * pow(max(1.0 - h_dot_v, 0.0), 5.0);
+}
+
+float distributionGGX(float n_dot_h, float r)
+{
+	float a = r * r;
+	float a_2 = a * a;
+
+	float den = (n_dot_h * n_dot_h) * (a_2 - 1.0) + 1.0;
+	den = PI * den * den;
+
+	return a_2 / max(den, 0.0000001);
+}
+
+float geometrySchlickGGX(float n_dot_v, float r)
+{
+	r += 1.0;
+	float k = (r * r) / 8.0;
+
+	float den = n_dot_v * (1.0 - k) + k;
+
+	return n_dot_v / den;
+}
+
+float geometrySmith(float n_dot_v, float n_dot_l, float r)
+{
+	return geometrySchlickGGX(n_dot_v, r) * geometrySchlickGGX(n_dot_l, r);
+}
+
+void main()
+{
+	vec3 albedo = materials[v_material].albedo.rgb;
+	float metallic = materials[v_material].metallic;
+	float roughness = materials[v_material].roughness;
+
+	vec3 f_0 = vec3(0.04);
+	f_0 = mix(f_0, albedo, metallic);
+
+	vec3 normal = normalize(v_normal);
+	vec3 view = normalize(u_view_pos - v_world_pos);
+	vec3 light = normalize(-u_dir_light_direction);
+	vec3 halfway = normalize(view + light);
+
+	float n_dot_l = max(dot(normal, light), 0.0);
+	float n_dot_h = max(dot(normal, halfway), 0.0);
+	float n_dot_v = max(dot(normal, view), 0.0);
+	float h_dot_v = max(dot(halfway, view), 0.0);
+
+	float ndf = distributionGGX(n_dot_h, roughness);
+	float g = geometrySmith(n_dot_v, n_dot_l, roughness);
+	vec3 f = fresnelSchlick(h_dot_v, f_0);
+
+	vec3 brdf = (ndf * g * f) / (4 * n_dot_v * n_dot_l + 0.001);
+
+	vec3 k_d = (vec3(1.0) - f) * (1.0 - metallic);
+
+	vec3 ambient = u_amb_light_color * albedo * (1.0 - metallic);
+	vec3 diffuse = k_d * albedo / PI;
+	vec3 specular = brdf;
+
+	vec3 hdr_color = ambient + ((diffuse + specular) * u_dir_light_color * n_dot_l);
+
+	out_color.rgb = vec3(1.0) - exp(-hdr_color * u_exposure);
+	out_color = vec4(pow(out_color.rgb, vec3(1.0 / u_gamma)), materials[v_material].albedo.a);
+}
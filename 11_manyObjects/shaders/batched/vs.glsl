@@ -0,0 +1,52 @@
+#version 450 core
+
+#extension GL_ARB_shader_draw_parameters : require
+
+layout (location = 0) in vec3 a_pos;
+layout (location = 1) in vec3 a_nor;
+
+struct ObjectData
+{
+	mat4 model_matrix;
+	int material;
+};
+
+layout (std430, binding = 0) readonly buffer ObjectBuffer
+{
+	ObjectData objects[];
+};
+
+// Indices of the objects that survived culling. Draws index this list
+layout (std430, binding = 2) readonly buffer VisibleBuffer
+{
+	uint visible_objects[];
+};
+
+uniform mat4 u_pv_matrix;
+
+// Multi-draws start at the first visible object and each command is
+// one. Direct draws are one object per call and set it here
+uniform int u_first_object;
+
+// Replaces the material of the object when set, by
+// draws that bind their material one at a time
+uniform int u_material = -1;
+
+out vec3 v_world_pos;
+out vec3 v_normal;
+flat out int v_material;
+
+void main()
+{
+	int object = int(visible_objects[u_first_object + gl_DrawIDARB]);
+	mat4 model_matrix = objects[object].model_matrix;
+
+	// The objects are only rotated and uniformly scaled
+	v_normal = mat3(model_matrix) * a_nor;
+
+	vec4 world_position = model_matrix * vec4(a_pos, 1.0);
+	gl_Position = u_pv_matrix * world_position;
+
+	v_world_pos = world_position.xyz;
+	v_material = u_material < 0 ? objects[object].material : u_material;
+}
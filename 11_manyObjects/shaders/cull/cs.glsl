@@ -0,0 +1,176 @@
+#version 450 core
+
+layout (local_size_x = 64) in;
+
+struct DrawCommand
+{
+	uint count;
+	uint instance_count;
+	uint first_index;
+	int base_vertex;
+	uint base_instance;
+};
+
+struct ObjectBounds
+{
+	vec4 center_radius;
+	vec4 extent;
+};
+
+// Written in the same order as the commands, so that
+// gl_DrawIDARB finds the object of each draw
+layout (std430, binding = 2) writeonly buffer VisibleBuffer
+{
+	uint visible_objects[];
+};
+
+layout (std430, binding = 3) readonly buffer BoundsBuffer
+{
+	ObjectBounds bounds[];
+};
+
+// The command of every object, copied out for the visible ones
+layout (std430, binding = 4) readonly buffer CommandBuffer
+{
+	DrawCommand commands[];
+};
+
+layout (std430, binding = 5) writeonly buffer DrawBuffer
+{
+	DrawCommand draws[];
+};
+
+// Rejected objects and their triangles, for statistics
+layout (std430, binding = 6) buffer CullStats
+{
+	uint frustum_objects;
+	uint frustum_triangles;
+	uint occlusion_objects;
+	uint occlusion_triangles;
+};
+
+// Read back as the draw count of glMultiDrawElementsIndirectCount
+layout (binding = 0, offset = 0) uniform atomic_uint draw_count;
+
+layout (binding = 0) uniform sampler2D u_hiz;
+
+uniform vec4 u_planes[6];
+uniform int u_n_objects;
+
+// 0 tests spheres and 1 boxes, as CullingVolume
+uniform int u_volume;
+
+// The pyramid is built from the depth of the previous frame,
+// so boxes are projected with the matrix of that frame
+uniform int u_occlusion;
+uniform mat4 u_hiz_pv_matrix;
+uniform int u_hiz_levels;
+
+bool intersectsFrustum(vec3 center, vec3 extent, float radius)
+{
+	for (int i = 0; i < 6; ++i)
+	{
+		float distance = dot(u_planes[i].xyz, center) + u_planes[i].w;
+		float reach = u_volume == 0 ? radius : dot(abs(u_planes[i].xyz), extent);
+
+		if (distance < -reach)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool occluded(vec3 center, vec3 extent)
+{
+	vec2 uv_min = vec2(1.0);
+	vec2 uv_max = vec2(0.0);
+	float nearest = 1.0;
+
+	for (int i = 0; i < 8; ++i)
+	{
+		vec3 corner = center + extent * vec3(
+			(i & 1) != 0 ? 1.0 : -1.0,
+			(i & 2) != 0 ? 1.0 : -1.0,
+			(i & 4) != 0 ? 1.0 : -1.0);
+
+		vec4 clip = u_hiz_pv_matrix * vec4(corner, 1.0);
+
+		// Boxes crossing the near plane have no bounded rectangle
+		if (clip.w <= 0.0)
+		{
+			return false;
+		}
+
+		vec3 ndc = clip.xyz / clip.w;
+
+		uv_min = min(uv_min, ndc.xy * 0.5 + 0.5);
+		uv_max = max(uv_max, ndc.xy * 0.5 + 0.5);
+		nearest = min(nearest, ndc.z * 0.5 + 0.5);
+	}
+
+	uv_min = clamp(uv_min, 0.0, 1.0);
+	uv_max = clamp(uv_max, 0.0, 1.0);
+
+	ivec2 size = textureSize(u_hiz, 0);
+	vec2 rectangle = (uv_max - uv_min) * vec2(size);
+
+	// The level where the rectangle covers about two texels per axis
+	int level = clamp(int(ceil(log2(max(max(rectangle.x, rectangle.y), 1.0)))),
+		0, u_hiz_levels - 1);
+
+	ivec2 level_size = textureSize(u_hiz, level);
+
+	// Texel x of a level covers texels [x * 2^level, (x + 1) * 2^level)
+	// of level 0, and the last one also what odd sizes folded into it
+	ivec2 first = min(ivec2(uv_min * vec2(size)) >> level, level_size - 1);
+	ivec2 last = min(ivec2(uv_max * vec2(size)) >> level, level_size - 1);
+
+	float farthest = 0.0;
+
+	for (int y = first.y; y <= last.y; ++y)
+	{
+		for (int x = first.x; x <= last.x; ++x)
+		{
+			farthest = max(farthest, texelFetch(u_hiz, ivec2(x, y), level).r);
+		}
+	}
+
+	return nearest > farthest;
+}
+
+void main()
+{
+	int object = int(gl_GlobalInvocationID.x);
+
+	if (object >= u_n_objects)
+	{
+		return;
+	}
+
+	vec3 center = bounds[object].center_radius.xyz;
+	vec3 extent = bounds[object].extent.xyz;
+	float radius = bounds[object].center_radius.w;
+
+	uint n_triangles = commands[object].count / 3u;
+
+	if (!intersectsFrustum(center, extent, radius))
+	{
+		atomicAdd(frustum_objects, 1u);
+		atomicAdd(frustum_triangles, n_triangles);
+		return;
+	}
+
+	if (u_occlusion != 0 && occluded(center, extent))
+	{
+		atomicAdd(occlusion_objects, 1u);
+		atomicAdd(occlusion_triangles, n_triangles);
+		return;
+	}
+
+	uint slot = atomicCounterIncrement(draw_count);
+
+	draws[slot] = commands[object];
+	visible_objects[slot] = uint(object);
+}
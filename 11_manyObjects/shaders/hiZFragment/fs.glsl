@@ -0,0 +1,57 @@
+#version 450 core
+
+layout (binding = 0) uniform sampler2D u_depth;
+
+// Restricted to the level below the one drawn to
+layout (binding = 1) uniform sampler2D u_source;
+
+// Level 0 copies the depth buffer, the others reduce the level below
+uniform int u_level;
+uniform ivec2 u_source_size;
+uniform ivec2 u_target_size;
+
+out float out_depth;
+
+float readSource(ivec2 texel)
+{
+	return texelFetch(u_source, min(texel, u_source_size - 1), 0).r;
+}
+
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+
+	if (u_level == 0)
+	{
+		out_depth = texelFetch(u_depth, texel, 0).r;
+		return;
+	}
+
+	ivec2 base = 2 * texel;
+
+	float depth = max(
+		max(readSource(base), readSource(base + ivec2(1, 0))),
+		max(readSource(base + ivec2(0, 1)), readSource(base + ivec2(1, 1))));
+
+	// Odd sizes fold their last column and row into the last texel,
+	// so that every source texel is covered by the level above
+	bool extra_x = (u_source_size.x & 1) != 0 && texel.x == u_target_size.x - 1;
+	bool extra_y = (u_source_size.y & 1) != 0 && texel.y == u_target_size.y - 1;
+
+	if (extra_x)
+	{
+		depth = max(depth, max(readSource(base + ivec2(2, 0)), readSource(base + ivec2(2, 1))));
+	}
+
+	if (extra_y)
+	{
+		depth = max(depth, max(readSource(base + ivec2(0, 2)), readSource(base + ivec2(1, 2))));
+	}
+
+	if (extra_x && extra_y)
+	{
+		depth = max(depth, readSource(base + ivec2(2, 2)));
+	}
+
+	out_depth = depth;
+}
@@ -0,0 +1,26 @@
+#version 450 core
+
+layout (location = 0) in vec3 a_pos;
+layout (location = 1) in vec3 a_nor;
+
+// Per instance, locations 4 to 7 hold the columns of the matrix
+layout (location = 4) in mat4 a_model_matrix;
+layout (location = 8) in int a_material;
+
+uniform mat4 u_pv_matrix;
+
+out vec3 v_world_pos;
+out vec3 v_normal;
+flat out int v_material;
+
+void main()
+{
+	// The objects are only rotated and uniformly scaled
+	v_normal = mat3(a_model_matrix) * a_nor;
+
+	vec4 world_position = a_model_matrix * vec4(a_pos, 1.0);
+	gl_Position = u_pv_matrix * world_position;
+
+	v_world_pos = world_position.xyz;
+	v_material = a_material;
+}
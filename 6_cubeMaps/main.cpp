@@ -1,6 +1,8 @@
 #include "../common/baseApp.hpp"
 #include "../common/flyThroughCamera.hpp"
+#include "../common/gpuTimer.hpp"
 #include "../common/objParser.hpp"
+#include "../common/reflectionProbe.hpp"
 #include "../common/texture.hpp"
 
 #include <fstream>
@@ -11,7 +13,13 @@
 #define WINDOW_WIDTH 1366
 #define WINDOW_HEIGHT 768
 
-#define N_TEXTURES 3
+#define N_TEXTURES 4
+
+#define N_PROBES 3
+#define PROBE_SIZE 128
+#define PROBE_TEXTURE_UNIT 4
+
+#define N_CUBES 8
 
 void onKey(GLFWwindow* window, int key, int, int action, int mods);
 void onMouseMove(GLFWwindow* window, double xpos, double ypos);
@@ -123,6 +131,7 @@ private:
 		GLint u_diffuse_loc;
 		GLint u_reflection_loc;
 		GLint u_refraction_loc;
+		GLint u_reflection_blur_loc;
 
 		GLint u_gamma_loc;
 	};
@@ -169,11 +178,18 @@ private:
 			return false;
 		}
 
+		if (!createCube())
+		{
+			return false;
+		}
+
 		if (!createSkybox())
 		{
 			return false;
 		}
 
+		createProbes();
+
 		glClearColor(0.10, 0.25, 0.15, 1.0);
 
 		gl.enable(GL_DEPTH_TEST);
@@ -196,29 +212,39 @@ private:
 
 		buildGUI();
 		updateCamera(delta_time);
+		updateCubes(delta_time);
+
+		adjustTextureProperties();
+
+		updateProbes();
 
 		glm::vec3 camera_position = camera.new_position;
 		glm::mat4 view_matrix = camera.getViewMatrix();
 
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		glUseProgram(geometry_program.id);
+		drawScene(view_matrix, projection, camera_position, -1);
 
-		adjustTextureProperties();
+		return true;
+	}
+
+	// Draws the material balls, the cubes and the skybox.
+	// The ball at @skipped_ball is left out, so its
+	// probe doesn't capture the inside of the ball
+	void drawScene(
+		glm::mat4 const& view_matrix,
+		glm::mat4 const& projection_matrix,
+		glm::vec3 const& view_position,
+		int skipped_ball)
+	{
+		glUseProgram(geometry_program.id);
 
-		glUniformMatrix4fv(geometry_program.u_model_matrix_loc,
-			1, GL_FALSE, glm::value_ptr(model_matrix));
 		glUniformMatrix4fv(geometry_program.u_view_matrix_loc,
 			1, GL_FALSE, glm::value_ptr(view_matrix));
 		glUniformMatrix4fv(geometry_program.u_projection_matrix_loc,
-			1, GL_FALSE, glm::value_ptr(projection));
-		glUniformMatrix3fv(geometry_program.u_nor_transform_loc,
-			1, GL_FALSE, glm::value_ptr(glm::mat3(
-				glm::transpose(glm::inverse(model_matrix)))));
+			1, GL_FALSE, glm::value_ptr(projection_matrix));
 
-		glUniform1i(geometry_program.u_color_sampler_loc, 0);
 		glUniform1i(geometry_program.u_normal_sampler_loc, 1);
-		glUniform1i(geometry_program.u_cube_sampler_loc, 2);
 
 		glUniform3fv(geometry_program.u_dir_light_direction_loc,
 			1, glm::value_ptr(dir_light.direction));
@@ -226,10 +252,15 @@ private:
 			1, glm::value_ptr(dir_light.color));
 
 		glUniform3fv(geometry_program.u_view_pos_loc,
-			1, glm::value_ptr(camera_position));
+			1, glm::value_ptr(view_position));
 
 		glUniform1f(geometry_program.u_shininess_loc, material_shineness);
 
+		glUniform1f(geometry_program.u_gamma_loc, gamma_correction);
+
+		/// Material balls
+		glUniform1i(geometry_program.u_color_sampler_loc, 0);
+
 		glUniform1f(geometry_program.u_uv_multiplier_loc, uv_multiplier);
 
 		glUniform1f(geometry_program.u_bump_map_active_loc, bump_map_active);
@@ -237,12 +268,58 @@ private:
 		glUniform1f(geometry_program.u_diffuse_loc, diffuse);
 		glUniform1f(geometry_program.u_reflection_loc, reflection);
 		glUniform1f(geometry_program.u_refraction_loc, refraction);
-
-		glUniform1f(geometry_program.u_gamma_loc, gamma_correction);
+		glUniform1f(geometry_program.u_reflection_blur_loc, reflection_blur);
 
 		glBindVertexArray(geometry.vao_id);
-		glDrawElements(GL_TRIANGLES, geometry.n_indices, GL_UNSIGNED_INT, nullptr);
 
+		for (int i = 0; i < N_PROBES; ++i)
+		{
+			if (i == skipped_ball)
+			{
+				continue;
+			}
+
+			glm::mat4 ball_model_matrix =
+				glm::translate(model_matrix, ball_positions[i]);
+
+			glUniformMatrix4fv(geometry_program.u_model_matrix_loc,
+				1, GL_FALSE, glm::value_ptr(ball_model_matrix));
+			glUniformMatrix3fv(geometry_program.u_nor_transform_loc,
+				1, GL_FALSE, glm::value_ptr(glm::mat3(
+					glm::transpose(glm::inverse(ball_model_matrix)))));
+
+			glUniform1i(geometry_program.u_cube_sampler_loc,
+				dynamic_reflections ? PROBE_TEXTURE_UNIT + i : 2);
+
+			glDrawElements(GL_TRIANGLES, geometry.n_indices, GL_UNSIGNED_INT, nullptr);
+		}
+
+		/// Cubes
+		glUniform1i(geometry_program.u_color_sampler_loc, 3);
+		glUniform1i(geometry_program.u_cube_sampler_loc, 2);
+
+		glUniform1f(geometry_program.u_uv_multiplier_loc, 1.0f);
+
+		glUniform1f(geometry_program.u_bump_map_active_loc, false);
+
+		glUniform1f(geometry_program.u_diffuse_loc, 1.0f);
+		glUniform1f(geometry_program.u_reflection_loc, 0.0f);
+		glUniform1f(geometry_program.u_refraction_loc, 0.0f);
+
+		glBindVertexArray(cube.vao_id);
+
+		for (int i = 0; i < N_CUBES; ++i)
+		{
+			glUniformMatrix4fv(geometry_program.u_model_matrix_loc,
+				1, GL_FALSE, glm::value_ptr(cube_model_matrices[i]));
+			glUniformMatrix3fv(geometry_program.u_nor_transform_loc,
+				1, GL_FALSE, glm::value_ptr(glm::mat3(
+					glm::transpose(glm::inverse(cube_model_matrices[i])))));
+
+			glDrawElements(GL_TRIANGLES, cube.n_indices, GL_UNSIGNED_INT, nullptr);
+		}
+
+		/// Skybox
 		glDepthFunc(GL_LEQUAL);
 
 		glUseProgram(skybox_program.id);
@@ -251,7 +328,7 @@ private:
 			1, GL_FALSE, glm::value_ptr(
 				glm::mat4(glm::mat3(view_matrix))));
 		glUniformMatrix4fv(skybox_program.u_projection_matrix_loc,
-			1, GL_FALSE, glm::value_ptr(projection));
+			1, GL_FALSE, glm::value_ptr(projection_matrix));
 
 		glUniform1i(skybox_program.u_cube_sampler_loc, 2);
 
@@ -259,8 +336,69 @@ private:
 		glDrawElements(GL_TRIANGLES, skybox.n_indices, GL_UNSIGNED_INT, nullptr);
 
 		glDepthFunc(GL_LESS);
+	}
 
-		return true;
+	// Refreshes at most max_probes_per_frame probes by faces_per_update
+	// faces each, resuming after the last probe updated in the previous
+	// frame so every probe gets its turn. The GPU time spent is measured
+	// with a timer query, read back once it's available to avoid stalling
+	void updateProbes()
+	{
+		probe_timer.begin();
+
+		n_captured_faces = 0;
+		n_updated_probes = 0;
+
+		for (int i = 0; i < N_PROBES &&
+			n_updated_probes < max_probes_per_frame; ++i)
+		{
+			int probe_id = (next_probe + i) % N_PROBES;
+			ReflectionProbe* probe = probes[probe_id];
+
+			if (probe->isCurrent())
+			{
+				if (!continuous_update)
+				{
+					continue;
+				}
+
+				probe->invalidate();
+			}
+
+			n_captured_faces += probe->update(faces_per_update,
+				[&](glm::mat4 const& view, glm::mat4 const& proj)
+				{
+					drawScene(view, proj, probe->getPosition(), probe_id);
+				});
+
+			++n_updated_probes;
+			next_probe = (probe_id + 1) % N_PROBES;
+		}
+
+		probe_timer.end();
+	}
+
+	void updateCubes(double delta_time)
+	{
+		if (animate_cubes)
+		{
+			cubes_angle += cubes_speed * delta_time;
+		}
+
+		for (int i = 0; i < N_CUBES; ++i)
+		{
+			float angle = cubes_angle + glm::radians(360.0f * i / N_CUBES);
+
+			glm::vec3 position(
+				cubes_radius * std::cos(angle),
+				0.5f + 0.5f * std::sin(2.0f * angle),
+				cubes_radius * std::sin(angle));
+
+			cube_model_matrices[i] =
+				glm::translate(glm::mat4(1.0f), position) *
+				glm::rotate(glm::mat4(1.0f), 2.0f * angle, glm::vec3(0.0f, 1.0f, 0.0f)) *
+				glm::scale(glm::mat4(1.0f), glm::vec3(0.3f, 0.3f, 0.3f));
+		}
 	}
 
 	void customDestroy() override
@@ -280,7 +418,16 @@ private:
 			textures[i].destroy();
 		}
 
+		for (int i = 0; i < N_PROBES; ++i)
+		{
+			probes[i]->destroy();
+			delete probes[i];
+		}
+
+		probe_timer.destroy();
+
 		gl.destroyGeometry(geometry);
+		gl.destroyGeometry(cube);
 		gl.destroyGeometry(skybox);
 	}
 
@@ -344,6 +491,41 @@ private:
 		SliderFloat("Diffuse contribution", &diffuse, 0.0f, 1.0f);
 		SliderFloat("Reflection contribution", &reflection, 0.0f, 1.0f);
 		SliderFloat("Refraction contribution", &refraction, 0.0f, 1.0f);
+		SliderFloat("Reflection blur", &reflection_blur, 0.0f, 6.0f);
+		End();
+
+		/// REFLECTION PROBES
+		Begin("Reflection probes");
+
+		Checkbox("Dynamic reflections", &dynamic_reflections);
+		Checkbox("Continuous update", &continuous_update);
+
+		if (Button("Capture"))
+		{
+			for (int i = 0; i < N_PROBES; ++i)
+			{
+				probes[i]->invalidate();
+			}
+		}
+
+		Dummy(ImVec2(0.0f, 2.0f));
+		Separator();
+		Text("Budget");
+		SliderInt("Probes per frame", &max_probes_per_frame, 0, N_PROBES);
+		SliderInt("Faces per probe", &faces_per_update, 1, 6);
+
+		Dummy(ImVec2(0.0f, 2.0f));
+		Separator();
+		Checkbox("Animate cubes", &animate_cubes);
+		SliderFloat("Cubes speed", &cubes_speed, 0.0f, 4.0f);
+
+		Dummy(ImVec2(0.0f, 2.0f));
+		Separator();
+		Text("Probe resolution: %dx%d", PROBE_SIZE, PROBE_SIZE);
+		Text("Updated probes: %d", n_updated_probes);
+		Text("Captured faces: %d", n_captured_faces);
+		Text("Update GPU time: %.3f ms", probe_timer.getMilliseconds());
+
 		End();
 
 		/// LIGHTS
@@ -584,6 +766,8 @@ private:
 			glGetUniformLocation(geometry_program.id, "u_reflection");
 		geometry_program.u_refraction_loc =
 			glGetUniformLocation(geometry_program.id, "u_refraction");
+		geometry_program.u_reflection_blur_loc =
+			glGetUniformLocation(geometry_program.id, "u_reflection_blur");
 
 		geometry_program.u_gamma_loc =
 			glGetUniformLocation(geometry_program.id, "u_gamma");
@@ -603,6 +787,7 @@ private:
 		assert(geometry_program.u_diffuse_loc != -1);
 		assert(geometry_program.u_reflection_loc != -1);
 		assert(geometry_program.u_refraction_loc != -1);
+		assert(geometry_program.u_reflection_blur_loc != -1);
 		assert(geometry_program.u_gamma_loc != -1);
 
 		return true;
@@ -698,11 +883,26 @@ private:
 			GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR,
 			false);
 
+		textures[3] = Texture2D("../res/checkers.png", 3,
+			GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, true);
+
 		OpenGLContext::checkErrors(__FILE__, __LINE__);
 
 		textures[0].bind(0);
 		textures[1].bind(1);
 		textures[2].bind(2);
+		textures[3].bind(3);
+	}
+
+	void createProbes()
+	{
+		for (int i = 0; i < N_PROBES; ++i)
+		{
+			probes[i] = new ReflectionProbe(
+				ball_positions[i], PROBE_SIZE, 0.05f, 100.0f);
+
+			probes[i]->bind(PROBE_TEXTURE_UNIT + i);
+		}
 	}
 
 	bool createGeometry()
@@ -747,6 +947,48 @@ private:
 		return true;
 	}
 
+	bool createCube()
+	{
+		std::vector<BufferInfo<float>> f_buffers;
+		std::vector<BufferInfo<int>> i_buffers;
+		std::vector<unsigned> indices;
+
+		bool success = parseOBJ("../res/cube.obj", f_buffers, indices);
+
+		if (!success)
+		{
+			return false;
+		}
+
+		f_buffers[0].attribute_name = "a_pos";
+		f_buffers[1].attribute_name = "a_nor";
+		f_buffers[2].attribute_name = "a_tex";
+
+		f_buffers.emplace_back(
+			BufferInfo<float>
+			{
+				"a_tan",
+				3,
+				std::vector<float>(f_buffers[0].values.size(), 0.0f)
+			});
+
+		generateTangentVectors(
+			indices,
+			f_buffers[0].values,
+			f_buffers[2].values,
+			f_buffers[3].values);
+
+		cube = gl.createPackedStaticGeometry(
+			geometry_program.id, f_buffers, i_buffers, indices, success);
+
+		if (!success)
+		{
+			return false;
+		}
+
+		return true;
+	}
+
 	bool createSkybox()
 	{
 		std::vector<BufferInfo<float>> f_buffers
@@ -826,12 +1068,43 @@ private:
 
 	/// Object properties
 	DeviceMesh geometry;
+	DeviceMesh cube;
 	DeviceMesh skybox;
 	glm::mat4 model_matrix;
 
+	glm::vec3 ball_positions[N_PROBES]
+	{
+		glm::vec3(-2.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 0.0f),
+		glm::vec3(2.0f, 0.0f, 0.0f)
+	};
+
+	glm::mat4 cube_model_matrices[N_CUBES];
+
+	bool animate_cubes = true;
+	float cubes_angle = 0.0f;
+	float cubes_speed = 0.5f;
+	float cubes_radius = 3.5f;
+
 	float diffuse = 1.0f;
 	float reflection = 0.2f;
 	float refraction = 0.0f;
+	float reflection_blur = 0.0f;
+
+	/// Reflection probes
+	ReflectionProbe* probes[N_PROBES];
+
+	bool dynamic_reflections = true;
+	bool continuous_update = true;
+
+	int max_probes_per_frame = 1;
+	int faces_per_update = 2;
+	int next_probe = 0;
+
+	int n_updated_probes = 0;
+	int n_captured_faces = 0;
+
+	GPUTimer probe_timer;
 
 	/// Lights
 	DirectionalLight dir_light;
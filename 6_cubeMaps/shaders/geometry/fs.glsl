@@ -23,6 +23,7 @@ uniform bool u_bump_map_active;
 uniform float u_diffuse;
 uniform float u_reflection;
 uniform float u_refraction;
+uniform float u_reflection_blur;
 
 uniform float u_gamma;
 
@@ -60,7 +61,7 @@ void main()
 	vec3 tangent_reflection = reflect(-tangent_view_dir, normal);
 	vec3 world_reflection = v_tbn_inv * tangent_reflection;
 
-	vec3 cube_reflection = pow(texture(u_cube_sampler, world_reflection).rgb, vec3(u_gamma));
+	vec3 cube_reflection = pow(texture(u_cube_sampler, world_reflection, u_reflection_blur).rgb, vec3(u_gamma));
 	out_color += vec4(cube_reflection, 1.0) * u_reflection;
 
 	// Refraction
@@ -68,7 +69,7 @@ void main()
 	vec3 tangent_refraction = refract(-tangent_view_dir, normal, ratio);
 	vec3 world_refraction = v_tbn_inv * tangent_refraction;
 
-	vec3 cube_refraction = pow(texture(u_cube_sampler, world_refraction).rgb, vec3(u_gamma));
+	vec3 cube_refraction = pow(texture(u_cube_sampler, world_refraction, u_reflection_blur).rgb, vec3(u_gamma));
 	out_color += vec4(cube_refraction, 1.0) * u_refraction;
 
 	out_color.rgb = pow(out_color.rgb, vec3(1.0 / u_gamma));
@@ -102,6 +102,7 @@ void BaseApplication::run()
 		bool vs = vsync;
 		bool wireframe = gl_wireframe;
 		float line_width = gl_line_width;
+		bool state_cache = gl.isStateCacheEnabled();
 
 		clock_now = glfwGetTime();
 		delta_time = clock_now - clock_before;
@@ -132,6 +133,13 @@ void BaseApplication::run()
 
 			ImGui::Text("Delta Time: %.3f", delta_time);
 
+			ImGui::Dummy(ImVec2(0.0f, 5.0f));
+			ImGui::Separator();
+
+			ImGui::Checkbox("State cache", &state_cache);
+			ImGui::Text("State calls issued:  %u", gl_counters.issued);
+			ImGui::Text("State calls skipped: %u", gl_counters.skipped);
+
 			ImGui::End();
 		}
 
@@ -140,6 +148,9 @@ void BaseApplication::run()
 			close();
 		}
 
+		gl_counters = gl.getCounters();
+		gl.resetCounters();
+
 		ImGui::Render();
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
@@ -167,6 +178,11 @@ void BaseApplication::run()
 			gl_line_width = line_width;
 			gl.setLineWidth(gl_line_width);
 		}
+
+		if (state_cache != gl.isStateCacheEnabled())
+		{
+			gl.setStateCacheEnabled(state_cache);
+		}
 	}
 }
 
@@ -65,6 +65,9 @@ protected:
 	OpenGLContext gl;
 	bool gl_wireframe = false;
 	float gl_line_width = 1.0f;
+
+	// State cache calls made in the last frame
+	StateCacheCounters gl_counters;
 };
 
 #endif // BASE_APP_HPP
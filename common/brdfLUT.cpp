@@ -0,0 +1,211 @@
+#include "brdfLUT.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#define PI 3.1415926535f
+
+static float radicalInverseVDC(uint32_t bits)
+{
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+
+	return float(bits) * 2.3283064365386963e-10f;
+}
+
+static float geometrySchlickGGX(float n_dot_v, float k)
+{
+	return n_dot_v / (n_dot_v * (1.0f - k) + k);
+}
+
+// The half vectors only depend on the roughness, so they are generated
+// once per row (structure of arrays) and the inner loop over the samples
+// is left without transcendental functions or branches
+static void integrateRow(
+	int width,
+	int height,
+	int y,
+	unsigned n_samples,
+	std::vector<float>& h_x,
+	std::vector<float>& h_z,
+	float* row)
+{
+	float roughness = (y + 0.5f) / height;
+	float a = roughness * roughness;
+	float k = a / 2.0f;
+
+	for (unsigned i = 0u; i < n_samples; ++i)
+	{
+		float xi_x = float(i) / float(n_samples);
+		float xi_y = radicalInverseVDC(i);
+
+		float phi = 2.0f * PI * xi_x;
+		float cos_theta = std::sqrt((1.0f - xi_y) / (1.0f + (a * a - 1.0f) * xi_y));
+		float sin_theta = std::sqrt(1.0f - cos_theta * cos_theta);
+
+		// Tangent space to world with n = (0, 0, 1), as in the shader.
+		// The y component never contributes since v.y == 0
+		h_x[i] = std::sin(phi) * sin_theta;
+		h_z[i] = cos_theta;
+	}
+
+	for (int x = 0; x < width; ++x)
+	{
+		float n_dot_v = (x + 0.5f) / width;
+
+		float v_x = std::sqrt(1.0f - n_dot_v * n_dot_v);
+		float v_z = n_dot_v;
+
+		float g_v = geometrySchlickGGX(n_dot_v, k);
+
+		float scale = 0.0f;
+		float bias = 0.0f;
+
+		for (unsigned i = 0u; i < n_samples; ++i)
+		{
+			float v_dot_h = v_x * h_x[i] + v_z * h_z[i];
+			float n_dot_l = 2.0f * v_dot_h * h_z[i] - v_z;
+
+			float h_dot_v = std::max(v_dot_h, 0.0f);
+			float n_dot_l_clamped = std::max(n_dot_l, 1e-8f);
+
+			float g = g_v * geometrySchlickGGX(n_dot_l_clamped, k);
+			float g_vis = (g * h_dot_v) / (h_z[i] * n_dot_v);
+
+			float fc = 1.0f - h_dot_v;
+			float fc_2 = fc * fc;
+			fc = fc_2 * fc_2 * fc;
+
+			float mask = n_dot_l > 0.0f ? 1.0f : 0.0f;
+
+			scale += mask * (1.0f - fc) * g_vis;
+			bias += mask * fc * g_vis;
+		}
+
+		row[2 * x] = scale / n_samples;
+		row[2 * x + 1] = bias / n_samples;
+	}
+}
+
+std::vector<float> integrateBRDFLUT(
+	int width,
+	int height,
+	unsigned n_samples,
+	unsigned n_threads)
+{
+	if (n_threads == 0u)
+	{
+		n_threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	n_threads = std::min(n_threads, (unsigned)height);
+
+	std::vector<float> lut(2 * width * height);
+
+	// Rows are interleaved between the threads, since
+	// the cost of a row doesn't depend on its roughness
+	auto worker = [&](unsigned thread_id)
+	{
+		std::vector<float> h_x(n_samples);
+		std::vector<float> h_z(n_samples);
+
+		for (int y = thread_id; y < height; y += n_threads)
+		{
+			integrateRow(width, height, y, n_samples,
+				h_x, h_z, lut.data() + 2 * width * y);
+		}
+	};
+
+	std::vector<std::thread> threads;
+
+	for (unsigned i = 1u; i < n_threads; ++i)
+	{
+		threads.emplace_back(worker, i);
+	}
+
+	worker(0u);
+
+	for (auto& it : threads)
+	{
+		it.join();
+	}
+
+	return lut;
+}
+
+struct BRDFLUTHeader
+{
+	char magic[8];
+	int32_t width;
+	int32_t height;
+	uint32_t n_samples;
+};
+
+std::vector<float> loadBRDFLUT(
+	std::string const& cache_path,
+	int width,
+	int height,
+	unsigned n_samples,
+	bool& from_cache)
+{
+	BRDFLUTHeader expected;
+	std::memcpy(expected.magic, "BRDFLUT1", 8);
+	expected.width = width;
+	expected.height = height;
+	expected.n_samples = n_samples;
+
+	std::vector<float> lut(2 * width * height);
+
+	std::ifstream in(cache_path, std::ios::binary);
+
+	if (in)
+	{
+		BRDFLUTHeader header;
+		in.read((char*)&header, sizeof(header));
+
+		if (in && std::memcmp(&header, &expected, sizeof(header)) == 0)
+		{
+			in.read((char*)lut.data(), lut.size() * sizeof(float));
+
+			if (in)
+			{
+				from_cache = true;
+				return lut;
+			}
+		}
+	}
+
+	from_cache = false;
+
+	lut = integrateBRDFLUT(width, height, n_samples);
+
+	std::error_code error;
+	std::filesystem::path path(cache_path);
+
+	if (path.has_parent_path())
+	{
+		std::filesystem::create_directories(path.parent_path(), error);
+	}
+
+	std::ofstream out(cache_path, std::ios::binary);
+
+	if (!out)
+	{
+		std::cerr << "WARNING: Could not write " << cache_path << '\n';
+		return lut;
+	}
+
+	out.write((char const*)&expected, sizeof(expected));
+	out.write((char const*)lut.data(), lut.size() * sizeof(float));
+
+	return lut;
+}
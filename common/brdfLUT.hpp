@@ -0,0 +1,33 @@
+#ifndef BRDF_LUT_HPP
+#define BRDF_LUT_HPP
+
+#include <string>
+#include <vector>
+
+/*
+ * Environment BRDF lookup table of the split sum approximation,
+ * integrated on the CPU with the same importance sampled GGX
+ * estimator used by the brdfConvolution shaders.
+ *
+ * Texel (x, y) holds the scale and bias to F0 for
+ * n_dot_v = (x + 0.5) / width and roughness = (y + 0.5) / height,
+ * stored as interleaved RG floats, row by row.
+ */
+
+// @n_threads == 0 uses every hardware thread
+std::vector<float> integrateBRDFLUT(
+	int width,
+	int height,
+	unsigned n_samples,
+	unsigned n_threads = 0);
+
+// Reads the table from @cache_path if it was integrated with the same
+// parameters. Otherwise integrates it and writes it to @cache_path
+std::vector<float> loadBRDFLUT(
+	std::string const& cache_path,
+	int width,
+	int height,
+	unsigned n_samples,
+	bool& from_cache);
+
+#endif // BRDF_LUT_HPP
@@ -0,0 +1,617 @@
+#include "culling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+// SSE is part of every x86-64 target, so only 32 bit builds and
+// other architectures take the scalar path
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define CULLING_SSE
+#include <xmmintrin.h>
+#endif
+
+// AVX code is compiled for its own function and only called when
+// the CPU has it, so the rest of the program doesn't require it
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CULLING_AVX
+#include <immintrin.h>
+#endif
+
+Frustum extractFrustum(glm::mat4 const& pv_matrix)
+{
+	// glm is column major, so the rows are gathered by hand
+	glm::vec4 rows[4];
+
+	for (int i = 0; i < 4; ++i)
+	{
+		rows[i] = glm::vec4(pv_matrix[0][i], pv_matrix[1][i], pv_matrix[2][i], pv_matrix[3][i]);
+	}
+
+	Frustum frustum;
+
+	frustum.planes[0] = rows[3] + rows[0]; // Left
+	frustum.planes[1] = rows[3] - rows[0]; // Right
+	frustum.planes[2] = rows[3] + rows[1]; // Bottom
+	frustum.planes[3] = rows[3] - rows[1]; // Top
+	frustum.planes[4] = rows[3] + rows[2]; // Near
+	frustum.planes[5] = rows[3] - rows[2]; // Far
+
+	// Normalized, so that sphere radii can be compared to the distances
+	for (auto& plane : frustum.planes)
+	{
+		plane = plane / glm::length(glm::vec3(plane));
+	}
+
+	return frustum;
+}
+
+Bounds transformBounds(Bounds const& bounds, glm::mat4 const& model_matrix)
+{
+	glm::mat3 linear(model_matrix);
+
+	glm::vec3 center = 0.5f * (bounds.min + bounds.max);
+	glm::vec3 extent = 0.5f * (bounds.max - bounds.min);
+
+	glm::mat3 absolute;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		absolute[i] = glm::abs(linear[i]);
+	}
+
+	center = glm::vec3(model_matrix * glm::vec4(center, 1.0f));
+	extent = absolute * extent;
+
+	float scale = glm::max(glm::length(linear[0]),
+		glm::max(glm::length(linear[1]), glm::length(linear[2])));
+
+	Bounds result;
+
+	result.min = center - extent;
+	result.max = center + extent;
+
+	result.center = glm::vec3(model_matrix * glm::vec4(bounds.center, 1.0f));
+	result.radius = bounds.radius * scale;
+
+	return result;
+}
+
+void BoundsArrays::resize(size_t size)
+{
+	this->size = size;
+
+	// An extra group past the end keeps unaligned loads of four
+	// objects starting at any object in range, and of eight starting
+	// at any multiple of eight
+	size_t padded = ((size + 3u) / 4u + 1u) * 4u;
+
+	center_x.assign(padded, 0.0f);
+	center_y.assign(padded, 0.0f);
+	center_z.assign(padded, 0.0f);
+
+	extent_x.assign(padded, 0.0f);
+	extent_y.assign(padded, 0.0f);
+	extent_z.assign(padded, 0.0f);
+
+	radius.assign(padded, 0.0f);
+}
+
+void BoundsArrays::set(size_t i, Bounds const& bounds)
+{
+	// Both volumes are centered on the box
+	glm::vec3 center = 0.5f * (bounds.min + bounds.max);
+	glm::vec3 extent = 0.5f * (bounds.max - bounds.min);
+
+	center_x[i] = center.x;
+	center_y[i] = center.y;
+	center_z[i] = center.z;
+
+	extent_x[i] = extent.x;
+	extent_y[i] = extent.y;
+	extent_z[i] = extent.z;
+
+	radius[i] = bounds.radius;
+}
+
+size_t BoundsArrays::getSize() const
+{
+	return size;
+}
+
+// Pointers to the components of a group of objects
+struct Volumes
+{
+	float const* center_x;
+	float const* center_y;
+	float const* center_z;
+
+	float const* extent_x;
+	float const* extent_y;
+	float const* extent_z;
+
+	float const* radius; // Only read for spheres
+};
+
+static Volumes volumesAt(BoundsArrays const& bounds, size_t first)
+{
+	return Volumes{
+		bounds.center_x.data() + first,
+		bounds.center_y.data() + first,
+		bounds.center_z.data() + first,
+		bounds.extent_x.data() + first,
+		bounds.extent_y.data() + first,
+		bounds.extent_z.data() + first,
+		bounds.radius.data() + first };
+}
+
+// Returns 0 if the object @i of @volumes is outside, 1 if
+// it crosses a plane and 2 if it's completely inside
+static int testOne(
+	Frustum const& frustum,
+	Volumes const& volumes,
+	CullingVolume volume,
+	size_t i)
+{
+	glm::vec3 center(volumes.center_x[i], volumes.center_y[i], volumes.center_z[i]);
+	glm::vec3 extent(volumes.extent_x[i], volumes.extent_y[i], volumes.extent_z[i]);
+
+	int result = 2;
+
+	for (auto& plane : frustum.planes)
+	{
+		glm::vec3 normal(plane);
+
+		float distance = glm::dot(normal, center) + plane.w;
+
+		// Boxes reach as far as their extent projected on the normal
+		float radius = volume == CULL_SPHERES ?
+			volumes.radius[i] : glm::dot(glm::abs(normal), extent);
+
+		if (distance < -radius)
+		{
+			return 0;
+		}
+
+		if (distance < radius)
+		{
+			result = 1;
+		}
+	}
+
+	return result;
+}
+
+// Tests four consecutive objects. Bit i of the result is set if
+// object i is visible, and of @inside if it's completely inside
+static int testFour(
+	Frustum const& frustum,
+	Volumes const& volumes,
+	CullingVolume volume,
+	int& inside)
+{
+#ifdef CULLING_SSE
+	__m128 center_x = _mm_loadu_ps(volumes.center_x);
+	__m128 center_y = _mm_loadu_ps(volumes.center_y);
+	__m128 center_z = _mm_loadu_ps(volumes.center_z);
+
+	__m128 extent_x = _mm_loadu_ps(volumes.extent_x);
+	__m128 extent_y = _mm_loadu_ps(volumes.extent_y);
+	__m128 extent_z = _mm_loadu_ps(volumes.extent_z);
+
+	__m128 radius = volume == CULL_SPHERES ?
+		_mm_loadu_ps(volumes.radius) : _mm_setzero_ps();
+
+	__m128 outside = _mm_setzero_ps();
+	__m128 crossing = _mm_setzero_ps();
+
+	for (auto& plane : frustum.planes)
+	{
+		__m128 distance = _mm_add_ps(
+			_mm_add_ps(
+				_mm_mul_ps(_mm_set1_ps(plane.x), center_x),
+				_mm_mul_ps(_mm_set1_ps(plane.y), center_y)),
+			_mm_add_ps(
+				_mm_mul_ps(_mm_set1_ps(plane.z), center_z),
+				_mm_set1_ps(plane.w)));
+
+		if (volume == CULL_BOXES)
+		{
+			radius = _mm_add_ps(
+				_mm_add_ps(
+					_mm_mul_ps(_mm_set1_ps(std::abs(plane.x)), extent_x),
+					_mm_mul_ps(_mm_set1_ps(std::abs(plane.y)), extent_y)),
+				_mm_mul_ps(_mm_set1_ps(std::abs(plane.z)), extent_z));
+		}
+
+		outside = _mm_or_ps(outside,
+			_mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+		crossing = _mm_or_ps(crossing, _mm_cmplt_ps(distance, radius));
+	}
+
+	inside = ~_mm_movemask_ps(crossing) & 0xF;
+
+	return ~_mm_movemask_ps(outside) & 0xF;
+#else
+	int visible = 0;
+	inside = 0;
+
+	for (int i = 0; i < 4; ++i)
+	{
+		int result = testOne(frustum, volumes, volume, i);
+
+		visible |= (result > 0) << i;
+		inside |= (result == 2) << i;
+	}
+
+	return visible;
+#endif
+}
+
+#ifdef CULLING_AVX
+// Same as testFour, for eight objects
+__attribute__((target("avx")))
+static int testEight(
+	Frustum const& frustum,
+	Volumes const& volumes,
+	CullingVolume volume,
+	int& inside)
+{
+	__m256 center_x = _mm256_loadu_ps(volumes.center_x);
+	__m256 center_y = _mm256_loadu_ps(volumes.center_y);
+	__m256 center_z = _mm256_loadu_ps(volumes.center_z);
+
+	__m256 extent_x = _mm256_loadu_ps(volumes.extent_x);
+	__m256 extent_y = _mm256_loadu_ps(volumes.extent_y);
+	__m256 extent_z = _mm256_loadu_ps(volumes.extent_z);
+
+	__m256 radius = volume == CULL_SPHERES ?
+		_mm256_loadu_ps(volumes.radius) : _mm256_setzero_ps();
+
+	__m256 outside = _mm256_setzero_ps();
+	__m256 crossing = _mm256_setzero_ps();
+
+	for (auto& plane : frustum.planes)
+	{
+		__m256 distance = _mm256_add_ps(
+			_mm256_add_ps(
+				_mm256_mul_ps(_mm256_set1_ps(plane.x), center_x),
+				_mm256_mul_ps(_mm256_set1_ps(plane.y), center_y)),
+			_mm256_add_ps(
+				_mm256_mul_ps(_mm256_set1_ps(plane.z), center_z),
+				_mm256_set1_ps(plane.w)));
+
+		if (volume == CULL_BOXES)
+		{
+			radius = _mm256_add_ps(
+				_mm256_add_ps(
+					_mm256_mul_ps(_mm256_set1_ps(std::abs(plane.x)), extent_x),
+					_mm256_mul_ps(_mm256_set1_ps(std::abs(plane.y)), extent_y)),
+				_mm256_mul_ps(_mm256_set1_ps(std::abs(plane.z)), extent_z));
+		}
+
+		outside = _mm256_or_ps(outside, _mm256_cmp_ps(
+			_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+		crossing = _mm256_or_ps(crossing, _mm256_cmp_ps(distance, radius, _CMP_LT_OQ));
+	}
+
+	inside = ~_mm256_movemask_ps(crossing) & 0xFF;
+
+	return ~_mm256_movemask_ps(outside) & 0xFF;
+}
+#endif
+
+bool cullingUsesAVX()
+{
+#ifdef CULLING_AVX
+	static bool avx = __builtin_cpu_supports("avx");
+
+	return avx;
+#else
+	return false;
+#endif
+}
+
+size_t cullScalar(
+	Frustum const& frustum,
+	BoundsArrays const& bounds,
+	CullingVolume volume,
+	std::vector<uint8_t>& visible)
+{
+	Volumes volumes = volumesAt(bounds, 0u);
+	size_t n_visible = 0u;
+
+	for (size_t i = 0u; i < bounds.getSize(); ++i)
+	{
+		visible[i] = testOne(frustum, volumes, volume, i) > 0;
+		n_visible += visible[i];
+	}
+
+	return n_visible;
+}
+
+size_t cullSIMD(
+	Frustum const& frustum,
+	BoundsArrays const& bounds,
+	CullingVolume volume,
+	std::vector<uint8_t>& visible)
+{
+	size_t n_visible = 0u;
+
+#ifdef CULLING_AVX
+	if (cullingUsesAVX())
+	{
+		for (size_t i = 0u; i < bounds.getSize(); i += 8u)
+		{
+			int inside;
+			int mask = testEight(frustum, volumesAt(bounds, i), volume, inside);
+
+			size_t n = std::min<size_t>(8u, bounds.getSize() - i);
+
+			for (size_t j = 0u; j < n; ++j)
+			{
+				visible[i + j] = (mask >> j) & 1;
+				n_visible += visible[i + j];
+			}
+		}
+
+		return n_visible;
+	}
+#endif
+
+	for (size_t i = 0u; i < bounds.getSize(); i += 4u)
+	{
+		int inside;
+		int mask = testFour(frustum, volumesAt(bounds, i), volume, inside);
+
+		size_t n = std::min<size_t>(4u, bounds.getSize() - i);
+
+		for (size_t j = 0u; j < n; ++j)
+		{
+			visible[i + j] = (mask >> j) & 1;
+			n_visible += visible[i + j];
+		}
+	}
+
+	return n_visible;
+}
+
+void BoundingVolumeHierarchy::build(std::vector<Bounds> const& bounds)
+{
+	uint32_t n_objects = static_cast<uint32_t>(bounds.size());
+
+	objects.resize(n_objects);
+	std::iota(objects.begin(), objects.end(), 0u);
+
+	nodes.clear();
+
+	if (n_objects > 0u)
+	{
+		buildNode(bounds, 0u, n_objects);
+	}
+
+	object_bounds.resize(n_objects);
+
+	for (uint32_t i = 0u; i < n_objects; ++i)
+	{
+		object_bounds.set(i, bounds[objects[i]]);
+	}
+
+	stats = BVHStats();
+	stats.nodes = static_cast<unsigned>(nodes.size());
+}
+
+// Partitions the range at the median of the longest axis
+// of the box centers. Returns the size of the first half
+static uint32_t splitRange(
+	std::vector<Bounds> const& bounds,
+	std::vector<uint32_t>& objects,
+	uint32_t first,
+	uint32_t count)
+{
+	auto center = [&bounds](uint32_t object)
+	{
+		return 0.5f * (bounds[object].min + bounds[object].max);
+	};
+
+	glm::vec3 min = center(objects[first]);
+	glm::vec3 max = min;
+
+	for (uint32_t i = first + 1u; i < first + count; ++i)
+	{
+		min = glm::min(min, center(objects[i]));
+		max = glm::max(max, center(objects[i]));
+	}
+
+	glm::vec3 size = max - min;
+
+	int axis = size.x > size.y ?
+		(size.x > size.z ? 0 : 2) :
+		(size.y > size.z ? 1 : 2);
+
+	uint32_t half = count / 2u;
+
+	std::nth_element(
+		objects.begin() + first,
+		objects.begin() + first + half,
+		objects.begin() + first + count,
+		[&center, axis](uint32_t a, uint32_t b)
+		{
+			return center(a)[axis] < center(b)[axis];
+		});
+
+	return half;
+}
+
+int32_t BoundingVolumeHierarchy::buildNode(
+	std::vector<Bounds> const& bounds,
+	uint32_t first,
+	uint32_t count)
+{
+	int32_t index = static_cast<int32_t>(nodes.size());
+	nodes.emplace_back();
+
+	// Up to four ranges, from splitting the range and then its halves
+	uint32_t range_first[4];
+	uint32_t range_count[4];
+	int n_ranges = 0;
+
+	uint32_t half = splitRange(bounds, objects, first, count);
+	uint32_t halves_first[2] = { first, first + half };
+	uint32_t halves_count[2] = { half, count - half };
+
+	for (int i = 0; i < 2; ++i)
+	{
+		if (halves_count[i] > BVH_LEAF_SIZE)
+		{
+			uint32_t quarter = splitRange(bounds, objects, halves_first[i], halves_count[i]);
+
+			range_first[n_ranges] = halves_first[i];
+			range_count[n_ranges++] = quarter;
+
+			range_first[n_ranges] = halves_first[i] + quarter;
+			range_count[n_ranges++] = halves_count[i] - quarter;
+		}
+		else if (halves_count[i] > 0u)
+		{
+			range_first[n_ranges] = halves_first[i];
+			range_count[n_ranges++] = halves_count[i];
+		}
+	}
+
+	// Filled on the side, since the recursion grows the node vector
+	Node node;
+
+	for (int i = 0; i < 4; ++i)
+	{
+		node.center_x[i] = node.center_y[i] = node.center_z[i] = 0.0f;
+		node.extent_x[i] = node.extent_y[i] = node.extent_z[i] = 0.0f;
+		node.child[i] = -1;
+		node.first[i] = 0u;
+		node.count[i] = 0u;
+
+		if (i >= n_ranges)
+		{
+			continue;
+		}
+
+		glm::vec3 min = bounds[objects[range_first[i]]].min;
+		glm::vec3 max = bounds[objects[range_first[i]]].max;
+
+		for (uint32_t j = range_first[i] + 1u; j < range_first[i] + range_count[i]; ++j)
+		{
+			min = glm::min(min, bounds[objects[j]].min);
+			max = glm::max(max, bounds[objects[j]].max);
+		}
+
+		glm::vec3 center = 0.5f * (min + max);
+		glm::vec3 extent = 0.5f * (max - min);
+
+		node.center_x[i] = center.x;
+		node.center_y[i] = center.y;
+		node.center_z[i] = center.z;
+
+		node.extent_x[i] = extent.x;
+		node.extent_y[i] = extent.y;
+		node.extent_z[i] = extent.z;
+
+		node.first[i] = range_first[i];
+		node.count[i] = range_count[i];
+
+		if (range_count[i] > BVH_LEAF_SIZE)
+		{
+			node.child[i] = buildNode(bounds, range_first[i], range_count[i]);
+		}
+	}
+
+	nodes[index] = node;
+
+	return index;
+}
+
+size_t BoundingVolumeHierarchy::cull(
+	Frustum const& frustum,
+	CullingVolume volume,
+	std::vector<uint8_t>& visible)
+{
+	std::fill(visible.begin(), visible.begin() + objects.size(), 0);
+
+	stats.visited_nodes = 0u;
+	stats.tested_objects = 0u;
+
+	if (nodes.empty())
+	{
+		return 0u;
+	}
+
+	size_t n_visible = 0u;
+
+	stack.clear();
+	stack.push_back(0);
+
+	while (!stack.empty())
+	{
+		Node const& node = nodes[stack.back()];
+		stack.pop_back();
+
+		++stats.visited_nodes;
+
+		Volumes children{
+			node.center_x, node.center_y, node.center_z,
+			node.extent_x, node.extent_y, node.extent_z,
+			nullptr };
+
+		int inside;
+		int mask = testFour(frustum, children, CULL_BOXES, inside);
+
+		for (int i = 0; i < 4; ++i)
+		{
+			if (node.count[i] == 0u || !(mask & (1 << i)))
+			{
+				continue;
+			}
+
+			uint32_t first = node.first[i];
+			uint32_t count = node.count[i];
+
+			if (inside & (1 << i))
+			{
+				// Nothing under a box inside the frustum can be outside
+				for (uint32_t j = first; j < first + count; ++j)
+				{
+					visible[objects[j]] = 1u;
+				}
+
+				n_visible += count;
+			}
+			else if (node.child[i] >= 0)
+			{
+				stack.push_back(node.child[i]);
+			}
+			else
+			{
+				int leaf_inside;
+				int leaf_mask = testFour(frustum, volumesAt(object_bounds, first),
+					volume, leaf_inside);
+
+				for (uint32_t j = 0u; j < count; ++j)
+				{
+					if (leaf_mask & (1 << j))
+					{
+						visible[objects[first + j]] = 1u;
+						++n_visible;
+					}
+				}
+
+				stats.tested_objects += count;
+			}
+		}
+	}
+
+	return n_visible;
+}
+
+BVHStats BoundingVolumeHierarchy::getStats() const
+{
+	return stats;
+}
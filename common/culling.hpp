@@ -0,0 +1,147 @@
+#ifndef CULLING_HPP
+#define CULLING_HPP
+
+#include "glContext.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Objects below this count end a branch of the hierarchy
+#define BVH_LEAF_SIZE 4u
+
+/*
+ * Planes of a view frustum, normalized and facing inwards, so a
+ * point is inside when its distance to every plane is positive
+ */
+struct Frustum
+{
+	glm::vec4 planes[6];
+};
+
+// Gribb-Hartmann extraction from a projection * view matrix
+Frustum extractFrustum(glm::mat4 const& pv_matrix);
+
+// World space bounds of an object. The box is kept axis aligned,
+// which makes it looser when the object is rotated
+Bounds transformBounds(Bounds const& bounds, glm::mat4 const& model_matrix);
+
+enum CullingVolume
+{
+	CULL_SPHERES = 0,
+	CULL_BOXES = 1
+};
+
+/*
+ * Bounds of many objects as a structure of arrays, so that a SIMD
+ * test loads the same component of four objects with one instruction.
+ * Boxes are stored as center and half extent. The arrays are padded
+ * to a multiple of four, the padding never being reported visible
+ */
+class BoundsArrays
+{
+public:
+	void resize(size_t size);
+	void set(size_t i, Bounds const& bounds);
+
+	size_t getSize() const;
+
+	std::vector<float> center_x;
+	std::vector<float> center_y;
+	std::vector<float> center_z;
+
+	std::vector<float> extent_x;
+	std::vector<float> extent_y;
+	std::vector<float> extent_z;
+
+	std::vector<float> radius;
+
+private:
+	size_t size = 0u;
+};
+
+/*
+ * Marks the objects of @bounds that intersect @frustum in @visible,
+ * which must hold an entry per object. Returns the visible count.
+ * The scalar version tests an object at a time and the other eight
+ * at a time with AVX when the CPU has it, four at a time with SSE
+ * otherwise, and falls back to the scalar one without either
+ */
+size_t cullScalar(
+	Frustum const& frustum,
+	BoundsArrays const& bounds,
+	CullingVolume volume,
+	std::vector<uint8_t>& visible);
+
+size_t cullSIMD(
+	Frustum const& frustum,
+	BoundsArrays const& bounds,
+	CullingVolume volume,
+	std::vector<uint8_t>& visible);
+
+// Whether cullSIMD tests eight objects at a time
+bool cullingUsesAVX();
+
+struct BVHStats
+{
+	unsigned nodes = 0u;
+	unsigned visited_nodes = 0u;
+	unsigned tested_objects = 0u;
+};
+
+/*
+ * Bounding volume hierarchy with four children per node. The boxes
+ * of the children are tested against the frustum with one SIMD test,
+ * the subtrees of boxes fully inside being accepted without testing
+ * them further. Leaves test their objects the same way
+ */
+class BoundingVolumeHierarchy
+{
+public:
+	// Splits the objects at the median of the longest axis of their
+	// centers, twice per node. Indices to @bounds identify the objects
+	void build(std::vector<Bounds> const& bounds);
+
+	// Same as cullSIMD
+	size_t cull(
+		Frustum const& frustum,
+		CullingVolume volume,
+		std::vector<uint8_t>& visible);
+
+	BVHStats getStats() const;
+
+private:
+	struct Node
+	{
+		// Boxes of the children
+		float center_x[4];
+		float center_y[4];
+		float center_z[4];
+
+		float extent_x[4];
+		float extent_y[4];
+		float extent_z[4];
+
+		// Node index of each child, -1 for leaves
+		int32_t child[4];
+
+		// Range of objects under each child. Empty slots have no objects
+		uint32_t first[4];
+		uint32_t count[4];
+	};
+
+	int32_t buildNode(
+		std::vector<Bounds> const& bounds,
+		uint32_t first,
+		uint32_t count);
+
+	// The objects reordered so that every subtree is a range
+	std::vector<uint32_t> objects;
+	BoundsArrays object_bounds;
+
+	std::vector<Node> nodes;
+	std::vector<int32_t> stack;
+
+	BVHStats stats;
+};
+
+#endif // CULLING_HPP
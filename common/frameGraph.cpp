@@ -0,0 +1,579 @@
+#include "frameGraph.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+
+#define NO_PASS (~size_t(0))
+
+static bool isDepthFormat(GLenum internal_format)
+{
+	switch (internal_format)
+	{
+	case GL_DEPTH_COMPONENT16:
+	case GL_DEPTH_COMPONENT24:
+	case GL_DEPTH_COMPONENT32:
+	case GL_DEPTH_COMPONENT32F:
+	case GL_DEPTH24_STENCIL8:
+	case GL_DEPTH32F_STENCIL8:
+		return true;
+	}
+
+	return false;
+}
+
+static size_t bytesPerTexel(GLenum internal_format)
+{
+	switch (internal_format)
+	{
+	case GL_R8:
+		return 1u;
+
+	case GL_RG8:
+	case GL_R16F:
+	case GL_DEPTH_COMPONENT16:
+		return 2u;
+
+	case GL_RGBA16F:
+	case GL_RG32F:
+	case GL_DEPTH32F_STENCIL8:
+		return 8u;
+
+	case GL_RGBA32F:
+		return 16u;
+	}
+
+	// RGBA8, RG16F, R32F, R11F_G11F_B10F and the 32 bit depth formats
+	return 4u;
+}
+
+static size_t textureBytes(TransientTextureDesc const& desc)
+{
+	return static_cast<size_t>(desc.width) * desc.height * bytesPerTexel(desc.internal_format);
+}
+
+// Sizes go 16, 24, 32, 48, 64, 96... so at most a third
+// of a bucket is unused along each side
+static int bucketSize(int size)
+{
+	int bucket = FRAME_GRAPH_MIN_BUCKET;
+
+	while (bucket < size)
+	{
+		// Powers of two are followed by one and a half times them
+		bucket = (bucket & (bucket - 1)) ? bucket / 3 * 4 : bucket / 2 * 3;
+	}
+
+	return bucket;
+}
+
+// A texture stores a request of its format that it covers, unless
+// it's over twice the size of the bucket of the request, to keep
+// shrinking windows from holding on to the largest textures
+static bool fits(TransientTextureDesc const& texture, TransientTextureDesc const& request)
+{
+	return
+		texture.internal_format == request.internal_format &&
+		texture.width >= request.width &&
+		texture.height >= request.height &&
+		texture.width <= 2 * bucketSize(request.width) &&
+		texture.height <= 2 * bucketSize(request.height);
+}
+
+bool TransientTextureDesc::operator==(TransientTextureDesc const& other) const
+{
+	return
+		width == other.width &&
+		height == other.height &&
+		internal_format == other.internal_format;
+}
+
+void FrameGraph::reset()
+{
+	resources.clear();
+	passes.clear();
+	compiled = false;
+}
+
+FrameGraphResource FrameGraph::createTexture(
+	std::string const& name,
+	TransientTextureDesc const& desc)
+{
+	Resource resource;
+	resource.name = name;
+	resource.desc = desc;
+	resource.writer = NO_PASS;
+
+	resources.push_back(resource);
+
+	return resources.size() - 1u;
+}
+
+size_t FrameGraph::addPass(std::string const& name, std::function<void()> const& execute)
+{
+	Pass pass;
+	pass.name = name;
+	pass.execute = execute;
+
+	passes.push_back(pass);
+
+	return passes.size() - 1u;
+}
+
+size_t FrameGraph::addComputePass(std::string const& name, std::function<void()> const& execute)
+{
+	size_t pass = addPass(name, execute);
+	passes[pass].compute = true;
+
+	return pass;
+}
+
+void FrameGraph::read(size_t pass, FrameGraphResource resource)
+{
+	passes[pass].reads.push_back(resource);
+	++resources[resource].n_readers;
+}
+
+void FrameGraph::write(size_t pass, FrameGraphResource resource)
+{
+	if (resources[resource].writer != NO_PASS)
+	{
+		std::cerr << "ERROR: " << resources[resource].name << " is written by "
+			<< passes[resources[resource].writer].name << " and " << passes[pass].name << '\n';
+		abort();
+	}
+
+	passes[pass].writes.push_back(resource);
+	resources[resource].writer = pass;
+}
+
+void FrameGraph::markOutput(FrameGraphResource resource)
+{
+	resources[resource].output = true;
+}
+
+void FrameGraph::compile(OpenGLContext& gl)
+{
+	++frame;
+
+	cullPasses();
+	computeLifetimes();
+	freeIdleTextures(gl);
+	allocateTextures();
+
+	compiled = true;
+}
+
+// Counts the readers of every resource and the resources read from
+// every pass. Whatever drops to zero goes, and takes its inputs along
+void FrameGraph::cullPasses()
+{
+	std::vector<unsigned> resource_counts(resources.size());
+	std::vector<unsigned> pass_counts(passes.size());
+	std::vector<FrameGraphResource> unused;
+
+	for (size_t i = 0u; i < resources.size(); ++i)
+	{
+		resource_counts[i] = resources[i].n_readers + (resources[i].output ? 1u : 0u);
+
+		if (resource_counts[i] == 0u)
+		{
+			unused.push_back(i);
+		}
+	}
+
+	for (size_t i = 0u; i < passes.size(); ++i)
+	{
+		pass_counts[i] = static_cast<unsigned>(passes[i].writes.size());
+		passes[i].culled = false;
+	}
+
+	while (!unused.empty())
+	{
+		size_t writer = resources[unused.back()].writer;
+		unused.pop_back();
+
+		if (writer == NO_PASS || --pass_counts[writer] > 0u)
+		{
+			continue;
+		}
+
+		passes[writer].culled = true;
+
+		for (auto it : passes[writer].reads)
+		{
+			if (--resource_counts[it] == 0u)
+			{
+				unused.push_back(it);
+			}
+		}
+	}
+}
+
+void FrameGraph::computeLifetimes()
+{
+	for (auto& it : resources)
+	{
+		it.first_pass = NO_PASS;
+		it.last_pass = 0u;
+	}
+
+	for (size_t i = 0u; i < passes.size(); ++i)
+	{
+		if (passes[i].culled)
+		{
+			continue;
+		}
+
+		for (auto list : { &passes[i].reads, &passes[i].writes })
+		{
+			for (auto it : *list)
+			{
+				resources[it].first_pass = std::min(resources[it].first_pass, i);
+				resources[it].last_pass = std::max(resources[it].last_pass, i);
+			}
+		}
+	}
+
+	// Outputs are read after the last pass
+	for (auto& it : resources)
+	{
+		if (it.output && it.first_pass != NO_PASS)
+		{
+			it.last_pass = passes.size();
+		}
+	}
+}
+
+// Resources are stored in order of their first pass. Each one takes a
+// texture taken this frame whose resources are done by then, another
+// one from the pool, or a new one, in that order of preference
+void FrameGraph::allocateTextures()
+{
+	stats = FrameGraphStats();
+
+	for (auto& it : pool)
+	{
+		it.taken = false;
+	}
+
+	std::vector<size_t> order(resources.size());
+	std::iota(order.begin(), order.end(), 0u);
+
+	std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b)
+	{
+		return resources[a].first_pass < resources[b].first_pass;
+	});
+
+	for (auto i : order)
+	{
+		Resource& resource = resources[i];
+
+		if (resource.first_pass == NO_PASS)
+		{
+			continue;
+		}
+
+		size_t texture = pool.size();
+
+		// Aliasing, or else reuse across frames. The smallest
+		// texture that fits is taken in both cases
+		for (int taken = 1; taken >= 0 && texture == pool.size(); --taken)
+		{
+			for (size_t j = 0u; j < pool.size(); ++j)
+			{
+				PooledTexture const& candidate = pool[j];
+
+				bool available = taken ?
+					candidate.taken && candidate.last_pass < resource.first_pass :
+					!candidate.taken;
+
+				bool matches = bucketed ?
+					fits(candidate.desc, resource.desc) :
+					candidate.desc == resource.desc;
+
+				if (available && matches && (texture == pool.size() ||
+					textureBytes(candidate.desc) < textureBytes(pool[texture].desc)))
+				{
+					texture = j;
+				}
+			}
+		}
+
+		if (texture == pool.size())
+		{
+			PooledTexture pooled;
+			pooled.desc = resource.desc;
+
+			if (bucketed)
+			{
+				pooled.desc.width = bucketSize(resource.desc.width);
+				pooled.desc.height = bucketSize(resource.desc.height);
+			}
+
+			pooled.texture = Texture2D(pooled.desc.width, pooled.desc.height,
+				pooled.desc.internal_format,
+				GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_LINEAR, GL_LINEAR);
+
+			pool.push_back(pooled);
+
+			++stats.created_textures;
+		}
+
+		if (!pool[texture].taken)
+		{
+			++stats.textures;
+			stats.used_bytes += textureBytes(pool[texture].desc);
+		}
+
+		pool[texture].taken = true;
+		pool[texture].last_frame = frame;
+		pool[texture].last_pass = resource.last_pass;
+
+		resource.texture = texture;
+
+		++stats.resources;
+		stats.declared_bytes += textureBytes(resource.desc);
+	}
+
+	for (auto& it : passes)
+	{
+		stats.passes += it.culled ? 0u : 1u;
+		stats.culled_passes += it.culled ? 1u : 0u;
+	}
+
+	for (auto& it : pool)
+	{
+		++stats.pooled_textures;
+		stats.pooled_bytes += textureBytes(it.desc);
+	}
+}
+
+void FrameGraph::freeIdleTextures(OpenGLContext& gl)
+{
+	std::vector<PooledTexture> kept;
+	bool freed = false;
+
+	for (auto& it : pool)
+	{
+		if (frame - it.last_frame <= FRAME_GRAPH_MAX_IDLE_FRAMES)
+		{
+			kept.push_back(it);
+			continue;
+		}
+
+		GLuint id = it.texture.getId();
+
+		// The framebuffers it's attached to go too
+		for (auto fb = framebuffers.begin(); fb != framebuffers.end();)
+		{
+			if (std::find(fb->first.begin(), fb->first.end(), id) != fb->first.end())
+			{
+				fb->second->destroy();
+				delete fb->second;
+				fb = framebuffers.erase(fb);
+			}
+			else
+			{
+				++fb;
+			}
+		}
+
+		it.texture.destroy();
+		freed = true;
+	}
+
+	pool = kept;
+
+	// Deleted textures and framebuffers may still be bound
+	if (freed)
+	{
+		gl.invalidateState();
+	}
+}
+
+Framebuffer* FrameGraph::getFramebuffer(Pass const& pass)
+{
+	std::vector<GLuint> key;
+	GLuint depth = 0u;
+
+	for (auto it : pass.writes)
+	{
+		GLuint id = pool[resources[it].texture].texture.getId();
+
+		if (isDepthFormat(resources[it].desc.internal_format))
+		{
+			depth = id;
+		}
+		else
+		{
+			key.push_back(id);
+		}
+	}
+
+	size_t n_colors = key.size();
+	key.push_back(depth);
+
+	auto found = framebuffers.find(key);
+
+	if (found != framebuffers.end())
+	{
+		return found->second;
+	}
+
+	Framebuffer* framebuffer = new Framebuffer();
+	std::vector<GLenum> draw_buffers;
+
+	for (size_t i = 0u; i < n_colors; ++i)
+	{
+		glNamedFramebufferTexture(framebuffer->getId(), GL_COLOR_ATTACHMENT0 + i, key[i], 0);
+		draw_buffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+	}
+
+	if (depth)
+	{
+		glNamedFramebufferTexture(framebuffer->getId(), GL_DEPTH_ATTACHMENT, depth, 0);
+	}
+
+	glNamedFramebufferDrawBuffers(framebuffer->getId(),
+		static_cast<GLsizei>(draw_buffers.size()), draw_buffers.data());
+
+	framebuffer->checkStatus();
+
+	framebuffers[key] = framebuffer;
+
+	return framebuffer;
+}
+
+void FrameGraph::execute(OpenGLContext& gl, int width, int height)
+{
+	if (!compiled)
+	{
+		std::cerr << "ERROR: Executing a frame graph that wasn't compiled\n";
+		abort();
+	}
+
+	for (auto& it : passes)
+	{
+		if (it.culled)
+		{
+			continue;
+		}
+
+		if (it.compute)
+		{
+			gl.bindFramebuffer(0u);
+
+			it.execute();
+			continue;
+		}
+
+		if (it.writes.empty())
+		{
+			gl.bindFramebuffer(0u);
+			glViewport(0, 0, width, height);
+		}
+		else
+		{
+			TransientTextureDesc const& desc = resources[it.writes[0]].desc;
+
+			gl.bindFramebuffer(getFramebuffer(it)->getId());
+			glViewport(0, 0, desc.width, desc.height);
+		}
+
+		it.execute();
+	}
+}
+
+GLuint FrameGraph::getTexture(FrameGraphResource resource) const
+{
+	return pool[resources[resource].texture].texture.getId();
+}
+
+glm::vec2 FrameGraph::getUVScale(FrameGraphResource resource) const
+{
+	TransientTextureDesc const& desc = resources[resource].desc;
+	TransientTextureDesc const& texture = pool[resources[resource].texture].desc;
+
+	return glm::vec2(desc.width, desc.height) / glm::vec2(texture.width, texture.height);
+}
+
+glm::vec2 FrameGraph::getUVMax(FrameGraphResource resource) const
+{
+	TransientTextureDesc const& desc = resources[resource].desc;
+	TransientTextureDesc const& texture = pool[resources[resource].texture].desc;
+
+	return (glm::vec2(desc.width, desc.height) - 0.5f) /
+		glm::vec2(texture.width, texture.height);
+}
+
+void FrameGraph::setBucketed(bool state)
+{
+	bucketed = state;
+}
+
+bool FrameGraph::isBucketed() const
+{
+	return bucketed;
+}
+
+bool FrameGraph::isCompiled() const
+{
+	return compiled;
+}
+
+std::string FrameGraph::describe() const
+{
+	std::stringstream description;
+
+	for (auto& it : passes)
+	{
+		description << it.name << (it.culled ? " (culled)" : "") << '\n';
+	}
+
+	description << '\n';
+
+	for (auto& it : resources)
+	{
+		description << it.name << " " << it.desc.width << "x" << it.desc.height;
+
+		if (it.first_pass == NO_PASS)
+		{
+			description << ", unused\n";
+		}
+		else
+		{
+			TransientTextureDesc const& texture = pool[it.texture].desc;
+
+			description << ", texture " << it.texture << " (" <<
+				texture.width << "x" << texture.height << ")\n";
+		}
+	}
+
+	return description.str();
+}
+
+FrameGraphStats const& FrameGraph::getStats() const
+{
+	return stats;
+}
+
+void FrameGraph::destroy()
+{
+	for (auto& it : framebuffers)
+	{
+		it.second->destroy();
+		delete it.second;
+	}
+
+	for (auto& it : pool)
+	{
+		it.texture.destroy();
+	}
+
+	framebuffers.clear();
+	pool.clear();
+	reset();
+}
@@ -0,0 +1,198 @@
+#ifndef FRAME_GRAPH_HPP
+#define FRAME_GRAPH_HPP
+
+#include "framebuffer.hpp"
+#include "glContext.hpp"
+#include "texture.hpp"
+
+#include <glad/glad.h>
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// Frames a pooled texture can go unused before it's freed. After
+// a resize the old sizes stop being used and go away this way
+#define FRAME_GRAPH_MAX_IDLE_FRAMES 60u
+
+// Smallest side of a bucketed texture
+#define FRAME_GRAPH_MIN_BUCKET 16
+
+// Textures with equal descriptions are interchangeable
+struct TransientTextureDesc
+{
+	int width;
+	int height;
+	GLenum internal_format;
+
+	bool operator==(TransientTextureDesc const& other) const;
+};
+
+// Index of a resource in the graph being declared
+typedef size_t FrameGraphResource;
+
+struct FrameGraphStats
+{
+	unsigned passes = 0u;
+	unsigned culled_passes = 0u;
+	unsigned resources = 0u;
+
+	// Textures the resources were aliased into, and
+	// how many of them the pool had to create
+	unsigned textures = 0u;
+	unsigned created_textures = 0u;
+	unsigned pooled_textures = 0u;
+
+	// A texture per resource, against the aliased ones
+	size_t declared_bytes = 0u;
+	size_t used_bytes = 0u;
+	size_t pooled_bytes = 0u;
+};
+
+/*
+ * Passes of a frame and the transient textures they read and write,
+ * declared again every frame. compile() then works out:
+ *
+ * - which passes run. Those whose writes nobody reads are culled, as
+ *   are the passes only they were reading from. Passes writing nothing
+ *   draw to the default framebuffer and always run;
+ * - the lifetime of each texture, from the pass writing it to its last
+ *   reader. Textures with the same description whose lifetimes don't
+ *   overlap share storage;
+ * - where the storage comes from. A pool keeps textures across frames,
+ *   so a steady frame allocates nothing and a resize only allocates
+ *   the new sizes.
+ *
+ * Pooled textures are bucketed by default: they're allocated with their
+ * sides rounded up to 2^n or 1.5 * 2^n, and a resource is rendered in
+ * the lower left corner of one. Resizing within a bucket then allocates
+ * nothing. Passes get a viewport of the resource size, but whoever
+ * samples a resource has to scale its texture coordinates and keep
+ * the filter from reading past the corner, see getUVScale().
+ *
+ * Framebuffers are cached per set of attachments. Textures are linear
+ * filtered and clamped to the edge.
+ */
+class FrameGraph
+{
+public:
+	/// Declaration
+	// Forgets the passes and resources. The pool is kept
+	void reset();
+
+	FrameGraphResource createTexture(std::string const& name, TransientTextureDesc const& desc);
+
+	// @execute runs with the framebuffer of the pass bound and the
+	// viewport set to the size of its writes
+	size_t addPass(std::string const& name, std::function<void()> const& execute);
+
+	// Runs with no framebuffer bound. @execute binds its writes as
+	// images and issues the barriers its readers need
+	size_t addComputePass(std::string const& name, std::function<void()> const& execute);
+
+	void read(size_t pass, FrameGraphResource resource);
+
+	// Color formats are attached in the order they're written, and
+	// depth formats to the depth attachment. Every resource is written
+	// by a single pass. Aborts otherwise
+	void write(size_t pass, FrameGraphResource resource);
+
+	// Kept until the end of the frame, along with the passes producing
+	// it, even if nothing reads it. For textures shown after the frame
+	void markOutput(FrameGraphResource resource);
+
+	/// Compilation and execution
+	// @gl forgets its bindings when pooled textures are freed
+	void compile(OpenGLContext& gl);
+
+	// @width and @height are the viewport of the default framebuffer
+	void execute(OpenGLContext& gl, int width, int height);
+
+	// Valid from compile() to the next reset()
+	GLuint getTexture(FrameGraphResource resource) const;
+	bool isCompiled() const;
+
+	// Maps texture coordinates of a resource to its corner of the
+	// texture. Coordinates scaled should be clamped to the maximum,
+	// half a texel inside the corner, for linear filtering
+	glm::vec2 getUVScale(FrameGraphResource resource) const;
+	glm::vec2 getUVMax(FrameGraphResource resource) const;
+
+	// Exact sizes when disabled, for comparison
+	void setBucketed(bool state);
+	bool isBucketed() const;
+
+	// The passes in order, the culled ones marked, and the texture
+	// each resource was stored in
+	std::string describe() const;
+
+	FrameGraphStats const& getStats() const;
+
+	// Frees the pool and the framebuffers
+	void destroy();
+
+private:
+	struct Resource
+	{
+		std::string name;
+		TransientTextureDesc desc;
+
+		size_t writer;
+		unsigned n_readers = 0u;
+		bool output = false;
+
+		// Range of passes it's alive for, and the pool entry storing it
+		size_t first_pass;
+		size_t last_pass;
+		size_t texture;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		std::function<void()> execute;
+
+		std::vector<FrameGraphResource> reads;
+		std::vector<FrameGraphResource> writes;
+
+		bool compute = false;
+		bool culled = false;
+	};
+
+	struct PooledTexture
+	{
+		// Size allocated
+		TransientTextureDesc desc;
+		Texture2D texture;
+
+		unsigned last_frame;
+
+		// Last pass of the resources stored in it, in this frame
+		size_t last_pass;
+		bool taken;
+	};
+
+	void cullPasses();
+	void computeLifetimes();
+	void allocateTextures();
+	void freeIdleTextures(OpenGLContext& gl);
+
+	Framebuffer* getFramebuffer(Pass const& pass);
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	bool compiled = false;
+
+	// Allocated sizes, which are the resource sizes when not bucketed
+	std::vector<PooledTexture> pool;
+	unsigned frame = 0u;
+	bool bucketed = true;
+
+	// Keyed by the attached texture names, depth last
+	std::map<std::vector<GLuint>, Framebuffer*> framebuffers;
+
+	FrameGraphStats stats;
+};
+
+#endif // FRAME_GRAPH_HPP
@@ -52,6 +52,27 @@ void Framebuffer::detachCubeMapTexture(GLenum attachment)
 	glNamedFramebufferTextureLayer(id, attachment, 0, 0, 0);
 }
 
+void Framebuffer::attachTextureLayer(
+	GLenum attachment,
+	Texture const& texture,
+	GLint mipmap_level,
+	GLint layer)
+{
+	glNamedFramebufferTextureLayer(id, attachment,
+		texture.getId(), mipmap_level, layer);
+}
+
+void Framebuffer::attachLayeredTexture(
+	GLenum attachment,
+	Texture const& texture,
+	GLint mipmap_level)
+{
+	// Without a layer parameter array and cube map
+	// textures are attached as a whole
+	glNamedFramebufferTexture(id, attachment,
+		texture.getId(), mipmap_level);
+}
+
 void Framebuffer::attachRenderbuffer(
 	GLenum attachment,
 	Renderbuffer const& renderbuffer)
@@ -33,6 +33,22 @@ public:
 
 	void detachCubeMapTexture(GLenum attachment);
 
+	// Attaches a single layer of an array texture
+	void attachTextureLayer(
+		GLenum attachment,
+		Texture const& texture,
+		GLint mipmap_level,
+		GLint layer);
+
+	// Attaches all layers of @texture at once (e.g. the six faces
+	// of a cube map). Primitives are routed to a layer by writing
+	// gl_Layer in a geometry shader. Every attachment of a layered
+	// framebuffer must be layered, so renderbuffers can't be mixed in
+	void attachLayeredTexture(
+		GLenum attachment,
+		Texture const& texture,
+		GLint mipmap_level);
+
 	void attachRenderbuffer(
 		GLenum attachment,
 		Renderbuffer const& renderbuffer);
@@ -0,0 +1,109 @@
+#include "gaussianKernel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+// Texels of the test signal outside of the kernel
+#define ERROR_SIGNAL_SAMPLES 64
+
+std::vector<float> gaussianWeights(int radius, float sigma)
+{
+	radius = std::max(radius, 0);
+
+	if (sigma <= 0.0f)
+	{
+		sigma = std::max(radius / 3.0f, 0.5f);
+	}
+
+	std::vector<float> weights(radius + 1);
+	float sum = 0.0f;
+
+	for (int i = 0; i <= radius; ++i)
+	{
+		weights[i] = std::exp(-0.5f * i * i / (sigma * sigma));
+
+		// Every weight but the center one is used on both sides
+		sum += i == 0 ? weights[i] : 2.0f * weights[i];
+	}
+
+	for (auto& it : weights)
+	{
+		it /= sum;
+	}
+
+	return weights;
+}
+
+LinearKernel linearSamplingKernel(std::vector<float> const& weights)
+{
+	LinearKernel kernel;
+
+	kernel.weights.push_back(weights[0]);
+	kernel.offsets.push_back(0.0f);
+
+	for (size_t i = 1u; i < weights.size(); i += 2u)
+	{
+		// An odd radius leaves the last tap alone
+		float weight_1 = weights[i];
+		float weight_2 = i + 1u < weights.size() ? weights[i + 1u] : 0.0f;
+
+		float weight = weight_1 + weight_2;
+
+		kernel.weights.push_back(weight);
+
+		// Tiny sigmas underflow the outer weights
+		kernel.offsets.push_back(weight > 0.0f ?
+			(i * weight_1 + (i + 1u) * weight_2) / weight : static_cast<float>(i));
+	}
+
+	return kernel;
+}
+
+float linearKernelError(std::vector<float> const& weights, LinearKernel const& kernel)
+{
+	int radius = static_cast<int>(weights.size()) - 1;
+
+	std::mt19937 generator(5u);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	// An apron on both sides, plus one texel for the interpolation
+	std::vector<float> signal(ERROR_SIGNAL_SAMPLES + 2 * radius + 2);
+
+	for (auto& it : signal)
+	{
+		it = unit(generator);
+	}
+
+	auto interpolate = [&signal](float x)
+	{
+		int left = static_cast<int>(std::floor(x));
+		float t = x - left;
+
+		return signal[left] * (1.0f - t) + signal[left + 1] * t;
+	};
+
+	float error = 0.0f;
+
+	for (int x = radius + 1; x < ERROR_SIGNAL_SAMPLES + radius + 1; ++x)
+	{
+		float reference = weights[0] * signal[x];
+
+		for (int i = 1; i <= radius; ++i)
+		{
+			reference += weights[i] * (signal[x + i] + signal[x - i]);
+		}
+
+		float linear = kernel.weights[0] * signal[x];
+
+		for (size_t i = 1u; i < kernel.weights.size(); ++i)
+		{
+			linear += kernel.weights[i] *
+				(interpolate(x + kernel.offsets[i]) + interpolate(x - kernel.offsets[i]));
+		}
+
+		error = std::max(error, std::abs(linear - reference));
+	}
+
+	return error;
+}
@@ -0,0 +1,39 @@
+#ifndef GAUSSIAN_KERNEL_HPP
+#define GAUSSIAN_KERNEL_HPP
+
+#include <vector>
+
+/*
+ * Weights of a separable Gaussian blur, generated on the CPU.
+ *
+ * The discrete kernel samples every texel within the radius. Bilinear
+ * filtering can fetch two neighbouring texels at once, weighted by
+ * where the sample falls between them, so the linear kernel merges
+ * each pair of taps into one at the offset that reproduces both
+ * weights. The center stays a single tap, so a radius of r takes
+ * 1 + (r + 1) / 2 fetches per side instead of 1 + r.
+ *
+ * Weights hold the center first and then one side, which is mirrored,
+ * and are normalized so that the whole kernel adds up to one.
+ */
+
+// @sigma <= 0 uses a third of @radius
+std::vector<float> gaussianWeights(int radius, float sigma);
+
+struct LinearKernel
+{
+	std::vector<float> weights;
+
+	// In texels. The first one, the center, is 0
+	std::vector<float> offsets;
+};
+
+LinearKernel linearSamplingKernel(std::vector<float> const& weights);
+
+// Largest difference between blurring a random signal with @weights
+// and with @kernel, sampling the signal with linear interpolation.
+// GPUs filter with a few bits of fractional precision, so they
+// differ from the reference a bit more than this
+float linearKernelError(std::vector<float> const& weights, LinearKernel const& kernel);
+
+#endif // GAUSSIAN_KERNEL_HPP
@@ -0,0 +1,259 @@
+#include "geometryArena.hpp"
+#include "glContext.hpp"
+
+#include <cassert>
+#include <iostream>
+#include <iterator>
+
+FreeListAllocator::FreeListAllocator(size_t size)
+	:
+	size{ size },
+	free_size{ size }
+{
+	blocks[0u] = size;
+}
+
+bool FreeListAllocator::allocate(size_t size, size_t alignment, size_t& offset)
+{
+	assert(size > 0u && alignment > 0u);
+
+	for (auto it = blocks.begin(); it != blocks.end(); ++it)
+	{
+		size_t block_offset = it->first;
+		size_t block_size = it->second;
+
+		size_t aligned = (block_offset + alignment - 1u) / alignment * alignment;
+		size_t padding = aligned - block_offset;
+
+		if (padding + size > block_size)
+		{
+			continue;
+		}
+
+		blocks.erase(it);
+
+		// The padding and the tail go back to the list
+		if (padding > 0u)
+		{
+			blocks[block_offset] = padding;
+		}
+
+		if (padding + size < block_size)
+		{
+			blocks[aligned + size] = block_size - padding - size;
+		}
+
+		free_size -= size;
+		offset = aligned;
+
+		return true;
+	}
+
+	return false;
+}
+
+void FreeListAllocator::release(size_t offset, size_t size)
+{
+	assert(offset + size <= this->size);
+
+	free_size += size;
+
+	auto next = blocks.lower_bound(offset);
+
+	assert((next == blocks.end() || offset + size <= next->first) &&
+		"Releasing a block that is already free");
+
+	// Merges with the following block
+	if (next != blocks.end() && offset + size == next->first)
+	{
+		size += next->second;
+		next = blocks.erase(next);
+	}
+
+	// Merges with the preceding block
+	if (next != blocks.begin())
+	{
+		auto previous = std::prev(next);
+
+		if (previous->first + previous->second == offset)
+		{
+			previous->second += size;
+			return;
+		}
+	}
+
+	blocks[offset] = size;
+}
+
+size_t FreeListAllocator::getSize() const
+{
+	return size;
+}
+
+size_t FreeListAllocator::getFree() const
+{
+	return free_size;
+}
+
+size_t FreeListAllocator::getLargestFree() const
+{
+	size_t largest = 0u;
+
+	for (auto& it : blocks)
+	{
+		largest = it.second > largest ? it.second : largest;
+	}
+
+	return largest;
+}
+
+size_t FreeListAllocator::getBlockCount() const
+{
+	return blocks.size();
+}
+
+GeometryArena::GeometryArena(size_t vertex_bytes, size_t n_indices)
+	:
+	vertices{ vertex_bytes },
+	indices{ n_indices }
+{
+	glCreateBuffers(1, &vbo_id);
+	glCreateBuffers(1, &ebo_id);
+
+	// Meshes are written with glNamedBufferSubData
+	glNamedBufferStorage(vbo_id, vertex_bytes, nullptr, GL_DYNAMIC_STORAGE_BIT);
+	glNamedBufferStorage(ebo_id, n_indices * sizeof(unsigned), nullptr,
+		GL_DYNAMIC_STORAGE_BIT);
+}
+
+void GeometryArena::destroy()
+{
+	glDeleteBuffers(1, &vbo_id);
+	glDeleteBuffers(1, &ebo_id);
+
+	vbo_id = 0u;
+	ebo_id = 0u;
+}
+
+bool GeometryArena::allocate(
+	GLsizei vertex_stride,
+	size_t n_vertices,
+	size_t n_indices,
+	GLint& base_vertex,
+	GLuint& first_index)
+{
+	size_t vertex_offset;
+	size_t index_offset;
+
+	if (!vertices.allocate(n_vertices * vertex_stride, vertex_stride, vertex_offset))
+	{
+		return false;
+	}
+
+	if (!indices.allocate(n_indices, 1u, index_offset))
+	{
+		vertices.release(vertex_offset, n_vertices * vertex_stride);
+		return false;
+	}
+
+	base_vertex = static_cast<GLint>(vertex_offset / vertex_stride);
+	first_index = static_cast<GLuint>(index_offset);
+
+	++meshes;
+
+	return true;
+}
+
+void GeometryArena::release(
+	GLsizei vertex_stride,
+	size_t n_vertices,
+	size_t n_indices,
+	GLint base_vertex,
+	GLuint first_index)
+{
+	vertices.release(static_cast<size_t>(base_vertex) * vertex_stride,
+		n_vertices * vertex_stride);
+	indices.release(first_index, n_indices);
+
+	--meshes;
+}
+
+void GeometryArena::release(DeviceMesh& mesh)
+{
+	assert(mesh.arena == this && "Mesh was not created from this arena");
+
+	release(mesh.vertex_stride, mesh.n_vertices,
+		mesh.n_indices, mesh.base_vertex, mesh.first_index);
+
+	mesh.arena = nullptr;
+}
+
+GLuint GeometryArena::getVertexBuffer() const
+{
+	return vbo_id;
+}
+
+GLuint GeometryArena::getIndexBuffer() const
+{
+	return ebo_id;
+}
+
+GeometryArenaStats GeometryArena::getStats() const
+{
+	GeometryArenaStats stats;
+
+	stats.vertex_bytes_used = vertices.getSize() - vertices.getFree();
+	stats.vertex_bytes_total = vertices.getSize();
+	stats.indices_used = indices.getSize() - indices.getFree();
+	stats.indices_total = indices.getSize();
+	stats.free_blocks = vertices.getBlockCount() + indices.getBlockCount();
+	stats.meshes = meshes;
+
+	return stats;
+}
+
+DeviceMesh OpenGLContext::createStaticGeometry(
+	GeometryArena& arena,
+	std::vector<BufferInfo<float>> const& f_buffers,
+	std::vector<BufferInfo<int>> const& i_buffers,
+	std::vector<unsigned> const& indices,
+	bool& success)
+{
+	DeviceMesh mesh;
+
+	VertexLayout layout;
+	std::vector<unsigned char> vertices;
+
+	if (!prepareStaticGeometry(f_buffers, i_buffers, indices, mesh, layout, vertices))
+	{
+		success = false;
+		return mesh;
+	}
+
+	if (!arena.allocate(layout.stride, mesh.n_vertices, mesh.n_indices,
+		mesh.base_vertex, mesh.first_index))
+	{
+		std::cerr << "ERROR: Geometry arena is full\n\n";
+
+		success = false;
+		return mesh;
+	}
+
+	mesh.arena = &arena;
+	mesh.vbo_id = arena.getVertexBuffer();
+	mesh.ebo_id = arena.getIndexBuffer();
+
+	glNamedBufferSubData(mesh.vbo_id,
+		static_cast<GLintptr>(mesh.base_vertex) * layout.stride,
+		vertices.size(), vertices.data());
+	glNamedBufferSubData(mesh.ebo_id,
+		mesh.first_index * sizeof(unsigned),
+		indices.size() * sizeof(unsigned), indices.data());
+
+	mesh.vao_id = getLayoutVAO(layout);
+	mesh.vertex_stride = layout.stride;
+
+	success = true;
+
+	return mesh;
+}
@@ -0,0 +1,112 @@
+#ifndef GEOMETRY_ARENA_HPP
+#define GEOMETRY_ARENA_HPP
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <map>
+
+struct DeviceMesh;
+
+/*
+ * First fit allocator over a range of @size units. Free blocks are
+ * kept sorted by offset, so released blocks merge with their free
+ * neighbours and the range doesn't fragment into unusable slivers.
+ */
+class FreeListAllocator
+{
+public:
+	FreeListAllocator(size_t size);
+
+	FreeListAllocator()
+	{}
+
+	virtual ~FreeListAllocator()
+	{}
+
+	// Finds @size units starting at a multiple of @alignment,
+	// which doesn't need to be a power of two. Returns false
+	// if no free block is large enough
+	bool allocate(size_t size, size_t alignment, size_t& offset);
+
+	void release(size_t offset, size_t size);
+
+	size_t getSize() const;
+	size_t getFree() const;
+	size_t getLargestFree() const;
+	size_t getBlockCount() const;
+
+private:
+	size_t size = 0u;
+	size_t free_size = 0u;
+
+	// Offset to size of each free block
+	std::map<size_t, size_t> blocks;
+};
+
+struct GeometryArenaStats
+{
+	size_t vertex_bytes_used;
+	size_t vertex_bytes_total;
+
+	size_t indices_used;
+	size_t indices_total;
+
+	size_t free_blocks;
+	unsigned meshes;
+};
+
+/*
+ * One vertex buffer and one index buffer shared by every static mesh.
+ * Vertices of a mesh start at a multiple of their stride, so meshes
+ * of the same layout are addressed with a base vertex from a single
+ * binding and can be drawn without touching the VAO in between.
+ */
+class GeometryArena
+{
+public:
+	GeometryArena(size_t vertex_bytes, size_t n_indices);
+
+	GeometryArena()
+	{}
+
+	virtual ~GeometryArena()
+	{}
+
+	void destroy();
+
+	// Reserves room for a mesh. Returns false if the arena is full
+	bool allocate(
+		GLsizei vertex_stride,
+		size_t n_vertices,
+		size_t n_indices,
+		GLint& base_vertex,
+		GLuint& first_index);
+
+	void release(
+		GLsizei vertex_stride,
+		size_t n_vertices,
+		size_t n_indices,
+		GLint base_vertex,
+		GLuint first_index);
+
+	// Returns the range of @mesh, created from this arena
+	// by OpenGLContext::createStaticGeometry
+	void release(DeviceMesh& mesh);
+
+	GLuint getVertexBuffer() const;
+	GLuint getIndexBuffer() const;
+
+	GeometryArenaStats getStats() const;
+
+private:
+	GLuint vbo_id = 0u;
+	GLuint ebo_id = 0u;
+
+	FreeListAllocator vertices;
+	FreeListAllocator indices;
+
+	unsigned meshes = 0u;
+};
+
+#endif // GEOMETRY_ARENA_HPP
@@ -1,7 +1,56 @@
 #include "glContext.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 
+// From KHR_parallel_shader_compile (the ARB version has the same value)
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+void addDefines(
+	std::vector<ShaderInfo>& shader_infos,
+	std::vector<std::string> const& defines)
+{
+	if (defines.empty())
+	{
+		return;
+	}
+
+	std::string block;
+
+	for (auto& it : defines)
+	{
+		block += "#define " + it + '\n';
+	}
+
+	for (auto& it : shader_infos)
+	{
+		size_t version = it.source.find("#version");
+		size_t insert_at = 0u;
+		size_t next_line = 1u;
+
+		if (version != std::string::npos)
+		{
+			insert_at = it.source.find('\n', version);
+			insert_at = insert_at == std::string::npos ?
+				it.source.size() : insert_at + 1u;
+
+			// Lines before the insertion point, the directive included
+			next_line += std::count(it.source.begin(),
+				it.source.begin() + insert_at, '\n');
+		}
+
+		it.source.insert(insert_at,
+			block + "#line " + std::to_string(next_line) + '\n');
+	}
+}
+
 bool OpenGLContext::checkErrors(std::string const& file, int line)
 {
 	GLenum error;
@@ -58,92 +107,666 @@ bool OpenGLContext::load(GLADloadproc loader)
 		<< "\nGLSL version:         " << glGetString(GL_SHADING_LANGUAGE_VERSION)
 		<< "\n\n";
 
-	return true;
-}
+	driver_id = std::string((char const*)glGetString(GL_VENDOR)) + '\n' +
+		(char const*)glGetString(GL_RENDERER) + '\n' +
+		(char const*)glGetString(GL_VERSION);
+
+	loadParallelShaderCompile(loader);
+	loadIndirectCount(loader);
+
+	GLint n_texture_units;
+	glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &n_texture_units);
+
+	current_textures.resize(n_texture_units);
+	invalidateState();
+
+	return true;
+}
+
+bool OpenGLContext::hasExtension(std::string const& name) const
+{
+	GLint n_extensions;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &n_extensions);
+
+	for (GLint i = 0; i < n_extensions; ++i)
+	{
+		if (name == (char const*)glGetStringi(GL_EXTENSIONS, i))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void OpenGLContext::loadParallelShaderCompile(GLADloadproc loader)
+{
+	parallel_shader_compile = false;
+
+	// glad is generated without extensions, so the entry point is loaded here
+	typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+	MaxShaderCompilerThreadsProc max_shader_compiler_threads = nullptr;
+
+	if (hasExtension("GL_KHR_parallel_shader_compile"))
+	{
+		max_shader_compiler_threads = (MaxShaderCompilerThreadsProc)
+			loader("glMaxShaderCompilerThreadsKHR");
+	}
+	else if (hasExtension("GL_ARB_parallel_shader_compile"))
+	{
+		max_shader_compiler_threads = (MaxShaderCompilerThreadsProc)
+			loader("glMaxShaderCompilerThreadsARB");
+	}
+
+	if (max_shader_compiler_threads)
+	{
+		// Lets the driver pick as many threads as it wants
+		max_shader_compiler_threads(0xFFFFFFFFu);
+		parallel_shader_compile = true;
+	}
+
+	std::cout << "Parallel shader compile: "
+		<< (parallel_shader_compile ? "yes" : "no") << "\n\n";
+}
+
+void OpenGLContext::loadIndirectCount(GLADloadproc loader)
+{
+	multi_draw_elements_indirect_count = nullptr;
+
+	// Core since 4.6, which glad wasn't generated for
+	if (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 6))
+	{
+		multi_draw_elements_indirect_count = (MultiDrawElementsIndirectCountProc)
+			loader("glMultiDrawElementsIndirectCount");
+	}
+
+	if (!multi_draw_elements_indirect_count && hasExtension("GL_ARB_indirect_parameters"))
+	{
+		multi_draw_elements_indirect_count = (MultiDrawElementsIndirectCountProc)
+			loader("glMultiDrawElementsIndirectCountARB");
+	}
+
+	std::cout << "Indirect count: "
+		<< (multi_draw_elements_indirect_count ? "yes" : "no") << "\n\n";
+}
+
+void OpenGLContext::enable(GLenum capability)
+{
+	auto it = capabilities.find(capability);
+
+	if (stateChanged(it == capabilities.end() || !it->second))
+	{
+		glEnable(capability);
+		capabilities[capability] = true;
+	}
+}
+
+void OpenGLContext::disable(GLenum capability)
+{
+	auto it = capabilities.find(capability);
+
+	if (stateChanged(it == capabilities.end() || it->second))
+	{
+		glDisable(capability);
+		capabilities[capability] = false;
+	}
+}
+
+void OpenGLContext::useProgram(GLuint program)
+{
+	if (stateChanged(current_program != program))
+	{
+		glUseProgram(program);
+		current_program = program;
+	}
+}
+
+void OpenGLContext::bindVertexArray(GLuint vao)
+{
+	if (stateChanged(current_vao != vao))
+	{
+		glBindVertexArray(vao);
+		current_vao = vao;
+	}
+}
+
+void OpenGLContext::bindTextureUnit(GLuint unit, GLuint texture)
+{
+	assert(unit < current_textures.size() && "Texture unit out of range");
+
+	if (stateChanged(current_textures[unit] != texture))
+	{
+		glBindTextureUnit(unit, texture);
+		current_textures[unit] = texture;
+	}
+}
+
+void OpenGLContext::bindFramebuffer(GLuint framebuffer)
+{
+	if (stateChanged(current_framebuffer != framebuffer))
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		current_framebuffer = framebuffer;
+	}
+}
+
+void OpenGLContext::depthFunc(GLenum func)
+{
+	if (stateChanged(current_depth_func != func))
+	{
+		glDepthFunc(func);
+		current_depth_func = func;
+	}
+}
+
+void OpenGLContext::setUniform(GLuint program, GLint location, int value)
+{
+	if (uniformChanged(program, location, &value, sizeof(value)))
+	{
+		glProgramUniform1i(program, location, value);
+	}
+}
+
+void OpenGLContext::setUniform(GLuint program, GLint location, float value)
+{
+	if (uniformChanged(program, location, &value, sizeof(value)))
+	{
+		glProgramUniform1f(program, location, value);
+	}
+}
+
+void OpenGLContext::setUniform(
+	GLuint program,
+	GLint location,
+	glm::vec2 const& value)
+{
+	if (uniformChanged(program, location, &value, sizeof(value)))
+	{
+		glProgramUniform2fv(program, location, 1, glm::value_ptr(value));
+	}
+}
+
+void OpenGLContext::setUniform(
+	GLuint program,
+	GLint location,
+	glm::vec3 const& value)
+{
+	if (uniformChanged(program, location, &value, sizeof(value)))
+	{
+		glProgramUniform3fv(program, location, 1, glm::value_ptr(value));
+	}
+}
+
+void OpenGLContext::setUniform(
+	GLuint program,
+	GLint location,
+	glm::mat3 const& value)
+{
+	if (uniformChanged(program, location, &value, sizeof(value)))
+	{
+		glProgramUniformMatrix3fv(program, location,
+			1, GL_FALSE, glm::value_ptr(value));
+	}
+}
+
+void OpenGLContext::setUniform(
+	GLuint program,
+	GLint location,
+	glm::mat4 const& value)
+{
+	if (uniformChanged(program, location, &value, sizeof(value)))
+	{
+		glProgramUniformMatrix4fv(program, location,
+			1, GL_FALSE, glm::value_ptr(value));
+	}
+}
+
+void OpenGLContext::setUniform(
+	GLuint program,
+	GLint location,
+	GLsizei count,
+	float const* values)
+{
+	if (uniformChanged(program, location, values, count * sizeof(float)))
+	{
+		glProgramUniform1fv(program, location, count, values);
+	}
+}
+
+void OpenGLContext::deleteProgram(GLuint program)
+{
+	uniforms.erase(program);
+
+	if (last_uniform_program == program)
+	{
+		last_uniforms = nullptr;
+	}
+
+	if (current_program == program)
+	{
+		current_program = unknown;
+	}
+
+	glDeleteProgram(program);
+}
+
+void OpenGLContext::invalidateState()
+{
+	current_program = unknown;
+	current_vao = unknown;
+	current_framebuffer = unknown;
+	current_depth_func = GL_NONE;
+
+	std::fill(current_textures.begin(), current_textures.end(), unknown);
+
+	capabilities.clear();
+
+	for (auto& it : layout_vaos)
+	{
+		it.vbo_id = unknown;
+		it.ebo_id = unknown;
+		it.instance_vbo_id = unknown;
+	}
+}
+
+void OpenGLContext::setStateCacheEnabled(bool state)
+{
+	state_cache_enabled = state;
+
+	invalidateState();
+
+	uniforms.clear();
+	last_uniforms = nullptr;
+}
+
+bool OpenGLContext::isStateCacheEnabled() const
+{
+	return state_cache_enabled;
+}
+
+StateCacheCounters const& OpenGLContext::getCounters() const
+{
+	return counters;
+}
+
+void OpenGLContext::resetCounters()
+{
+	counters = StateCacheCounters();
+}
+
+bool OpenGLContext::stateChanged(bool changed)
+{
+	if (changed || !state_cache_enabled)
+	{
+		++counters.issued;
+		return true;
+	}
+
+	++counters.skipped;
+	return false;
+}
+
+bool OpenGLContext::uniformChanged(
+	GLuint program,
+	GLint location,
+	void const* data,
+	size_t size)
+{
+	// Setting location -1 is silently ignored by GL
+	if (location == -1)
+	{
+		return false;
+	}
+
+	if (!last_uniforms || last_uniform_program != program)
+	{
+		last_uniform_program = program;
+		last_uniforms = &uniforms[program];
+	}
+
+	if (size_t(location) >= last_uniforms->size())
+	{
+		last_uniforms->resize(location + 1);
+	}
+
+	CachedUniform& value = (*last_uniforms)[location];
+
+	if (size > sizeof(value.data))
+	{
+		value.size = 0u;
+		return stateChanged(true);
+	}
+
+	bool changed = value.size != size ||
+		std::memcmp(value.data, data, size) != 0;
+
+	if (changed)
+	{
+		std::memcpy(value.data, data, size);
+		value.size = size;
+	}
+
+	return stateChanged(changed);
+}
+
+GLuint OpenGLContext::createProgram(
+	std::vector<ShaderInfo>& shader_infos,
+	bool& success)
+{
+	return finishProgram(submitProgram(shader_infos), success);
+}
+
+size_t OpenGLContext::submitProgram(std::vector<ShaderInfo> const& shader_infos)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	PendingProgram pending;
+	pending.program_id = 0u;
+	pending.from_cache = false;
+
+	if (!program_cache_directory.empty())
+	{
+		pending.cache_path = programCachePath(shader_infos);
+		pending.program_id = loadProgramBinary(pending.cache_path);
+		pending.from_cache = pending.program_id != 0u;
+	}
+
+	if (!pending.from_cache)
+	{
+		// Nothing is queried here, so the driver is free to
+		// compile and link in the background
+		pending.program_id = glCreateProgram();
+
+		for (auto& it : shader_infos)
+		{
+			GLuint shader_id = glCreateShader(it.type);
+			GLchar const* source_c_str = it.source.c_str();
+			glShaderSource(shader_id, 1, &source_c_str, nullptr);
+			glCompileShader(shader_id);
+
+			glAttachShader(pending.program_id, shader_id);
+
+			pending.shader_ids.emplace_back(shader_id);
+			pending.shader_types.emplace_back(it.type);
+		}
+
+		if (!pending.cache_path.empty())
+		{
+			glProgramParameteri(pending.program_id,
+				GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+
+		glLinkProgram(pending.program_id);
+	}
+
+	size_t build;
+
+	if (free_builds.empty())
+	{
+		build = pending_programs.size();
+		pending_programs.emplace_back(pending);
+	}
+	else
+	{
+		build = free_builds.back();
+		free_builds.pop_back();
+
+		pending_programs[build] = pending;
+	}
+
+	std::chrono::duration<double, std::milli> elapsed =
+		std::chrono::steady_clock::now() - start;
+
+	program_cache_stats.milliseconds += elapsed.count();
+
+	return build;
+}
+
+bool OpenGLContext::isProgramReady(size_t build) const
+{
+	assert(build < pending_programs.size() && "Invalid program build");
+
+	PendingProgram const& pending = pending_programs[build];
+
+	assert(pending.program_id != 0u && "Program build already finished");
+
+	if (pending.from_cache || !parallel_shader_compile)
+	{
+		return true;
+	}
+
+	GLint completed;
+	glGetProgramiv(pending.program_id, GL_COMPLETION_STATUS_KHR, &completed);
+
+	return completed == GL_TRUE;
+}
+
+GLuint OpenGLContext::finishProgram(size_t build, bool& success)
+{
+	assert(build < pending_programs.size() && "Invalid program build");
+
+	auto start = std::chrono::steady_clock::now();
+
+	PendingProgram& pending = pending_programs[build];
+	GLuint program_id = pending.program_id;
+
+	assert(program_id != 0u && "Program build already finished");
+
+	pending.program_id = 0u;
+
+	if (pending.from_cache)
+	{
+		++program_cache_stats.hits;
+		success = true;
+	}
+	else
+	{
+		if (!pending.cache_path.empty())
+		{
+			++program_cache_stats.misses;
+		}
+
+		success = true;
+
+		for (size_t i = 0u; i < pending.shader_ids.size() && success; ++i)
+		{
+			success = checkShader(pending.shader_ids[i], pending.shader_types[i]);
+		}
+
+		if (success)
+		{
+			success = checkProgram(program_id);
+		}
+
+		for (GLuint shader_id : pending.shader_ids)
+		{
+			glDetachShader(program_id, shader_id);
+			glDeleteShader(shader_id);
+		}
+
+		if (!success)
+		{
+			glDeleteProgram(program_id);
+			program_id = 0u;
+		}
+		else if (!pending.cache_path.empty())
+		{
+			saveProgramBinary(program_id, pending.cache_path);
+		}
+	}
+
+	pending.shader_ids.clear();
+	pending.shader_types.clear();
+	pending.cache_path.clear();
+
+	free_builds.push_back(build);
+
+	std::chrono::duration<double, std::milli> elapsed =
+		std::chrono::steady_clock::now() - start;
+
+	program_cache_stats.milliseconds += elapsed.count();
+
+	return program_id;
+}
+
+bool OpenGLContext::hasParallelShaderCompile() const
+{
+	return parallel_shader_compile;
+}
+
+void OpenGLContext::setProgramCache(std::string const& directory)
+{
+	program_cache_directory.clear();
+
+	if (directory.empty())
+	{
+		return;
+	}
+
+	GLint n_formats;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats);
+
+	if (n_formats == 0)
+	{
+		std::cerr << "WARNING: The driver doesn't support program "
+			"binaries, the program cache is disabled\n";
+
+		return;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+
+	if (error)
+	{
+		std::cerr << "WARNING: Could not create " << directory
+			<< ", the program cache is disabled\n";
+
+		return;
+	}
+
+	program_cache_directory = directory;
+}
+
+ProgramCacheStats const& OpenGLContext::getProgramCacheStats() const
+{
+	return program_cache_stats;
+}
+
+// 64 bit FNV-1a
+static uint64_t hashBytes(uint64_t hash, void const* data, size_t size)
+{
+	unsigned char const* bytes = (unsigned char const*)data;
+
+	for (size_t i = 0u; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+std::string OpenGLContext::programCachePath(
+	std::vector<ShaderInfo> const& shader_infos) const
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+
+	hash = hashBytes(hash, driver_id.data(), driver_id.size());
+
+	for (auto& it : shader_infos)
+	{
+		hash = hashBytes(hash, &it.type, sizeof(it.type));
+		hash = hashBytes(hash, it.source.data(), it.source.size());
+	}
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
 
-void OpenGLContext::enable(GLenum capability)
-{
-	glEnable(capability);
+	return program_cache_directory + '/' + name;
 }
 
-void OpenGLContext::disable(GLenum capability)
+struct ProgramBinaryHeader
 {
-	glDisable(capability);
-}
+	char magic[8];
+	GLenum format;
+	GLint length;
+};
 
-GLuint OpenGLContext::createProgram(
-	std::vector<ShaderInfo>& shader_infos,
-	bool& success) const
+GLuint OpenGLContext::loadProgramBinary(std::string const& path) const
 {
-	success = false;
-	GLuint program_id;
-	std::vector<GLuint> shader_ids;
-	bool compiled;
+	std::ifstream in(path, std::ios::binary);
 
-	for (size_t i = 0u; i < shader_infos.size(); ++i)
+	if (!in)
 	{
-		GLuint shader_id = compileShader(shader_infos[i], compiled);
+		return 0u;
+	}
 
-		if (compiled)
-		{
-			shader_ids.emplace_back(shader_id);
-		}
-		else
-		{
-			break;
-		}
+	ProgramBinaryHeader header;
+	in.read((char*)&header, sizeof(header));
+
+	if (!in || std::memcmp(header.magic, "PROGBIN1", 8) != 0 ||
+		header.length <= 0)
+	{
+		return 0u;
 	}
 
-	if (compiled)
+	std::vector<char> binary(header.length);
+	in.read(binary.data(), binary.size());
+
+	if (!in)
 	{
-		program_id = glCreateProgram();
+		return 0u;
+	}
 
-		for (size_t i = 0u; i < shader_ids.size(); ++i)
-		{
-			glAttachShader(program_id, shader_ids[i]);
-		}
+	GLuint program_id = glCreateProgram();
+	glProgramBinary(program_id, header.format, binary.data(), header.length);
 
-		glLinkProgram(program_id);
+	// Drivers reject binaries from other versions by failing the link
+	GLint linked;
+	glGetProgramiv(program_id, GL_LINK_STATUS, &linked);
 
-		GLint linked;
-		glGetProgramiv(program_id, GL_LINK_STATUS, &linked);
+	if (linked == GL_FALSE)
+	{
+		glDeleteProgram(program_id);
+		return 0u;
+	}
 
-		if (linked == GL_FALSE)
-		{
-			GLsizei log_length;
-			glGetProgramiv(program_id, GL_INFO_LOG_LENGTH, &log_length);
+	return program_id;
+}
 
-			std::vector<char> log(log_length);
-			glGetProgramInfoLog(program_id, log_length, nullptr, log.data());
+void OpenGLContext::saveProgramBinary(
+	GLuint program_id,
+	std::string const& path) const
+{
+	ProgramBinaryHeader header;
+	std::memcpy(header.magic, "PROGBIN1", 8);
 
-			std::string log_str(log.begin(), log.end());
-			std::cerr << "Program linkage failed:\n" << log_str << "\n\n";
+	glGetProgramiv(program_id, GL_PROGRAM_BINARY_LENGTH, &header.length);
 
-			return 0u;
-		}
-		else
-		{
-			success = true;
-		}
+	if (header.length <= 0)
+	{
+		return;
 	}
 
-	for (size_t i = 0u; i < shader_ids.size(); ++i)
+	std::vector<char> binary(header.length);
+	glGetProgramBinary(program_id, header.length,
+		nullptr, &header.format, binary.data());
+
+	std::ofstream out(path, std::ios::binary);
+
+	if (!out)
 	{
-		glDeleteShader(shader_ids[i]);
+		std::cerr << "WARNING: Could not write " << path << '\n';
+		return;
 	}
 
-	return program_id;
+	out.write((char const*)&header, sizeof(header));
+	out.write(binary.data(), binary.size());
 }
 
-GLuint OpenGLContext::compileShader(
-	ShaderInfo& shader_info,
-	bool& success) const
+bool OpenGLContext::checkShader(GLuint shader_id, GLenum type) const
 {
-	GLuint shader_id = glCreateShader(shader_info.type);
-	GLchar* source_c_str = (GLchar*)shader_info.source.c_str();
-	glShaderSource(shader_id, 1, &source_c_str, nullptr);
-	glCompileShader(shader_id);
-
 	GLint compiled;
 	glGetShaderiv(shader_id, GL_COMPILE_STATUS, &compiled);
 
@@ -157,7 +780,7 @@ GLuint OpenGLContext::compileShader(
 
 		std::string log_str(log.begin(), log.end());
 
-		switch (shader_info.type)
+		switch (type)
 		{
 			case GL_VERTEX_SHADER:
 				std::cerr << "Vertex ";
@@ -186,14 +809,32 @@ GLuint OpenGLContext::compileShader(
 
 		std::cerr << "shader compilation failed:\n" << log_str << "\n\n";
 
-		success = false;
-
-		return 0u;
+		return false;
 	}
 
-	success = true;
+	return true;
+}
+
+bool OpenGLContext::checkProgram(GLuint program_id) const
+{
+	GLint linked;
+	glGetProgramiv(program_id, GL_LINK_STATUS, &linked);
+
+	if (linked == GL_FALSE)
+	{
+		GLsizei log_length;
+		glGetProgramiv(program_id, GL_INFO_LOG_LENGTH, &log_length);
+
+		std::vector<char> log(log_length);
+		glGetProgramInfoLog(program_id, log_length, nullptr, log.data());
 
-	return shader_id;
+		std::string log_str(log.begin(), log.end());
+		std::cerr << "Program linkage failed:\n" << log_str << "\n\n";
+
+		return false;
+	}
+
+	return true;
 }
 
 template <typename T>
@@ -336,8 +977,25 @@ DeviceMesh OpenGLContext::createPackedStaticGeometry(
 	return mesh;
 }
 
-void OpenGLContext::destroyGeometry(DeviceMesh& mesh) const
+void OpenGLContext::destroyGeometry(DeviceMesh& mesh)
 {
+	assert(!mesh.arena && "Arena meshes are released by their arena");
+
+	// A deleted name can be handed out again, so forget
+	// the attachments of the shared VAOs that used it
+	for (auto& it : layout_vaos)
+	{
+		if (it.vbo_id == mesh.vbo_id)
+		{
+			it.vbo_id = unknown;
+		}
+
+		if (it.ebo_id == mesh.ebo_id)
+		{
+			it.ebo_id = unknown;
+		}
+	}
+
 	if (glIsBuffer(mesh.ebo_id))
 	{
 		glDeleteBuffers(1, &mesh.ebo_id);
@@ -348,9 +1006,393 @@ void OpenGLContext::destroyGeometry(DeviceMesh& mesh) const
 		glDeleteBuffers(1, &mesh.vbo_id);
 	}
 
-	if (glIsVertexArray(mesh.vao_id))
+	if (!mesh.shared_vao && glIsVertexArray(mesh.vao_id))
 	{
 		glDeleteVertexArrays(1, &mesh.vao_id);
 	}
 }
 
+bool VertexAttribute::operator==(VertexAttribute const& other) const
+{
+	return
+		location == other.location &&
+		n_components == other.n_components &&
+		type == other.type &&
+		offset == other.offset &&
+		binding == other.binding;
+}
+
+bool VertexLayout::operator==(VertexLayout const& other) const
+{
+	return
+		stride == other.stride &&
+		instance_stride == other.instance_stride &&
+		attributes == other.attributes;
+}
+
+GLuint OpenGLContext::getLayoutVAO(VertexLayout const& layout)
+{
+	// There are only a handful of layouts, a linear search will do
+	for (auto& it : layout_vaos)
+	{
+		if (it.layout == layout)
+		{
+			return it.vao_id;
+		}
+	}
+
+	GLuint vao_id;
+	glCreateVertexArrays(1, &vao_id);
+
+	for (auto& it : layout.attributes)
+	{
+		if (it.type == GL_INT)
+		{
+			glVertexArrayAttribIFormat(vao_id, it.location,
+				it.n_components, GL_INT, it.offset);
+		}
+		else
+		{
+			glVertexArrayAttribFormat(vao_id, it.location,
+				it.n_components, it.type, GL_FALSE, it.offset);
+		}
+
+		glVertexArrayAttribBinding(vao_id, it.location, it.binding);
+		glEnableVertexArrayAttrib(vao_id, it.location);
+	}
+
+	if (layout.instance_stride > 0)
+	{
+		glVertexArrayBindingDivisor(vao_id, INSTANCE_BINDING, 1u);
+	}
+
+	layout_vaos.emplace_back(LayoutVAO{ layout, vao_id, unknown, unknown, unknown });
+
+	return vao_id;
+}
+
+static GLint fixedAttributeLocation(std::string const& name)
+{
+	if (name == "a_pos") return ATTRIBUTE_POSITION;
+	if (name == "a_nor") return ATTRIBUTE_NORMAL;
+	if (name == "a_tex") return ATTRIBUTE_TEXCOORD;
+	if (name == "a_tan") return ATTRIBUTE_TANGENT;
+
+	return -1;
+}
+
+template <typename T>
+bool appendAttributes(
+	GLenum type,
+	std::vector<BufferInfo<T>> const& buffers,
+	VertexLayout& layout)
+{
+	for (auto& it : buffers)
+	{
+		GLint location = fixedAttributeLocation(it.attribute_name);
+
+		if (location == -1)
+		{
+			std::cerr << "ERROR: " << it.attribute_name
+				<< " has no fixed attribute location\n\n";
+
+			return false;
+		}
+
+		layout.attributes.emplace_back(VertexAttribute{
+			static_cast<GLuint>(location),
+			static_cast<GLint>(it.n_components),
+			type,
+			static_cast<GLuint>(layout.stride) });
+
+		layout.stride += static_cast<GLsizei>(it.n_components * sizeof(T));
+	}
+
+	return true;
+}
+
+template <typename T>
+void interleaveAttributes(
+	std::vector<BufferInfo<T>> const& buffers,
+	size_t n_vertices,
+	size_t stride,
+	size_t& byte_offset,
+	std::vector<unsigned char>& vertices)
+{
+	for (auto& it : buffers)
+	{
+		size_t size = it.n_components * sizeof(T);
+
+		for (size_t i = 0u; i < n_vertices; ++i)
+		{
+			std::memcpy(vertices.data() + i * stride + byte_offset,
+				it.values.data() + i * it.n_components, size);
+		}
+
+		byte_offset += size;
+	}
+}
+
+Bounds computeBounds(std::vector<float> const& positions)
+{
+	Bounds bounds;
+
+	if (positions.size() < 3u)
+	{
+		return bounds;
+	}
+
+	bounds.min = glm::vec3(positions[0], positions[1], positions[2]);
+	bounds.max = bounds.min;
+
+	for (size_t i = 3u; i + 2u < positions.size(); i += 3u)
+	{
+		glm::vec3 position(positions[i], positions[i + 1u], positions[i + 2u]);
+
+		bounds.min = glm::min(bounds.min, position);
+		bounds.max = glm::max(bounds.max, position);
+	}
+
+	bounds.center = 0.5f * (bounds.min + bounds.max);
+
+	float radius_2 = 0.0f;
+
+	for (size_t i = 0u; i + 2u < positions.size(); i += 3u)
+	{
+		glm::vec3 offset =
+			glm::vec3(positions[i], positions[i + 1u], positions[i + 2u]) - bounds.center;
+
+		radius_2 = glm::max(radius_2, glm::dot(offset, offset));
+	}
+
+	bounds.radius = std::sqrt(radius_2);
+
+	return bounds;
+}
+
+// Bounds of the a_pos buffer, if there is one
+static Bounds meshBounds(std::vector<BufferInfo<float>> const& f_buffers)
+{
+	for (auto& it : f_buffers)
+	{
+		if (it.attribute_name == "a_pos" && it.n_components == 3u)
+		{
+			return computeBounds(it.values);
+		}
+	}
+
+	return Bounds();
+}
+
+// Builds the layout of the buffers and interleaves them into @vertices
+static bool interleaveMesh(
+	std::vector<BufferInfo<float>> const& f_buffers,
+	std::vector<BufferInfo<int>> const& i_buffers,
+	VertexLayout& layout,
+	std::vector<unsigned char>& vertices,
+	size_t& n_vertices)
+{
+	assert(f_buffers.size() + i_buffers.size() >= 1u &&
+		"At least one buffer must be passed");
+
+	if (!appendAttributes(GL_FLOAT, f_buffers, layout) ||
+		!appendAttributes(GL_INT, i_buffers, layout))
+	{
+		return false;
+	}
+
+	n_vertices = f_buffers.empty() ?
+		i_buffers[0].values.size() / i_buffers[0].n_components :
+		f_buffers[0].values.size() / f_buffers[0].n_components;
+
+	vertices.resize(n_vertices * layout.stride);
+	size_t byte_offset = 0u;
+
+	interleaveAttributes(f_buffers, n_vertices, layout.stride, byte_offset, vertices);
+	interleaveAttributes(i_buffers, n_vertices, layout.stride, byte_offset, vertices);
+
+	return true;
+}
+
+bool OpenGLContext::prepareStaticGeometry(
+	std::vector<BufferInfo<float>> const& f_buffers,
+	std::vector<BufferInfo<int>> const& i_buffers,
+	std::vector<unsigned> const& indices,
+	DeviceMesh& mesh,
+	VertexLayout& layout,
+	std::vector<unsigned char>& vertices)
+{
+	mesh.n_indices = indices.size();
+	mesh.shared_vao = true;
+	mesh.bounds = meshBounds(f_buffers);
+
+	return interleaveMesh(f_buffers, i_buffers, layout, vertices, mesh.n_vertices);
+}
+
+DeviceMesh OpenGLContext::createStaticGeometry(
+	std::vector<BufferInfo<float>> const& f_buffers,
+	std::vector<BufferInfo<int>> const& i_buffers,
+	std::vector<unsigned> const& indices,
+	bool& success)
+{
+	DeviceMesh mesh;
+
+	VertexLayout layout;
+	std::vector<unsigned char> vertices;
+
+	// Interleaved on the CPU and uploaded in one go
+	if (!prepareStaticGeometry(f_buffers, i_buffers, indices, mesh, layout, vertices))
+	{
+		success = false;
+		return mesh;
+	}
+
+	glCreateBuffers(1, &mesh.vbo_id);
+	glCreateBuffers(1, &mesh.ebo_id);
+
+	glNamedBufferStorage(mesh.vbo_id, vertices.size(), vertices.data(), 0);
+	glNamedBufferStorage(mesh.ebo_id, indices.size() * sizeof(unsigned),
+		indices.data(), 0);
+
+	mesh.vao_id = getLayoutVAO(layout);
+	mesh.vertex_stride = layout.stride;
+
+	success = true;
+
+	return mesh;
+}
+
+void OpenGLContext::bindMesh(DeviceMesh const& mesh)
+{
+	bindVertexArray(mesh.vao_id);
+
+	if (!mesh.shared_vao)
+	{
+		return;
+	}
+
+	auto it = std::find_if(layout_vaos.begin(), layout_vaos.end(),
+		[&mesh](LayoutVAO const& layout_vao)
+		{
+			return layout_vao.vao_id == mesh.vao_id;
+		});
+
+	assert(it != layout_vaos.end() && "Mesh layout was destroyed");
+
+	if (stateChanged(it->vbo_id != mesh.vbo_id))
+	{
+		glVertexArrayVertexBuffer(it->vao_id, 0u, mesh.vbo_id, 0, mesh.vertex_stride);
+		it->vbo_id = mesh.vbo_id;
+	}
+
+	if (stateChanged(it->ebo_id != mesh.ebo_id))
+	{
+		glVertexArrayElementBuffer(it->vao_id, mesh.ebo_id);
+		it->ebo_id = mesh.ebo_id;
+	}
+
+	if (mesh.instance_stride > 0 &&
+		stateChanged(it->instance_vbo_id != mesh.instance_vbo_id))
+	{
+		glVertexArrayVertexBuffer(it->vao_id, INSTANCE_BINDING,
+			mesh.instance_vbo_id, 0, mesh.instance_stride);
+		it->instance_vbo_id = mesh.instance_vbo_id;
+	}
+}
+
+void OpenGLContext::setInstanceStream(
+	DeviceMesh& mesh,
+	std::vector<VertexAttribute> const& attributes,
+	GLsizei stride,
+	GLuint buffer_id)
+{
+	assert(mesh.shared_vao && "Only meshes with a registered layout");
+
+	auto it = std::find_if(layout_vaos.begin(), layout_vaos.end(),
+		[&mesh](LayoutVAO const& layout_vao)
+		{
+			return layout_vao.vao_id == mesh.vao_id;
+		});
+
+	assert(it != layout_vaos.end() && "Mesh layout was destroyed");
+
+	// Starts from the vertex attributes only, in case
+	// the mesh already had another instance stream
+	VertexLayout layout;
+	layout.stride = it->layout.stride;
+	layout.instance_stride = stride;
+
+	for (auto& attribute : it->layout.attributes)
+	{
+		if (attribute.binding == VERTEX_BINDING)
+		{
+			layout.attributes.push_back(attribute);
+		}
+	}
+
+	for (auto& attribute : attributes)
+	{
+		assert(attribute.binding == INSTANCE_BINDING);
+		layout.attributes.push_back(attribute);
+	}
+
+	// May reallocate layout_vaos, so @it isn't used after this
+	mesh.vao_id = getLayoutVAO(layout);
+	mesh.instance_vbo_id = buffer_id;
+	mesh.instance_stride = stride;
+}
+
+void OpenGLContext::drawMesh(DeviceMesh const& mesh) const
+{
+	glDrawElementsBaseVertex(GL_TRIANGLES,
+		static_cast<GLsizei>(mesh.n_indices), GL_UNSIGNED_INT,
+		reinterpret_cast<void const*>(mesh.first_index * sizeof(unsigned)),
+		mesh.base_vertex);
+}
+
+void OpenGLContext::drawMeshInstanced(
+	DeviceMesh const& mesh,
+	GLsizei n_instances,
+	GLuint first_instance) const
+{
+	glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES,
+		static_cast<GLsizei>(mesh.n_indices), GL_UNSIGNED_INT,
+		reinterpret_cast<void const*>(mesh.first_index * sizeof(unsigned)),
+		n_instances, mesh.base_vertex, first_instance);
+}
+
+size_t OpenGLContext::getLayoutCount() const
+{
+	return layout_vaos.size();
+}
+
+void OpenGLContext::destroyVertexLayouts()
+{
+	for (auto& it : layout_vaos)
+	{
+		glDeleteVertexArrays(1, &it.vao_id);
+	}
+
+	layout_vaos.clear();
+
+	current_vao = unknown;
+}
+
+bool OpenGLContext::hasIndirectCount() const
+{
+	return multi_draw_elements_indirect_count != nullptr;
+}
+
+void OpenGLContext::multiDrawElementsIndirectCount(
+	GLenum mode,
+	GLenum type,
+	GLintptr indirect,
+	GLintptr draw_count,
+	GLsizei max_draw_count,
+	GLsizei stride) const
+{
+	assert(multi_draw_elements_indirect_count && "Indirect count is not supported");
+
+	multi_draw_elements_indirect_count(mode, type,
+		reinterpret_cast<void const*>(indirect), draw_count, max_draw_count, stride);
+}
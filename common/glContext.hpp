@@ -9,14 +9,24 @@
 
 #include <cassert>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+class GeometryArena;
+
 struct ShaderInfo
 {
 	GLenum type;
 	std::string source;
 };
 
+// Inserts a "#define" line for each of @defines right after the
+// #version directive of every stage. A #line directive follows
+// them, so compile errors still point at the lines of the files
+void addDefines(
+	std::vector<ShaderInfo>& shader_infos,
+	std::vector<std::string> const& defines);
+
 template <typename T>
 struct BufferInfo
 {
@@ -25,6 +35,62 @@ struct BufferInfo
 	std::vector<T> values;
 };
 
+// Locations given to the attributes by name in createStaticGeometry.
+// Shaders declare them with layout (location = N)
+enum AttributeLocation : GLuint
+{
+	ATTRIBUTE_POSITION = 0u, // a_pos
+	ATTRIBUTE_NORMAL = 1u, // a_nor
+	ATTRIBUTE_TEXCOORD = 2u, // a_tex
+	ATTRIBUTE_TANGENT = 3u, // a_tan
+
+	// Per instance. A matrix takes one location per column
+	ATTRIBUTE_INSTANCE_MODEL = 4u, // a_model_matrix
+	ATTRIBUTE_INSTANCE_MATERIAL = 8u // a_material
+};
+
+// Vertex attributes are read from binding point 0. Instance
+// attributes from binding point 1, advanced once per instance
+#define VERTEX_BINDING 0u
+#define INSTANCE_BINDING 1u
+
+struct VertexAttribute
+{
+	GLuint location;
+	GLint n_components;
+	GLenum type; // GL_FLOAT or GL_INT
+	GLuint offset;
+	GLuint binding = VERTEX_BINDING;
+
+	bool operator==(VertexAttribute const& other) const;
+};
+
+// Format of an interleaved vertex, plus the format of
+// the instance stream if the mesh has one
+struct VertexLayout
+{
+	std::vector<VertexAttribute> attributes;
+	GLsizei stride = 0;
+	GLsizei instance_stride = 0;
+
+	bool operator==(VertexLayout const& other) const;
+};
+
+// Object space bounds of a mesh. The sphere is centered on the box
+// and just encloses the vertices, so it's usually tighter than the
+// sphere around the box
+struct Bounds
+{
+	glm::vec3 min = glm::vec3(0.0f);
+	glm::vec3 max = glm::vec3(0.0f);
+
+	glm::vec3 center = glm::vec3(0.0f);
+	float radius = 0.0f;
+};
+
+// @positions are packed xyz triplets
+Bounds computeBounds(std::vector<float> const& positions);
+
 struct DeviceMesh
 {
 	/// Handles
@@ -34,6 +100,59 @@ struct DeviceMesh
 
 	/// Properties
 	size_t n_indices;
+
+	// Computed from a_pos by createStaticGeometry
+	Bounds bounds;
+
+	// Meshes created by createStaticGeometry share the VAO of their
+	// layout, which is owned by the context. Bind them with bindMesh
+	bool shared_vao = false;
+	GLsizei vertex_stride = 0;
+
+	// Set by setInstanceStream
+	GLuint instance_vbo_id = 0u;
+	GLsizei instance_stride = 0;
+
+	/// Arena allocation
+	// Where the mesh starts in the (possibly shared) buffers
+	GLint base_vertex = 0;
+	GLuint first_index = 0u;
+
+	GeometryArena* arena = nullptr;
+	size_t n_vertices = 0u;
+};
+
+// From ARB_indirect_parameters (core in 4.6 with the same value)
+#ifndef GL_PARAMETER_BUFFER
+#define GL_PARAMETER_BUFFER 0x80EE
+#endif
+
+// Command layout read from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instance_count;
+	GLuint first_index;
+	GLint base_vertex;
+	GLuint base_instance;
+};
+
+struct ProgramCacheStats
+{
+	unsigned hits = 0u;
+	unsigned misses = 0u;
+
+	// Time spent inside the program creation calls. Compilation
+	// running in the background while the caller does something
+	// else isn't counted
+	double milliseconds = 0.0;
+};
+
+// Calls that went through the state cache since the last reset
+struct StateCacheCounters
+{
+	unsigned issued = 0u;
+	unsigned skipped = 0u;
 };
 
 class OpenGLContext
@@ -52,12 +171,77 @@ public:
 
 	bool load(GLADloadproc loader);
 
+	/// State cache
+	// These wrappers shadow the bound state and drop calls that wouldn't
+	// change it. State changed behind their back (e.g. Texture::bind,
+	// Framebuffer::bind or raw gl calls) leaves the shadow stale, so
+	// call invalidateState() after such code. Deleting a bound object
+	// also unbinds it, so invalidate after deleting textures or buffers
 	void enable(GLenum capability);
 	void disable(GLenum capability);
 
+	void useProgram(GLuint program);
+	void bindVertexArray(GLuint vao);
+	void bindTextureUnit(GLuint unit, GLuint texture);
+	void bindFramebuffer(GLuint framebuffer);
+	void depthFunc(GLenum func);
+
+	// Uniforms are set with glProgramUniform*, so @program
+	// doesn't need to be bound. Values are compared per
+	// (program, location) against the last ones set
+	void setUniform(GLuint program, GLint location, int value);
+	void setUniform(GLuint program, GLint location, float value);
+	void setUniform(GLuint program, GLint location, glm::vec2 const& value);
+	void setUniform(GLuint program, GLint location, glm::vec3 const& value);
+	void setUniform(GLuint program, GLint location, glm::mat3 const& value);
+	void setUniform(GLuint program, GLint location, glm::mat4 const& value);
+	void setUniform(GLuint program, GLint location, GLsizei count, float const* values);
+
+	// Deletes @program and forgets its cached uniforms
+	void deleteProgram(GLuint program);
+
+	void invalidateState();
+
+	// Disabling the cache issues every call, for comparison
+	void setStateCacheEnabled(bool state);
+	bool isStateCacheEnabled() const;
+
+	StateCacheCounters const& getCounters() const;
+	void resetCounters();
+
+	// Looks the program up in the program cache, if enabled,
+	// and compiles and links it from source on a miss
 	GLuint createProgram(
 		std::vector<ShaderInfo>& shader_infos,
-		bool& success) const;
+		bool& success);
+
+	/// Batched program creation
+	// submitProgram issues the compile and link commands without
+	// checking their status, so several programs can be compiled by
+	// the driver in the background (in parallel when
+	// KHR_parallel_shader_compile is available) while the caller does
+	// other work. Returns a build handle for finishProgram
+	size_t submitProgram(std::vector<ShaderInfo> const& shader_infos);
+
+	// Whether finishProgram(@build) would return without waiting.
+	// Without parallel compile support this is always true, although
+	// the driver may still block when the status is checked
+	bool isProgramReady(size_t build) const;
+
+	// Checks the status of a submitted program, printing the logs on
+	// failure, and returns its id. Each build can be finished once,
+	// after which its handle is reused by later submissions
+	GLuint finishProgram(size_t build, bool& success);
+
+	bool hasParallelShaderCompile() const;
+	bool hasExtension(std::string const& name) const;
+
+	// Stores linked program binaries in @directory, keyed on a hash
+	// of the shader sources and the driver vendor, renderer and
+	// version. Binaries the driver rejects are rebuilt from source.
+	// An empty @directory disables the cache
+	void setProgramCache(std::string const& directory);
+	ProgramCacheStats const& getProgramCacheStats() const;
 
 	// - Each buffer should have the same number of
 	// vertices (values.size() / n_components)
@@ -69,10 +253,176 @@ public:
 		std::vector<unsigned> const& indices,
 		bool& success) const;
 
-	void destroyGeometry(DeviceMesh& mesh) const;
+	// Meshes from an arena are returned with GeometryArena::release
+	void destroyGeometry(DeviceMesh& mesh);
+
+	/// Vertex layouts
+	// Returns the VAO holding the attribute formats of @layout,
+	// creating it the first time the layout is seen. Meshes with
+	// the same layout share it and only swap their buffers in
+	GLuint getLayoutVAO(VertexLayout const& layout);
+
+	// Interleaves the buffers into one vertex buffer and describes
+	// them with a shared layout. Attributes are placed at their
+	// AttributeLocation, found from the attribute names
+	DeviceMesh createStaticGeometry(
+		std::vector<BufferInfo<float>> const& f_buffers,
+		std::vector<BufferInfo<int>> const& i_buffers,
+		std::vector<unsigned> const& indices,
+		bool& success);
+
+	// Same, but the mesh is sub-allocated from @arena and shares its
+	// buffers. Fails if the arena is full. Defined in geometryArena.cpp,
+	// so only the demos using an arena link against it
+	DeviceMesh createStaticGeometry(
+		GeometryArena& arena,
+		std::vector<BufferInfo<float>> const& f_buffers,
+		std::vector<BufferInfo<int>> const& i_buffers,
+		std::vector<unsigned> const& indices,
+		bool& success);
+
+	// Binds the VAO of @mesh's layout and attaches its buffers,
+	// skipping the calls that wouldn't change anything
+	void bindMesh(DeviceMesh const& mesh);
+
+	// Switches @mesh to a layout that also reads @attributes per
+	// instance from @buffer_id, whose elements are @stride bytes apart.
+	// Attributes must use binding INSTANCE_BINDING. Meshes sharing
+	// the vertex and instance formats still share a VAO
+	void setInstanceStream(
+		DeviceMesh& mesh,
+		std::vector<VertexAttribute> const& attributes,
+		GLsizei stride,
+		GLuint buffer_id);
+
+	// Draws the triangles of @mesh, which must be bound,
+	// from its first index and base vertex
+	void drawMesh(DeviceMesh const& mesh) const;
+
+	// Draws @n_instances of @mesh, reading the instance stream
+	// from element @first_instance onwards
+	void drawMeshInstanced(
+		DeviceMesh const& mesh,
+		GLsizei n_instances,
+		GLuint first_instance = 0u) const;
+
+	size_t getLayoutCount() const;
+
+	// Deletes the shared VAOs. Their meshes must not be drawn after
+	void destroyVertexLayouts();
+
+	/// Indirect count
+	// glMultiDrawElementsIndirectCount from GL 4.6, or its
+	// ARB_indirect_parameters version. The draw count is read at
+	// byte @draw_count of the buffer bound to GL_PARAMETER_BUFFER
+	bool hasIndirectCount() const;
+
+	void multiDrawElementsIndirectCount(
+		GLenum mode,
+		GLenum type,
+		GLintptr indirect,
+		GLintptr draw_count,
+		GLsizei max_draw_count,
+		GLsizei stride) const;
 
 private:
-	GLuint compileShader(ShaderInfo& shader_info, bool& success) const;
+	// Interleaves the buffers of a static mesh and fills in its
+	// counts and bounds. Shared by both createStaticGeometry
+	static bool prepareStaticGeometry(
+		std::vector<BufferInfo<float>> const& f_buffers,
+		std::vector<BufferInfo<int>> const& i_buffers,
+		std::vector<unsigned> const& indices,
+		DeviceMesh& mesh,
+		VertexLayout& layout,
+		std::vector<unsigned char>& vertices);
+
+	void loadParallelShaderCompile(GLADloadproc loader);
+	void loadIndirectCount(GLADloadproc loader);
+
+	bool checkShader(GLuint shader_id, GLenum type) const;
+	bool checkProgram(GLuint program_id) const;
+
+	std::string programCachePath(
+		std::vector<ShaderInfo> const& shader_infos) const;
+
+	// Returns 0 if there's no usable binary at @path
+	GLuint loadProgramBinary(std::string const& path) const;
+	void saveProgramBinary(GLuint program_id, std::string const& path) const;
+
+	/// Program builds
+	struct PendingProgram
+	{
+		GLuint program_id;
+
+		std::vector<GLuint> shader_ids;
+		std::vector<GLenum> shader_types;
+
+		std::string cache_path;
+		bool from_cache;
+	};
+
+	std::vector<PendingProgram> pending_programs;
+	std::vector<size_t> free_builds; // Finished, to be reused
+	bool parallel_shader_compile = false;
+
+	/// Indirect count
+	typedef void (APIENTRYP MultiDrawElementsIndirectCountProc)(
+		GLenum mode, GLenum type, void const* indirect,
+		GLintptr draw_count, GLsizei max_draw_count, GLsizei stride);
+
+	MultiDrawElementsIndirectCountProc multi_draw_elements_indirect_count = nullptr;
+
+	/// Program cache
+	std::string program_cache_directory;
+	std::string driver_id;
+	ProgramCacheStats program_cache_stats;
+
+	// Updates the counters and returns whether the call must be issued
+	bool stateChanged(bool changed);
+	bool uniformChanged(GLuint program, GLint location,
+		void const* data, size_t size);
+
+	/// State cache
+	// Marks a binding whose current value isn't known
+	static constexpr GLuint unknown = ~0u;
+
+	bool state_cache_enabled = true;
+	StateCacheCounters counters;
+
+	GLuint current_program = unknown;
+	GLuint current_vao = unknown;
+	GLuint current_framebuffer = unknown;
+	GLenum current_depth_func = GL_NONE;
+	std::vector<GLuint> current_textures;
+	std::unordered_map<GLenum, bool> capabilities;
+
+	// Last value set to a uniform location, stored inline. Values
+	// larger than a mat4, like long arrays, are always issued
+	struct CachedUniform
+	{
+		unsigned char data[64];
+		size_t size = 0u;
+	};
+
+	// Indexed by location, per program. The uniforms of the
+	// program last set are kept to skip the lookup
+	std::unordered_map<GLuint, std::vector<CachedUniform>> uniforms;
+	GLuint last_uniform_program = 0u;
+	std::vector<CachedUniform>* last_uniforms = nullptr;
+
+	/// Vertex layouts
+	struct LayoutVAO
+	{
+		VertexLayout layout;
+		GLuint vao_id;
+
+		// Buffers attached to the VAO, or unknown
+		GLuint vbo_id;
+		GLuint ebo_id;
+		GLuint instance_vbo_id;
+	};
+
+	std::vector<LayoutVAO> layout_vaos;
 };
 
 #endif // GL_CONTEXT_HPP
@@ -0,0 +1,62 @@
+#include "gpuTimer.hpp"
+
+void GPUTimer::destroy()
+{
+	if (queries[0])
+	{
+		glDeleteQueries(2, queries);
+	}
+
+	queries[0] = queries[1] = 0u;
+	pending[0] = pending[1] = false;
+	timing = false;
+}
+
+void GPUTimer::begin()
+{
+	if (!queries[0])
+	{
+		glCreateQueries(GL_TIME_ELAPSED, 2, queries);
+	}
+
+	unsigned query = next % 2u;
+
+	if (pending[query])
+	{
+		GLint available = 0;
+		glGetQueryObjectiv(queries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+
+		if (!available)
+		{
+			timing = false;
+			return;
+		}
+
+		GLuint64 elapsed_time;
+		glGetQueryObjectui64v(queries[query], GL_QUERY_RESULT, &elapsed_time);
+
+		milliseconds = elapsed_time / 1000000.0;
+		pending[query] = false;
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, queries[query]);
+
+	pending[query] = true;
+	timing = true;
+
+	++next;
+}
+
+void GPUTimer::end()
+{
+	if (timing)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		timing = false;
+	}
+}
+
+double GPUTimer::getMilliseconds() const
+{
+	return milliseconds;
+}
@@ -0,0 +1,44 @@
+#ifndef GPU_TIMER_HPP
+#define GPU_TIMER_HPP
+
+#include <glad/glad.h>
+
+/*
+ * Measures GPU time with two GL_TIME_ELAPSED queries used in turns.
+ * A query is reused only once its result is available, and the work
+ * goes untimed until then, so reading a result never makes the CPU
+ * wait for the GPU. The queries are created on first use. Timers
+ * can't overlap, as only one GL_TIME_ELAPSED query runs at a time
+ */
+class GPUTimer
+{
+public:
+	GPUTimer()
+	{}
+
+	virtual ~GPUTimer()
+	{}
+
+	void destroy();
+
+	// Reads the result of the next query if there's one and starts it
+	// again. When the result isn't available yet nothing is started
+	void begin();
+
+	// Ends the query started by begin(), if any
+	void end();
+
+	// The latest result read, 0 until there's one
+	double getMilliseconds() const;
+
+private:
+	GLuint queries[2] = {};
+	bool pending[2] = {};
+
+	unsigned next = 0u;
+	bool timing = false;
+
+	double milliseconds = 0.0;
+};
+
+#endif // GPU_TIMER_HPP
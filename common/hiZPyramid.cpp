@@ -0,0 +1,306 @@
+#include "hiZPyramid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+HiZPyramid::HiZPyramid(int width, int height)
+	:
+	texture{ width, height, GL_R32F, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE,
+		GL_NEAREST_MIPMAP_NEAREST, GL_NEAREST },
+	levels{ 1 + static_cast<int>(std::floor(std::log2(std::max(width, height)))) }
+{}
+
+bool isOccluded(
+	HiZReadback const& readback,
+	glm::vec3 const& center,
+	glm::vec3 const& extent)
+{
+	if (readback.depths.empty())
+	{
+		return false;
+	}
+
+	glm::vec2 uv_min(1.0f);
+	glm::vec2 uv_max(0.0f);
+	float nearest = 1.0f;
+
+	for (int i = 0; i < 8; ++i)
+	{
+		glm::vec3 corner = center + extent * glm::vec3(
+			(i & 1) ? 1.0f : -1.0f,
+			(i & 2) ? 1.0f : -1.0f,
+			(i & 4) ? 1.0f : -1.0f);
+
+		glm::vec4 clip = readback.pv_matrix * glm::vec4(corner, 1.0f);
+
+		if (clip.w <= 0.0f)
+		{
+			return false;
+		}
+
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+
+		uv_min = glm::min(uv_min, glm::vec2(ndc) * 0.5f + 0.5f);
+		uv_max = glm::max(uv_max, glm::vec2(ndc) * 0.5f + 0.5f);
+		nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+	}
+
+	uv_min = glm::clamp(uv_min, 0.0f, 1.0f);
+	uv_max = glm::clamp(uv_max, 0.0f, 1.0f);
+
+	// Texel x of the level covers texels [x * 2^level, (x + 1) * 2^level)
+	// of level 0, and the last one also what odd sizes folded into it
+	int first_x = std::min(static_cast<int>(uv_min.x * readback.base_width) >> readback.level,
+		readback.width - 1);
+	int first_y = std::min(static_cast<int>(uv_min.y * readback.base_height) >> readback.level,
+		readback.height - 1);
+	int last_x = std::min(static_cast<int>(uv_max.x * readback.base_width) >> readback.level,
+		readback.width - 1);
+	int last_y = std::min(static_cast<int>(uv_max.y * readback.base_height) >> readback.level,
+		readback.height - 1);
+
+	for (int y = first_y; y <= last_y; ++y)
+	{
+		for (int x = first_x; x <= last_x; ++x)
+		{
+			if (nearest <= readback.depths[y * readback.width + x])
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void HiZPyramid::destroy()
+{
+	texture.destroy();
+	levels = 0;
+
+	glDeleteFramebuffers(1, &framebuffer_id);
+	glDeleteVertexArrays(1, &empty_vao_id);
+
+	framebuffer_id = 0u;
+	empty_vao_id = 0u;
+
+	for (auto& it : readbacks)
+	{
+		glDeleteBuffers(1, &it.buffer_id);
+
+		if (it.fence)
+		{
+			glDeleteSync(it.fence);
+		}
+
+		it = PendingReadback();
+	}
+
+	next_request = 0u;
+	next_fetch = 0u;
+}
+
+void HiZPyramid::build(
+	OpenGLContext& gl,
+	ProgramReflection const& program,
+	Texture const& depth)
+{
+	GLuint program_id = program.getId();
+	GLint u_level_loc = program.uniform("u_level");
+	GLint u_source_size_loc = program.uniform("u_source_size");
+
+	gl.useProgram(program_id);
+	gl.bindTextureUnit(0u, depth.getId());
+
+	int source_width = depth.getWidth();
+	int source_height = depth.getHeight();
+
+	for (int level = 0; level < levels; ++level)
+	{
+		int width = std::max(1, texture.getWidth() >> level);
+		int height = std::max(1, texture.getHeight() >> level);
+
+		if (level > 0)
+		{
+			glBindImageTexture(0u, texture.getId(), level - 1,
+				GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		}
+
+		glBindImageTexture(1u, texture.getId(), level,
+			GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+		gl.setUniform(program_id, u_level_loc, level);
+		glProgramUniform2i(program_id, u_source_size_loc, source_width, source_height);
+
+		glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+
+		// The next level reads this one
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+		source_width = width;
+		source_height = height;
+	}
+
+	// Culling samples the pyramid as a texture, and the readback
+	// copies its levels out with glGetTextureImage
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+}
+
+void HiZPyramid::buildWithFragments(
+	OpenGLContext& gl,
+	ProgramReflection const& program,
+	Texture const& depth)
+{
+	if (!framebuffer_id)
+	{
+		glCreateFramebuffers(1, &framebuffer_id);
+
+		// Core profiles draw only with a vertex array bound
+		glCreateVertexArrays(1, &empty_vao_id);
+	}
+
+	GLuint program_id = program.getId();
+	GLint u_level_loc = program.uniform("u_level");
+	GLint u_source_size_loc = program.uniform("u_source_size");
+	GLint u_target_size_loc = program.uniform("u_target_size");
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	gl.useProgram(program_id);
+	gl.bindFramebuffer(framebuffer_id);
+	gl.bindVertexArray(empty_vao_id);
+	gl.bindTextureUnit(0u, depth.getId());
+
+	int source_width = depth.getWidth();
+	int source_height = depth.getHeight();
+
+	for (int level = 0; level < levels; ++level)
+	{
+		int width = std::max(1, texture.getWidth() >> level);
+		int height = std::max(1, texture.getHeight() >> level);
+
+		if (level > 0)
+		{
+			glTextureParameteri(texture.getId(), GL_TEXTURE_BASE_LEVEL, level - 1);
+			glTextureParameteri(texture.getId(), GL_TEXTURE_MAX_LEVEL, level - 1);
+
+			gl.bindTextureUnit(1u, texture.getId());
+		}
+		else
+		{
+			gl.bindTextureUnit(1u, 0u);
+		}
+
+		glNamedFramebufferTexture(framebuffer_id, GL_COLOR_ATTACHMENT0, texture.getId(), level);
+		glViewport(0, 0, width, height);
+
+		gl.setUniform(program_id, u_level_loc, level);
+		glProgramUniform2i(program_id, u_source_size_loc, source_width, source_height);
+		glProgramUniform2i(program_id, u_target_size_loc, width, height);
+
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+
+		source_width = width;
+		source_height = height;
+	}
+
+	glTextureParameteri(texture.getId(), GL_TEXTURE_BASE_LEVEL, 0);
+	glTextureParameteri(texture.getId(), GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+bool HiZPyramid::requestReadback(int level, glm::mat4 const& pv_matrix)
+{
+	if (next_request - next_fetch >= HIZ_READBACK_SLOTS)
+	{
+		return false;
+	}
+
+	PendingReadback& slot = readbacks[next_request % HIZ_READBACK_SLOTS];
+
+	int width = std::max(1, texture.getWidth() >> level);
+	int height = std::max(1, texture.getHeight() >> level);
+	GLsizeiptr size = width * height * sizeof(float);
+
+	if (slot.size < size)
+	{
+		glDeleteBuffers(1, &slot.buffer_id);
+
+		glCreateBuffers(1, &slot.buffer_id);
+		glNamedBufferStorage(slot.buffer_id, size, nullptr, GL_CLIENT_STORAGE_BIT);
+
+		slot.size = size;
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer_id);
+	glGetTextureImage(texture.getId(), level, GL_RED, GL_FLOAT,
+		static_cast<GLsizei>(size), nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.level = level;
+	slot.pv_matrix = pv_matrix;
+
+	++next_request;
+
+	return true;
+}
+
+bool HiZPyramid::fetchReadback(HiZReadback& readback)
+{
+	if (next_fetch == next_request)
+	{
+		return false;
+	}
+
+	PendingReadback& slot = readbacks[next_fetch % HIZ_READBACK_SLOTS];
+
+	// Polls without waiting. The flush makes sure the fence gets signaled
+	GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+	{
+		return false;
+	}
+
+	glDeleteSync(slot.fence);
+	slot.fence = nullptr;
+
+	readback.level = slot.level;
+	readback.width = std::max(1, texture.getWidth() >> slot.level);
+	readback.height = std::max(1, texture.getHeight() >> slot.level);
+	readback.base_width = texture.getWidth();
+	readback.base_height = texture.getHeight();
+	readback.pv_matrix = slot.pv_matrix;
+
+	readback.depths.resize(static_cast<size_t>(readback.width) * readback.height);
+
+	glGetNamedBufferSubData(slot.buffer_id, 0,
+		readback.depths.size() * sizeof(float), readback.depths.data());
+
+	++next_fetch;
+
+	return true;
+}
+
+Texture2D const& HiZPyramid::getTexture() const
+{
+	return texture;
+}
+
+int HiZPyramid::getWidth() const
+{
+	return texture.getWidth();
+}
+
+int HiZPyramid::getHeight() const
+{
+	return texture.getHeight();
+}
+
+int HiZPyramid::getLevels() const
+{
+	return levels;
+}
@@ -0,0 +1,115 @@
+#ifndef HI_Z_PYRAMID_HPP
+#define HI_Z_PYRAMID_HPP
+
+#include "glContext.hpp"
+#include "programReflection.hpp"
+#include "texture.hpp"
+
+#include <vector>
+
+// Copies to the CPU that can be in flight at once
+#define HIZ_READBACK_SLOTS 3
+
+// A level of the pyramid read back to the CPU
+struct HiZReadback
+{
+	int level = 0;
+
+	// Size of the level and of level 0
+	int width = 0;
+	int height = 0;
+	int base_width = 0;
+	int base_height = 0;
+
+	// Matrix the depth was drawn with
+	glm::mat4 pv_matrix;
+
+	// Row by row, bottom to top
+	std::vector<float> depths;
+};
+
+// Whether the box is behind the depths of @readback. Boxes
+// crossing the near plane are never considered occluded
+bool isOccluded(
+	HiZReadback const& readback,
+	glm::vec3 const& center,
+	glm::vec3 const& extent);
+
+/*
+ * Mip chain of a depth buffer where each texel keeps the farthest
+ * depth under its footprint. A box whose nearest depth is farther
+ * than the texels covering its screen rectangle is hidden behind
+ * what was drawn. Level 0 has the size of the depth buffer and
+ * odd sizes fold their last row and column into the level above
+ */
+class HiZPyramid
+{
+public:
+	HiZPyramid(int width, int height);
+
+	HiZPyramid()
+	{}
+
+	virtual ~HiZPyramid()
+	{}
+
+	void destroy();
+
+	// Reduces @depth with @program, a compute shader with 8x8 groups
+	// that reads level u_level - 1 from image unit 0 (@depth from
+	// texture unit 0 for level 0) and writes u_level to image unit 1
+	void build(
+		OpenGLContext& gl,
+		ProgramReflection const& program,
+		Texture const& depth);
+
+	// Same, drawing a full screen triangle into each level. @program
+	// also takes u_target_size, and reads level u_level - 1 from
+	// texture unit 1, restricted to it so that the level being drawn
+	// isn't sampled. Depth testing must be disabled
+	void buildWithFragments(
+		OpenGLContext& gl,
+		ProgramReflection const& program,
+		Texture const& depth);
+
+	/// CPU readback
+	// Copies @level to a pixel buffer without waiting for the GPU.
+	// Returns false if HIZ_READBACK_SLOTS copies are still pending
+	bool requestReadback(int level, glm::mat4 const& pv_matrix);
+
+	// Takes the oldest copy if the GPU is done with it
+	bool fetchReadback(HiZReadback& readback);
+
+	Texture2D const& getTexture() const;
+
+	int getWidth() const;
+	int getHeight() const;
+	int getLevels() const;
+
+private:
+	Texture2D texture;
+
+	int levels = 0;
+
+	// Created on the first fragment build
+	GLuint framebuffer_id = 0u;
+	GLuint empty_vao_id = 0u;
+
+	struct PendingReadback
+	{
+		GLuint buffer_id = 0u;
+		GLsizeiptr size = 0;
+		GLsync fence = nullptr;
+
+		int level;
+		glm::mat4 pv_matrix;
+	};
+
+	PendingReadback readbacks[HIZ_READBACK_SLOTS];
+
+	// Slots in flight are [next_fetch, next_request)
+	unsigned next_request = 0u;
+	unsigned next_fetch = 0u;
+};
+
+#endif // HI_Z_PYRAMID_HPP
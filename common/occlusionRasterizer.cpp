@@ -0,0 +1,538 @@
+#include "occlusionRasterizer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// AVX2 code is compiled for its own functions and only called when
+// the CPU has it, so the rest of the program doesn't require it
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OCCLUSION_AVX2
+#include <immintrin.h>
+#endif
+
+// Vertices closer to the eye plane than this drop their triangle
+#define OCCLUSION_MIN_W 0.0001f
+
+// Coverage of the tile with lower left pixel (@x, @y), a bit per
+// pixel, row by row. Pixels are sampled at their centers
+static uint32_t coverageScalar(
+	float const* edge_a,
+	float const* edge_b,
+	float const* edge_c,
+	float x,
+	float y)
+{
+	uint32_t mask = 0u;
+
+	for (int row = 0; row < OCCLUSION_TILE_HEIGHT; ++row)
+	{
+		float pixel_y = y + row + 0.5f;
+
+		for (int column = 0; column < OCCLUSION_TILE_WIDTH; ++column)
+		{
+			float pixel_x = x + column + 0.5f;
+			bool inside = true;
+
+			for (int i = 0; i < 3; ++i)
+			{
+				inside &= edge_a[i] * pixel_x + edge_b[i] * pixel_y + edge_c[i] >= 0.0f;
+			}
+
+			mask |= static_cast<uint32_t>(inside) << (row * OCCLUSION_TILE_WIDTH + column);
+		}
+	}
+
+	return mask;
+}
+
+#ifdef OCCLUSION_AVX2
+// A row of the tile per instruction
+__attribute__((target("avx2")))
+static uint32_t coverageAVX2(
+	float const* edge_a,
+	float const* edge_b,
+	float const* edge_c,
+	float x,
+	float y)
+{
+	__m256 pixel_x = _mm256_add_ps(_mm256_set1_ps(x),
+		_mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f));
+
+	// The x term is the same for every row
+	__m256 edge_x[3];
+
+	for (int i = 0; i < 3; ++i)
+	{
+		edge_x[i] = _mm256_mul_ps(_mm256_set1_ps(edge_a[i]), pixel_x);
+	}
+
+	uint32_t mask = 0u;
+
+	for (int row = 0; row < OCCLUSION_TILE_HEIGHT; ++row)
+	{
+		float pixel_y = y + row + 0.5f;
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+		for (int i = 0; i < 3; ++i)
+		{
+			__m256 edge = _mm256_add_ps(edge_x[i],
+				_mm256_set1_ps(edge_b[i] * pixel_y + edge_c[i]));
+
+			inside = _mm256_and_ps(inside,
+				_mm256_cmp_ps(edge, _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+
+		mask |= static_cast<uint32_t>(_mm256_movemask_ps(inside)) << (row * OCCLUSION_TILE_WIDTH);
+	}
+
+	return mask;
+}
+#endif
+
+OcclusionRasterizer::OcclusionRasterizer(int width, int height, unsigned n_threads)
+	:
+	width{ width },
+	height{ height },
+	tiles_x{ (width + OCCLUSION_TILE_WIDTH - 1) / OCCLUSION_TILE_WIDTH },
+	tiles_y{ (height + OCCLUSION_TILE_HEIGHT - 1) / OCCLUSION_TILE_HEIGHT },
+	coverage{ coverageScalar }
+{
+#ifdef OCCLUSION_AVX2
+	if (__builtin_cpu_supports("avx2"))
+	{
+		coverage = coverageAVX2;
+		avx2 = true;
+	}
+#endif
+
+	if (n_threads == 0u)
+	{
+		n_threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// Each thread needs a row of tiles at least
+	n_threads = std::min(n_threads, static_cast<unsigned>(tiles_y));
+
+	z_max0.resize(tiles_x * tiles_y);
+	z_max1.resize(tiles_x * tiles_y);
+	masks.resize(tiles_x * tiles_y);
+
+	clear();
+
+	thread_triangles.resize(n_threads);
+	active_threads = n_threads;
+
+	for (unsigned i = 1u; i < n_threads; ++i)
+	{
+		workers.emplace_back(&OcclusionRasterizer::worker, this, i);
+	}
+}
+
+void OcclusionRasterizer::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+
+	start_condition.notify_all();
+
+	for (auto& it : workers)
+	{
+		it.join();
+	}
+
+	workers.clear();
+}
+
+void OcclusionRasterizer::clear()
+{
+	std::fill(z_max0.begin(), z_max0.end(), 1.0f);
+	std::fill(z_max1.begin(), z_max1.end(), 0.0f);
+	std::fill(masks.begin(), masks.end(), 0u);
+}
+
+void OcclusionRasterizer::render(
+	std::vector<Occluder> const& occluders,
+	glm::mat4 const& pv_matrix)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	this->pv_matrix = pv_matrix;
+
+	unsigned n_threads = active_threads;
+
+	// Every triangle must be set up before any band is rasterized
+	run([&](unsigned thread)
+	{
+		setupTriangles(occluders,
+			occluders.size() * thread / n_threads,
+			occluders.size() * (thread + 1u) / n_threads,
+			thread_triangles[thread]);
+	});
+
+	run([&](unsigned thread)
+	{
+		rasterizeBand(tiles_y * thread / n_threads, tiles_y * (thread + 1u) / n_threads);
+	});
+
+	auto end = std::chrono::high_resolution_clock::now();
+
+	stats.triangles = 0u;
+
+	for (unsigned i = 0u; i < n_threads; ++i)
+	{
+		stats.triangles += static_cast<unsigned>(thread_triangles[i].size());
+	}
+
+	stats.threads = n_threads;
+	stats.render_ms = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void OcclusionRasterizer::setupTriangles(
+	std::vector<Occluder> const& occluders,
+	size_t first,
+	size_t last,
+	std::vector<ScreenTriangle>& triangles) const
+{
+	triangles.clear();
+
+	std::vector<glm::vec4> clip;
+
+	for (size_t i = first; i < last; ++i)
+	{
+		OccluderMesh const& mesh = *occluders[i].mesh;
+		glm::mat4 matrix = pv_matrix * occluders[i].model_matrix;
+
+		// Vertices are shared between triangles, so they're transformed first
+		clip.resize(mesh.positions.size() / 3u);
+
+		for (size_t j = 0u; j < clip.size(); ++j)
+		{
+			clip[j] = matrix * glm::vec4(mesh.positions[3u * j],
+				mesh.positions[3u * j + 1u], mesh.positions[3u * j + 2u], 1.0f);
+		}
+
+		for (size_t j = 0u; j + 2u < mesh.indices.size(); j += 3u)
+		{
+			float x[3], y[3], z[3];
+			bool behind = false;
+
+			for (int k = 0; k < 3; ++k)
+			{
+				glm::vec4 const& vertex = clip[mesh.indices[j + k]];
+
+				if (vertex.w < OCCLUSION_MIN_W)
+				{
+					behind = true;
+					break;
+				}
+
+				x[k] = (vertex.x / vertex.w * 0.5f + 0.5f) * width;
+				y[k] = (vertex.y / vertex.w * 0.5f + 0.5f) * height;
+				z[k] = vertex.z / vertex.w * 0.5f + 0.5f;
+			}
+
+			if (behind)
+			{
+				continue;
+			}
+
+			// Counter clockwise triangles have a positive area
+			float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+
+			if (area <= 0.0f)
+			{
+				continue;
+			}
+
+			float min_x = std::min(x[0], std::min(x[1], x[2]));
+			float max_x = std::max(x[0], std::max(x[1], x[2]));
+			float min_y = std::min(y[0], std::min(y[1], y[2]));
+			float max_y = std::max(y[0], std::max(y[1], y[2]));
+
+			if (max_x < 0.0f || max_y < 0.0f || min_x >= width || min_y >= height)
+			{
+				continue;
+			}
+
+			ScreenTriangle triangle;
+
+			triangle.tile_x0 = static_cast<int>(std::max(min_x, 0.0f)) / OCCLUSION_TILE_WIDTH;
+			triangle.tile_y0 = static_cast<int>(std::max(min_y, 0.0f)) / OCCLUSION_TILE_HEIGHT;
+			triangle.tile_x1 = std::min(tiles_x - 1,
+				static_cast<int>(max_x) / OCCLUSION_TILE_WIDTH);
+			triangle.tile_y1 = std::min(tiles_y - 1,
+				static_cast<int>(max_y) / OCCLUSION_TILE_HEIGHT);
+
+			// Edge k goes from vertex k to the next, positive on its left
+			for (int k = 0; k < 3; ++k)
+			{
+				int next = (k + 1) % 3;
+
+				triangle.edge_a[k] = y[k] - y[next];
+				triangle.edge_b[k] = x[next] - x[k];
+				triangle.edge_c[k] = -(triangle.edge_a[k] * x[k] + triangle.edge_b[k] * y[k]);
+			}
+
+			triangle.depth_a = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+			triangle.depth_b = ((x[1] - x[0]) * (z[2] - z[0]) - (x[2] - x[0]) * (z[1] - z[0])) / area;
+			triangle.depth_c = z[0] - triangle.depth_a * x[0] - triangle.depth_b * y[0];
+
+			triangle.max_depth = std::min(1.0f, std::max(z[0], std::max(z[1], z[2])));
+
+			triangles.push_back(triangle);
+		}
+	}
+}
+
+void OcclusionRasterizer::rasterizeBand(int first_row, int last_row)
+{
+	for (unsigned i = 0u; i < active_threads; ++i)
+	{
+		for (auto& triangle : thread_triangles[i])
+		{
+			int tile_y0 = std::max(triangle.tile_y0, first_row);
+			int tile_y1 = std::min(triangle.tile_y1, last_row - 1);
+
+			for (int tile_y = tile_y0; tile_y <= tile_y1; ++tile_y)
+			{
+				float y = static_cast<float>(tile_y * OCCLUSION_TILE_HEIGHT);
+
+				for (int tile_x = triangle.tile_x0; tile_x <= triangle.tile_x1; ++tile_x)
+				{
+					float x = static_cast<float>(tile_x * OCCLUSION_TILE_WIDTH);
+
+					uint32_t mask = coverage(triangle.edge_a, triangle.edge_b,
+						triangle.edge_c, x, y);
+
+					if (!mask)
+					{
+						continue;
+					}
+
+					// Depth is linear in screen space, so its farthest
+					// value over the tile is at one of the corners
+					float depth_x0 = triangle.depth_a * x;
+					float depth_x1 = triangle.depth_a * (x + OCCLUSION_TILE_WIDTH);
+					float depth_y0 = triangle.depth_b * y + triangle.depth_c;
+					float depth_y1 = triangle.depth_b * (y + OCCLUSION_TILE_HEIGHT) +
+						triangle.depth_c;
+
+					float depth = std::max(std::max(depth_x0, depth_x1) + depth_y0,
+						std::max(depth_x0, depth_x1) + depth_y1);
+
+					depth = std::max(0.0f, std::min(depth, triangle.max_depth));
+
+					updateTile(tile_y * tiles_x + tile_x, mask, depth);
+				}
+			}
+		}
+	}
+}
+
+void OcclusionRasterizer::updateTile(size_t tile, uint32_t coverage, float depth)
+{
+	// When the triangle is much closer than the working layer, compared
+	// with the gap between the two layers, merging would keep the far
+	// depth of that layer. The layer is dropped and starts over from
+	// the triangle, falling back to the first depth, which stays
+	// conservative
+	float distance_to_layer = z_max1[tile] - depth;
+	float distance_between_layers = z_max0[tile] - z_max1[tile];
+
+	if (distance_to_layer > distance_between_layers)
+	{
+		z_max1[tile] = 0.0f;
+		masks[tile] = 0u;
+	}
+
+	z_max1[tile] = std::max(z_max1[tile], depth);
+	masks[tile] |= coverage;
+
+	// Fully covered, every pixel is now bound by the working layer
+	if (masks[tile] == ~0u)
+	{
+		z_max0[tile] = std::min(z_max0[tile], z_max1[tile]);
+		z_max1[tile] = 0.0f;
+		masks[tile] = 0u;
+	}
+}
+
+bool OcclusionRasterizer::isOccluded(glm::vec3 const& center, glm::vec3 const& extent) const
+{
+	float min_x = static_cast<float>(width);
+	float min_y = static_cast<float>(height);
+	float max_x = 0.0f;
+	float max_y = 0.0f;
+	float nearest = 1.0f;
+
+	for (int i = 0; i < 8; ++i)
+	{
+		glm::vec3 corner = center + extent * glm::vec3(
+			(i & 1) ? 1.0f : -1.0f,
+			(i & 2) ? 1.0f : -1.0f,
+			(i & 4) ? 1.0f : -1.0f);
+
+		glm::vec4 clip = pv_matrix * glm::vec4(corner, 1.0f);
+
+		if (clip.w < OCCLUSION_MIN_W)
+		{
+			return false;
+		}
+
+		float x = (clip.x / clip.w * 0.5f + 0.5f) * width;
+		float y = (clip.y / clip.w * 0.5f + 0.5f) * height;
+
+		min_x = std::min(min_x, x);
+		min_y = std::min(min_y, y);
+		max_x = std::max(max_x, x);
+		max_y = std::max(max_y, y);
+		nearest = std::min(nearest, clip.z / clip.w * 0.5f + 0.5f);
+	}
+
+	if (max_x < 0.0f || max_y < 0.0f || min_x >= width || min_y >= height)
+	{
+		return false;
+	}
+
+	int x0 = static_cast<int>(std::max(min_x, 0.0f));
+	int y0 = static_cast<int>(std::max(min_y, 0.0f));
+	int x1 = std::min(width - 1, static_cast<int>(max_x));
+	int y1 = std::min(height - 1, static_cast<int>(max_y));
+
+	for (int tile_y = y0 / OCCLUSION_TILE_HEIGHT; tile_y <= y1 / OCCLUSION_TILE_HEIGHT; ++tile_y)
+	{
+		for (int tile_x = x0 / OCCLUSION_TILE_WIDTH; tile_x <= x1 / OCCLUSION_TILE_WIDTH; ++tile_x)
+		{
+			size_t tile = tile_y * tiles_x + tile_x;
+
+			if (nearest > z_max0[tile])
+			{
+				continue;
+			}
+
+			if (nearest <= z_max1[tile])
+			{
+				return false;
+			}
+
+			// Behind the working layer, so hidden only where it covers
+			int column0 = std::max(x0 - tile_x * OCCLUSION_TILE_WIDTH, 0);
+			int column1 = std::min(x1 - tile_x * OCCLUSION_TILE_WIDTH, OCCLUSION_TILE_WIDTH - 1);
+			int row0 = std::max(y0 - tile_y * OCCLUSION_TILE_HEIGHT, 0);
+			int row1 = std::min(y1 - tile_y * OCCLUSION_TILE_HEIGHT, OCCLUSION_TILE_HEIGHT - 1);
+
+			uint32_t row_mask = ((1u << (column1 + 1)) - 1u) & ~((1u << column0) - 1u);
+			uint32_t box_mask = 0u;
+
+			for (int row = row0; row <= row1; ++row)
+			{
+				box_mask |= row_mask << (row * OCCLUSION_TILE_WIDTH);
+			}
+
+			if (box_mask & ~masks[tile])
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void OcclusionRasterizer::setActiveThreads(unsigned n_threads)
+{
+	active_threads = std::max(1u, std::min(n_threads,
+		static_cast<unsigned>(thread_triangles.size())));
+}
+
+unsigned OcclusionRasterizer::getThreadCount() const
+{
+	return static_cast<unsigned>(thread_triangles.size());
+}
+
+bool OcclusionRasterizer::hasAVX2() const
+{
+	return avx2;
+}
+
+int OcclusionRasterizer::getWidth() const
+{
+	return width;
+}
+
+int OcclusionRasterizer::getHeight() const
+{
+	return height;
+}
+
+OcclusionRasterizerStats const& OcclusionRasterizer::getStats() const
+{
+	return stats;
+}
+
+void OcclusionRasterizer::run(std::function<void(unsigned)> const& job)
+{
+	if (active_threads == 1u)
+	{
+		job(0u);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		this->job = job;
+		pending = active_threads - 1u;
+		++generation;
+	}
+
+	start_condition.notify_all();
+
+	job(0u);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done_condition.wait(lock, [this]() { return pending == 0u; });
+}
+
+void OcclusionRasterizer::worker(unsigned index)
+{
+	unsigned seen_generation = 0u;
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true)
+	{
+		start_condition.wait(lock, [&]()
+		{
+			return quit || generation != seen_generation;
+		});
+
+		if (quit)
+		{
+			return;
+		}
+
+		seen_generation = generation;
+
+		// Threads above the active count sit this one out
+		if (index >= active_threads)
+		{
+			continue;
+		}
+
+		std::function<void(unsigned)> current_job = job;
+
+		lock.unlock();
+		current_job(index);
+		lock.lock();
+
+		if (--pending == 0u)
+		{
+			done_condition.notify_one();
+		}
+	}
+}
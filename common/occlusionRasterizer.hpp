@@ -0,0 +1,161 @@
+#ifndef OCCLUSION_RASTERIZER_HPP
+#define OCCLUSION_RASTERIZER_HPP
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Pixels of a tile. A row of a tile is evaluated per instruction
+// with AVX2, and its coverage fits a 32 bit mask
+#define OCCLUSION_TILE_WIDTH 8
+#define OCCLUSION_TILE_HEIGHT 4
+
+// Triangles of a mesh kept on the CPU, in object space
+struct OccluderMesh
+{
+	std::vector<float> positions; // Packed xyz
+	std::vector<unsigned> indices;
+};
+
+struct Occluder
+{
+	OccluderMesh const* mesh;
+	glm::mat4 model_matrix;
+};
+
+struct OcclusionRasterizerStats
+{
+	unsigned triangles = 0u; // Rasterized, after back face and near plane culling
+	unsigned threads = 1u;
+	double render_ms = 0.0;
+};
+
+/*
+ * Low resolution software depth rasterizer for occlusion culling on
+ * the CPU, after masked occlusion culling (Andersson et al. 2015).
+ * Instead of a depth per pixel, each 8x4 tile keeps two depths and
+ * a coverage mask: no pixel is farther than the first depth, and
+ * those in the mask no farther than the second. When the mask fills
+ * up the second depth becomes the first, so the tile stays
+ * conservative with a fraction of the memory of a depth buffer.
+ *
+ * Triangles are transformed in parallel and then rasterized by every
+ * thread into its own band of tile rows, so no locking is needed.
+ * Coverage is computed with AVX2 when the CPU supports it, and one
+ * pixel at a time otherwise. Triangles crossing the near plane are
+ * dropped, which only makes the occluders smaller
+ */
+class OcclusionRasterizer
+{
+public:
+	// @n_threads == 0 uses every hardware thread
+	OcclusionRasterizer(int width, int height, unsigned n_threads = 0u);
+
+	virtual ~OcclusionRasterizer()
+	{}
+
+	// Stops the worker threads
+	void destroy();
+
+	void clear();
+
+	// Rasterizes @occluders seen through @pv_matrix on top of
+	// what's already there. The boxes tested next use the matrix
+	void render(std::vector<Occluder> const& occluders, glm::mat4 const& pv_matrix);
+
+	// Whether the world space box is behind everything rendered.
+	// Boxes crossing the near plane are never considered occluded
+	bool isOccluded(glm::vec3 const& center, glm::vec3 const& extent) const;
+
+	// Threads rendering, up to the number the rasterizer was created with
+	void setActiveThreads(unsigned n_threads);
+
+	unsigned getThreadCount() const;
+	bool hasAVX2() const;
+
+	int getWidth() const;
+	int getHeight() const;
+
+	OcclusionRasterizerStats const& getStats() const;
+
+private:
+	// Edge functions are positive inside, and depth is a plane
+	struct ScreenTriangle
+	{
+		float edge_a[3];
+		float edge_b[3];
+		float edge_c[3];
+
+		float depth_a;
+		float depth_b;
+		float depth_c;
+		float max_depth;
+
+		// Tile rectangle, inclusive
+		int tile_x0;
+		int tile_y0;
+		int tile_x1;
+		int tile_y1;
+	};
+
+	// Takes the edges of a triangle and the lower left pixel of a tile
+	typedef uint32_t (*CoverageFunction)(
+		float const* edge_a,
+		float const* edge_b,
+		float const* edge_c,
+		float x,
+		float y);
+
+	// Runs @job for every active thread index, the caller being thread 0
+	void run(std::function<void(unsigned)> const& job);
+	void worker(unsigned index);
+
+	void setupTriangles(
+		std::vector<Occluder> const& occluders,
+		size_t first,
+		size_t last,
+		std::vector<ScreenTriangle>& triangles) const;
+
+	void rasterizeBand(int first_row, int last_row);
+
+	void updateTile(size_t tile, uint32_t coverage, float depth);
+
+	int width;
+	int height;
+	int tiles_x;
+	int tiles_y;
+
+	glm::mat4 pv_matrix;
+
+	/// Tiles
+	std::vector<float> z_max0;
+	std::vector<float> z_max1;
+	std::vector<uint32_t> masks;
+
+	// Triangles set up by each thread
+	std::vector<std::vector<ScreenTriangle>> thread_triangles;
+
+	CoverageFunction coverage;
+	bool avx2 = false;
+
+	OcclusionRasterizerStats stats;
+
+	/// Worker threads
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable start_condition;
+	std::condition_variable done_condition;
+
+	std::function<void(unsigned)> job;
+	unsigned generation = 0u;
+	unsigned pending = 0u;
+	unsigned active_threads = 1u;
+	bool quit = false;
+};
+
+#endif // OCCLUSION_RASTERIZER_HPP
@@ -0,0 +1,255 @@
+#include "programReflection.hpp"
+
+#include <iostream>
+
+ProgramReflection::ProgramReflection(GLuint program_id)
+	:
+	program_id{ program_id }
+{
+	/// Uniform blocks
+	GLint n_blocks = 0;
+	GLint max_block_name = 0;
+
+	glGetProgramInterfaceiv(program_id, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &n_blocks);
+	glGetProgramInterfaceiv(program_id, GL_UNIFORM_BLOCK, GL_MAX_NAME_LENGTH, &max_block_name);
+
+	std::vector<char> name(max_block_name + 1);
+
+	GLenum const block_props[] = { GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+	GLint block_values[2];
+
+	blocks.resize(n_blocks);
+
+	for (GLint i = 0; i < n_blocks; ++i)
+	{
+		GLsizei length = 0;
+
+		glGetProgramResourceName(program_id, GL_UNIFORM_BLOCK, i,
+			static_cast<GLsizei>(name.size()), &length, name.data());
+		glGetProgramResourceiv(program_id, GL_UNIFORM_BLOCK, i,
+			2, block_props, 2, nullptr, block_values);
+
+		blocks[i].name = baseName(name, length);
+		blocks[i].binding = block_values[0];
+		blocks[i].data_size = block_values[1];
+
+		bool inserted = block_indices.emplace(
+			hashName(blocks[i].name.c_str()), static_cast<size_t>(i)).second;
+
+		assert(inserted && "Block name hash collision");
+		(void)inserted;
+	}
+
+	/// Uniforms
+	GLint n_uniforms = 0;
+	GLint max_uniform_name = 0;
+
+	glGetProgramInterfaceiv(program_id, GL_UNIFORM, GL_ACTIVE_RESOURCES, &n_uniforms);
+	glGetProgramInterfaceiv(program_id, GL_UNIFORM, GL_MAX_NAME_LENGTH, &max_uniform_name);
+
+	name.resize(max_uniform_name + 1);
+
+	GLenum const uniform_props[] = {
+		GL_TYPE, GL_ARRAY_SIZE, GL_LOCATION, GL_BLOCK_INDEX,
+		GL_OFFSET, GL_ARRAY_STRIDE, GL_MATRIX_STRIDE
+	};
+
+	for (GLint i = 0; i < n_uniforms; ++i)
+	{
+		GLsizei length = 0;
+		GLint values[7];
+
+		glGetProgramResourceName(program_id, GL_UNIFORM, i,
+			static_cast<GLsizei>(name.size()), &length, name.data());
+		glGetProgramResourceiv(program_id, GL_UNIFORM, i,
+			7, uniform_props, 7, nullptr, values);
+
+		UniformInfo info;
+		info.type = static_cast<GLenum>(values[0]);
+		info.array_size = values[1];
+		info.location = values[2];
+		info.block_index = values[3];
+		info.offset = values[4];
+		info.array_stride = values[5];
+		info.matrix_stride = values[6];
+
+		uint32_t hash = hashName(baseName(name, length).c_str());
+
+		bool inserted = info.block_index == -1 ?
+			uniforms.emplace(hash, info).second :
+			blocks[info.block_index].members.emplace(hash, info).second;
+
+		assert(inserted && "Uniform name hash collision");
+		(void)inserted;
+	}
+
+	/// Attributes
+	GLint n_attributes = 0;
+	GLint max_attribute_name = 0;
+
+	glGetProgramInterfaceiv(program_id, GL_PROGRAM_INPUT, GL_ACTIVE_RESOURCES, &n_attributes);
+	glGetProgramInterfaceiv(program_id, GL_PROGRAM_INPUT, GL_MAX_NAME_LENGTH, &max_attribute_name);
+
+	name.resize(max_attribute_name + 1);
+
+	GLenum const attribute_props[] = { GL_TYPE, GL_LOCATION };
+
+	for (GLint i = 0; i < n_attributes; ++i)
+	{
+		GLsizei length = 0;
+		GLint values[2];
+
+		glGetProgramResourceName(program_id, GL_PROGRAM_INPUT, i,
+			static_cast<GLsizei>(name.size()), &length, name.data());
+		glGetProgramResourceiv(program_id, GL_PROGRAM_INPUT, i,
+			2, attribute_props, 2, nullptr, values);
+
+		attributes[hashName(baseName(name, length).c_str())] =
+			AttributeInfo{ static_cast<GLenum>(values[0]), values[1] };
+	}
+}
+
+GLuint ProgramReflection::getId() const
+{
+	return program_id;
+}
+
+GLint ProgramReflection::uniform(uint32_t hash, char const* name) const
+{
+	auto it = uniforms.find(hash);
+
+	if (it == uniforms.end())
+	{
+		std::cerr << "ERROR: Program " << program_id
+			<< " has no active uniform " << name << '\n';
+
+		assert(false);
+		return -1;
+	}
+
+	return it->second.location;
+}
+
+GLint ProgramReflection::attribute(char const* name) const
+{
+	auto it = attributes.find(hashName(name));
+
+	if (it == attributes.end())
+	{
+		std::cerr << "ERROR: Program " << program_id
+			<< " has no active attribute " << name << '\n';
+
+		assert(false);
+		return -1;
+	}
+
+	return it->second.location;
+}
+
+bool ProgramReflection::hasUniform(char const* name) const
+{
+	return uniforms.find(hashName(name)) != uniforms.end();
+}
+
+UniformBlockInfo const& ProgramReflection::block(char const* name) const
+{
+	auto it = block_indices.find(hashName(name));
+
+	if (it == block_indices.end())
+	{
+		std::cerr << "ERROR: Program " << program_id
+			<< " has no active uniform block " << name << '\n';
+
+		abort();
+	}
+
+	return blocks[it->second];
+}
+
+GLint ProgramReflection::blockOffset(char const* block_name, char const* member) const
+{
+	return blockMember(block(block_name), member).offset;
+}
+
+void ProgramReflection::writeBlockMember(
+	UniformBlockInfo const& block,
+	char const* member,
+	void* data,
+	glm::mat3 const& value)
+{
+	writeColumns<3>(block, member, data, glm::value_ptr(value));
+}
+
+void ProgramReflection::writeBlockMember(
+	UniformBlockInfo const& block,
+	char const* member,
+	void* data,
+	glm::mat4 const& value)
+{
+	writeColumns<4>(block, member, data, glm::value_ptr(value));
+}
+
+size_t ProgramReflection::getUniformCount() const
+{
+	size_t count = uniforms.size();
+
+	for (auto const& block : blocks)
+	{
+		count += block.members.size();
+	}
+
+	return count;
+}
+
+size_t ProgramReflection::getBlockCount() const
+{
+	return blocks.size();
+}
+
+UniformInfo const& ProgramReflection::blockMember(
+	UniformBlockInfo const& block, char const* member)
+{
+	auto it = block.members.find(hashName(member));
+
+	if (it == block.members.end())
+	{
+		std::cerr << "ERROR: Uniform block " << block.name
+			<< " has no active member " << member << '\n';
+
+		abort();
+	}
+
+	return it->second;
+}
+
+template <size_t N>
+void ProgramReflection::writeColumns(
+	UniformBlockInfo const& block,
+	char const* member,
+	void* data,
+	float const* columns)
+{
+	UniformInfo const& info = blockMember(block, member);
+
+	assert(info.offset + (N - 1) * info.matrix_stride + N * sizeof(float) <=
+		static_cast<size_t>(block.data_size));
+
+	unsigned char* dst = static_cast<unsigned char*>(data) + info.offset;
+
+	for (size_t i = 0u; i < N; ++i)
+	{
+		std::memcpy(dst + i * info.matrix_stride, columns + i * N, N * sizeof(float));
+	}
+}
+
+std::string ProgramReflection::baseName(std::vector<char> const& buffer, GLsizei length)
+{
+	std::string name(buffer.data(), length);
+
+	if (name.size() > 3u && name.compare(name.size() - 3u, 3u, "[0]") == 0)
+	{
+		name.resize(name.size() - 3u);
+	}
+
+	return name;
+}
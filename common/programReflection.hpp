@@ -0,0 +1,153 @@
+#ifndef PROGRAM_REFLECTION_HPP
+#define PROGRAM_REFLECTION_HPP
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <glad/glad.h>
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 32 bit FNV-1a. Being constexpr it can hash at compile time, but
+// uniform() is an ordinary call and hashes at runtime, so locations
+// used every frame are better resolved once after linking
+constexpr uint32_t hashName(char const* name)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*name)
+	{
+		hash = (hash ^ static_cast<unsigned char>(*name++)) * 16777619u;
+	}
+
+	return hash;
+}
+
+struct UniformInfo
+{
+	GLenum type;
+	GLint array_size;
+
+	// -1 for members of a uniform block
+	GLint location;
+
+	/// Uniform block members
+	GLint block_index;
+	GLint offset;
+	GLint array_stride;
+	GLint matrix_stride;
+};
+
+struct UniformBlockInfo
+{
+	std::string name;
+	GLint binding;
+	GLint data_size;
+
+	std::unordered_map<uint32_t, UniformInfo> members;
+};
+
+struct AttributeInfo
+{
+	GLenum type;
+	GLint location;
+};
+
+/*
+ * Active uniforms, uniform blocks and vertex attributes of a linked
+ * program, queried once through the program interface API and keyed
+ * on hashName(name). Arrays are stored without their "[0]" suffix.
+ * Looking up a name the program doesn't use trips an assert, which
+ * catches typos and uniforms optimized away by the compiler.
+ */
+class ProgramReflection
+{
+public:
+	explicit ProgramReflection(GLuint program_id);
+
+	ProgramReflection()
+	{}
+
+	virtual ~ProgramReflection()
+	{}
+
+	GLuint getId() const;
+
+	// Location of a uniform of the default block
+	GLint uniform(char const* name) const
+	{
+		return uniform(hashName(name), name);
+	}
+
+	GLint attribute(char const* name) const;
+
+	bool hasUniform(char const* name) const;
+
+	UniformBlockInfo const& block(char const* name) const;
+
+	// Offset of @member inside @block, as laid out by the driver
+	GLint blockOffset(char const* block, char const* member) const;
+
+	// Copies @value to where @member lives in @data, a buffer
+	// laid out like @block. Matrices honor the matrix stride
+	template <typename T>
+	static void writeBlockMember(
+		UniformBlockInfo const& block,
+		char const* member,
+		void* data,
+		T const& value)
+	{
+		UniformInfo const& info = blockMember(block, member);
+
+		assert(info.offset + sizeof(T) <= static_cast<size_t>(block.data_size));
+
+		std::memcpy(static_cast<unsigned char*>(data) + info.offset, &value, sizeof(T));
+	}
+
+	static void writeBlockMember(
+		UniformBlockInfo const& block,
+		char const* member,
+		void* data,
+		glm::mat3 const& value);
+
+	static void writeBlockMember(
+		UniformBlockInfo const& block,
+		char const* member,
+		void* data,
+		glm::mat4 const& value);
+
+	size_t getUniformCount() const;
+	size_t getBlockCount() const;
+
+private:
+	GLint uniform(uint32_t hash, char const* name) const;
+
+	static UniformInfo const& blockMember(
+		UniformBlockInfo const& block, char const* member);
+
+	template <size_t N>
+	static void writeColumns(
+		UniformBlockInfo const& block,
+		char const* member,
+		void* data,
+		float const* columns);
+
+	// Strips the "[0]" of array names
+	static std::string baseName(std::vector<char> const& buffer, GLsizei length);
+
+	GLuint program_id = 0;
+
+	std::unordered_map<uint32_t, UniformInfo> uniforms;
+	std::unordered_map<uint32_t, AttributeInfo> attributes;
+
+	std::vector<UniformBlockInfo> blocks;
+	std::unordered_map<uint32_t, size_t> block_indices;
+};
+
+#endif // PROGRAM_REFLECTION_HPP
@@ -0,0 +1,165 @@
+#include "programVariants.hpp"
+
+#include <cstdlib>
+#include <iostream>
+
+ProgramVariants::ProgramVariants(
+	std::vector<ShaderInfo> const& shader_infos,
+	std::vector<std::string> const& options)
+	:
+	shader_infos{ shader_infos },
+	options{ options }
+{
+	assert(options.size() <= 32u && "Keys have 32 bits");
+}
+
+void ProgramVariants::destroy(OpenGLContext& gl)
+{
+	for (auto& it : pending)
+	{
+		bool success;
+		GLuint program_id = gl.finishProgram(it.second, success);
+
+		if (success)
+		{
+			gl.deleteProgram(program_id);
+		}
+	}
+
+	for (auto& it : programs)
+	{
+		gl.deleteProgram(it.second);
+	}
+
+	pending.clear();
+	programs.clear();
+
+	current = 0u;
+}
+
+GLuint ProgramVariants::get(OpenGLContext& gl, uint32_t key, bool& built)
+{
+	auto it = programs.find(key);
+
+	if (it != programs.end())
+	{
+		built = false;
+		current = it->second;
+
+		return current;
+	}
+
+	auto build = pending.find(key);
+
+	if (build == pending.end())
+	{
+		std::vector<ShaderInfo> variant = variantShaders(key);
+
+		current = finish(gl, key, gl.submitProgram(variant));
+	}
+	else
+	{
+		size_t handle = build->second;
+		pending.erase(build);
+
+		current = finish(gl, key, handle);
+	}
+
+	built = true;
+
+	return current;
+}
+
+GLuint ProgramVariants::request(OpenGLContext& gl, uint32_t key)
+{
+	auto it = programs.find(key);
+
+	if (it != programs.end())
+	{
+		current = it->second;
+		return current;
+	}
+
+	auto build = pending.find(key);
+
+	if (build == pending.end())
+	{
+		build = pending.emplace(key, gl.submitProgram(variantShaders(key))).first;
+	}
+
+	if (current == 0u || gl.isProgramReady(build->second))
+	{
+		size_t handle = build->second;
+		pending.erase(build);
+
+		current = finish(gl, key, handle);
+	}
+
+	return current;
+}
+
+std::string ProgramVariants::describe(uint32_t key) const
+{
+	std::string description;
+
+	for (size_t i = 0u; i < options.size(); ++i)
+	{
+		if (key & (1u << i))
+		{
+			if (!description.empty())
+			{
+				description += ' ';
+			}
+
+			description += options[i];
+		}
+	}
+
+	return description;
+}
+
+size_t ProgramVariants::getCount() const
+{
+	return programs.size();
+}
+
+size_t ProgramVariants::getPendingCount() const
+{
+	return pending.size();
+}
+
+std::vector<ShaderInfo> ProgramVariants::variantShaders(uint32_t key) const
+{
+	std::vector<std::string> defines;
+
+	for (size_t i = 0u; i < options.size(); ++i)
+	{
+		if (key & (1u << i))
+		{
+			defines.emplace_back(options[i]);
+		}
+	}
+
+	std::vector<ShaderInfo> variant = shader_infos;
+	addDefines(variant, defines);
+
+	return variant;
+}
+
+GLuint ProgramVariants::finish(OpenGLContext& gl, uint32_t key, size_t build)
+{
+	bool success;
+	GLuint program_id = gl.finishProgram(build, success);
+
+	if (!success)
+	{
+		std::cerr << "ERROR: Could not build program variant {"
+			<< describe(key) << "}\n";
+
+		abort();
+	}
+
+	programs[key] = program_id;
+
+	return program_id;
+}
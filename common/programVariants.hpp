@@ -0,0 +1,72 @@
+#ifndef PROGRAM_VARIANTS_HPP
+#define PROGRAM_VARIANTS_HPP
+
+#include "glContext.hpp"
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Specializations of one program selected by a key. Bit i of a key
+ * defines @options[i] in every stage, so features toggled per material
+ * become preprocessor branches instead of uniform ones. Variants are
+ * built the first time they're requested and kept until destroy().
+ * request() submits them to the driver without waiting, so a new
+ * variant is compiled in the background while drawing carries on
+ * with the previous one.
+ */
+class ProgramVariants
+{
+public:
+	ProgramVariants(
+		std::vector<ShaderInfo> const& shader_infos,
+		std::vector<std::string> const& options);
+
+	ProgramVariants()
+	{}
+
+	virtual ~ProgramVariants()
+	{}
+
+	// Frees every variant built so far, and the ones still compiling
+	void destroy(OpenGLContext& gl);
+
+	// Returns the program for @key, building it if needed. @built is
+	// set when the variant was built by this call, so that the caller
+	// can look its uniforms up. Aborts if the variant fails to build
+	GLuint get(OpenGLContext& gl, uint32_t key, bool& built);
+
+	// Returns the program for @key once it's built. Until then the
+	// variant is compiled in the background and the last program
+	// returned is drawn instead, only waiting if there's none yet.
+	// Aborts if the variant fails to build
+	GLuint request(OpenGLContext& gl, uint32_t key);
+
+	// The defines enabled by @key, separated by spaces
+	std::string describe(uint32_t key) const;
+
+	size_t getCount() const;
+	size_t getPendingCount() const;
+
+private:
+	// The shaders with the defines of @key added
+	std::vector<ShaderInfo> variantShaders(uint32_t key) const;
+
+	GLuint finish(OpenGLContext& gl, uint32_t key, size_t build);
+
+	std::vector<ShaderInfo> shader_infos;
+	std::vector<std::string> options;
+
+	std::unordered_map<uint32_t, GLuint> programs;
+
+	// Build handles of the variants being compiled
+	std::unordered_map<uint32_t, size_t> pending;
+
+	GLuint current = 0u;
+};
+
+#endif // PROGRAM_VARIANTS_HPP
@@ -0,0 +1,131 @@
+#include "reflectionProbe.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+
+ReflectionProbe::ReflectionProbe(
+	glm::vec3 const& position,
+	int size,
+	float near_plane,
+	float far_plane)
+	:
+	position{ position },
+	size{ size },
+	projection{ glm::perspective(
+		glm::radians(90.0f), 1.0f, near_plane, far_plane) },
+	cube_texture(size, size, 3,
+		GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, true),
+	depth_buffer(GL_DEPTH_COMPONENT24, size, size)
+{
+	framebuffer.attachRenderbuffer(GL_DEPTH_ATTACHMENT, depth_buffer);
+}
+
+void ReflectionProbe::destroy()
+{
+	framebuffer.destroy();
+	depth_buffer.destroy();
+	cube_texture.destroy();
+}
+
+int ReflectionProbe::update(int n_faces, DrawFunction const& draw)
+{
+	n_faces = std::min(n_faces, n_stale_faces);
+
+	if (n_faces <= 0)
+	{
+		return 0;
+	}
+
+	// Same orientation convention as the GL cube map faces
+	static glm::vec3 const directions[]
+	{
+		glm::vec3(1.0f, 0.0f, 0.0f),
+		glm::vec3(-1.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 1.0f, 0.0f),
+		glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f),
+		glm::vec3(0.0f, 0.0f, -1.0f)
+	};
+
+	static glm::vec3 const ups[]
+	{
+		glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f),
+		glm::vec3(0.0f, 0.0f, -1.0f),
+		glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, -1.0f, 0.0f)
+	};
+
+	GLint last_framebuffer;
+	GLint last_viewport[4];
+
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &last_framebuffer);
+	glGetIntegerv(GL_VIEWPORT, last_viewport);
+
+	framebuffer.bind();
+	glViewport(0, 0, size, size);
+
+	for (int i = 0; i < n_faces; ++i)
+	{
+		framebuffer.attachCubeMapTexture(
+			GL_COLOR_ATTACHMENT0, cube_texture, 0, next_face);
+
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		draw(glm::lookAt(position, position + directions[next_face],
+			ups[next_face]), projection);
+
+		next_face = (next_face + 1) % 6;
+	}
+
+	n_stale_faces -= n_faces;
+
+	glGenerateTextureMipmap(cube_texture.getId());
+
+	glBindFramebuffer(GL_FRAMEBUFFER, last_framebuffer);
+	glViewport(last_viewport[0], last_viewport[1],
+		last_viewport[2], last_viewport[3]);
+
+	return n_faces;
+}
+
+void ReflectionProbe::invalidate()
+{
+	n_stale_faces = 6;
+}
+
+bool ReflectionProbe::isCurrent() const
+{
+	return n_stale_faces == 0;
+}
+
+void ReflectionProbe::setPosition(glm::vec3 const& new_position)
+{
+	if (new_position != position)
+	{
+		position = new_position;
+		invalidate();
+	}
+}
+
+glm::vec3 const& ReflectionProbe::getPosition() const
+{
+	return position;
+}
+
+Texture const& ReflectionProbe::getTexture() const
+{
+	return cube_texture;
+}
+
+int ReflectionProbe::getSize() const
+{
+	return size;
+}
+
+void ReflectionProbe::bind(GLuint unit)
+{
+	cube_texture.bind(unit);
+}
@@ -0,0 +1,71 @@
+#ifndef REFLECTION_PROBE_HPP
+#define REFLECTION_PROBE_HPP
+
+#include "framebuffer.hpp"
+#include "renderbuffer.hpp"
+#include "texture.hpp"
+
+#include <glm/glm.hpp>
+
+#include <functional>
+
+/*
+ * Captures the scene surrounding a point into a cube map.
+ * Faces are captured incrementally, so the cost of keeping
+ * a probe up to date can be spread over several frames.
+ */
+class ReflectionProbe
+{
+public:
+	using DrawFunction =
+		std::function<void(glm::mat4 const& view, glm::mat4 const& projection)>;
+
+	// @size is the resolution of each face. The cube map
+	// has a full mipmap chain used as a cheap prefilter
+	// for blurrier reflections
+	ReflectionProbe(
+		glm::vec3 const& position,
+		int size,
+		float near_plane,
+		float far_plane);
+
+	virtual ~ReflectionProbe()
+	{}
+
+	void destroy();
+
+	// Captures up to @n_faces stale faces, calling @draw for each
+	// one with the framebuffer and viewport already set up.
+	// The mipmaps are regenerated if any face was drawn.
+	// The previous framebuffer and viewport are restored.
+	// Returns the number of captured faces
+	int update(int n_faces, DrawFunction const& draw);
+
+	// Marks every face as stale
+	void invalidate();
+
+	bool isCurrent() const;
+
+	void setPosition(glm::vec3 const& new_position);
+	glm::vec3 const& getPosition() const;
+
+	Texture const& getTexture() const;
+	int getSize() const;
+
+	void bind(GLuint unit);
+
+private:
+	glm::vec3 position;
+	int size;
+
+	glm::mat4 projection;
+
+	Empty16FTextureCube cube_texture;
+	Renderbuffer depth_buffer;
+	Framebuffer framebuffer;
+
+	int next_face = 0;
+	int n_stale_faces = 6;
+};
+
+#endif // REFLECTION_PROBE_HPP
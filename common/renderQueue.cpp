@@ -0,0 +1,179 @@
+#include "renderQueue.hpp"
+
+#include <algorithm>
+
+#define SORT_KEY_MASK(bits) ((uint64_t(1) << (bits)) - 1u)
+
+// Shifts from the least significant bit. The state fields
+// are packed the same way in both orders, below the depth
+// when it goes first and above it otherwise
+#define SORT_KEY_PASS_SHIFT (64 - SORT_KEY_PASS_BITS)
+#define SORT_KEY_ORDER_SHIFT (SORT_KEY_PASS_SHIFT - 1)
+#define SORT_KEY_STATE_BITS (SORT_KEY_PROGRAM_BITS + SORT_KEY_MATERIAL_BITS + SORT_KEY_MESH_BITS)
+
+static unsigned stateShift(uint64_t key)
+{
+	return sortKeyOrder(key) == BACK_TO_FRONT ? 0u : SORT_KEY_DEPTH_BITS;
+}
+
+uint64_t makeSortKey(
+	unsigned pass,
+	DepthOrder order,
+	unsigned program,
+	unsigned material,
+	unsigned mesh,
+	float depth)
+{
+	depth = std::max(0.0f, std::min(depth, 1.0f));
+
+	uint64_t quantized_depth = static_cast<uint64_t>(
+		depth * SORT_KEY_MASK(SORT_KEY_DEPTH_BITS));
+
+	// Farther draws get smaller keys
+	if (order == BACK_TO_FRONT)
+	{
+		quantized_depth = SORT_KEY_MASK(SORT_KEY_DEPTH_BITS) - quantized_depth;
+	}
+
+	uint64_t state =
+		(uint64_t(program) & SORT_KEY_MASK(SORT_KEY_PROGRAM_BITS)) <<
+			(SORT_KEY_MATERIAL_BITS + SORT_KEY_MESH_BITS) |
+		(uint64_t(material) & SORT_KEY_MASK(SORT_KEY_MATERIAL_BITS)) << SORT_KEY_MESH_BITS |
+		(uint64_t(mesh) & SORT_KEY_MASK(SORT_KEY_MESH_BITS));
+
+	uint64_t key =
+		(uint64_t(pass) & SORT_KEY_MASK(SORT_KEY_PASS_BITS)) << SORT_KEY_PASS_SHIFT |
+		uint64_t(order) << SORT_KEY_ORDER_SHIFT;
+
+	if (order == BACK_TO_FRONT)
+	{
+		key |= quantized_depth << SORT_KEY_STATE_BITS | state;
+	}
+	else
+	{
+		key |= state << SORT_KEY_DEPTH_BITS | quantized_depth;
+	}
+
+	return key;
+}
+
+unsigned sortKeyPass(uint64_t key)
+{
+	return static_cast<unsigned>(key >> SORT_KEY_PASS_SHIFT);
+}
+
+DepthOrder sortKeyOrder(uint64_t key)
+{
+	return static_cast<DepthOrder>((key >> SORT_KEY_ORDER_SHIFT) & 1u);
+}
+
+unsigned sortKeyProgram(uint64_t key)
+{
+	return static_cast<unsigned>((key >> (stateShift(key) + SORT_KEY_MATERIAL_BITS +
+		SORT_KEY_MESH_BITS)) & SORT_KEY_MASK(SORT_KEY_PROGRAM_BITS));
+}
+
+unsigned sortKeyMaterial(uint64_t key)
+{
+	return static_cast<unsigned>((key >> (stateShift(key) + SORT_KEY_MESH_BITS)) &
+		SORT_KEY_MASK(SORT_KEY_MATERIAL_BITS));
+}
+
+unsigned sortKeyMesh(uint64_t key)
+{
+	return static_cast<unsigned>((key >> stateShift(key)) &
+		SORT_KEY_MASK(SORT_KEY_MESH_BITS));
+}
+
+void RenderQueue::clear()
+{
+	keys.clear();
+	draws.clear();
+}
+
+void RenderQueue::push(uint64_t key, uint32_t draw)
+{
+	keys.push_back(key);
+	draws.push_back(draw);
+}
+
+void RenderQueue::sort()
+{
+	size_t size = keys.size();
+
+	sorted_keys.resize(size);
+	sorted_draws.resize(size);
+
+	for (unsigned shift = 0u; shift < 64u; shift += 8u)
+	{
+		size_t offsets[256] = {};
+
+		for (auto it : keys)
+		{
+			++offsets[(it >> shift) & 0xFFu];
+		}
+
+		// Every key in one bucket leaves the order as it is
+		if (size == 0u || offsets[(keys[0] >> shift) & 0xFFu] == size)
+		{
+			continue;
+		}
+
+		size_t total = 0u;
+
+		for (auto& it : offsets)
+		{
+			size_t count = it;
+			it = total;
+			total += count;
+		}
+
+		for (size_t i = 0u; i < size; ++i)
+		{
+			size_t destination = offsets[(keys[i] >> shift) & 0xFFu]++;
+
+			sorted_keys[destination] = keys[i];
+			sorted_draws[destination] = draws[i];
+		}
+
+		keys.swap(sorted_keys);
+		draws.swap(sorted_draws);
+	}
+}
+
+size_t RenderQueue::getSize() const
+{
+	return keys.size();
+}
+
+uint64_t RenderQueue::getKey(size_t i) const
+{
+	return keys[i];
+}
+
+uint32_t RenderQueue::getDraw(size_t i) const
+{
+	return draws[i];
+}
+
+RenderQueueStats RenderQueue::countStateChanges() const
+{
+	RenderQueueStats stats;
+
+	stats.draws = static_cast<unsigned>(keys.size());
+
+	// The first draw sets everything
+	for (size_t i = 0u; i < keys.size(); ++i)
+	{
+		bool first = i == 0u;
+
+		stats.pass_changes += first || sortKeyPass(keys[i]) != sortKeyPass(keys[i - 1u]);
+		stats.program_changes += first ||
+			sortKeyProgram(keys[i]) != sortKeyProgram(keys[i - 1u]);
+		stats.material_changes += first ||
+			sortKeyMaterial(keys[i]) != sortKeyMaterial(keys[i - 1u]);
+		stats.mesh_changes += first || sortKeyMesh(keys[i]) != sortKeyMesh(keys[i - 1u]);
+	}
+
+	return stats;
+}
@@ -0,0 +1,87 @@
+#ifndef RENDER_QUEUE_HPP
+#define RENDER_QUEUE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bits of each field of a sort key. They add up to 63,
+// the remaining bit holding the depth order of the pass
+#define SORT_KEY_PASS_BITS 3
+#define SORT_KEY_PROGRAM_BITS 10
+#define SORT_KEY_MATERIAL_BITS 14
+#define SORT_KEY_MESH_BITS 12
+#define SORT_KEY_DEPTH_BITS 24
+
+enum DepthOrder
+{
+	FRONT_TO_BACK = 0,
+	BACK_TO_FRONT = 1
+};
+
+/*
+ * Packs a draw into a 64 bit key whose order is the submission order.
+ * The pass comes first. Front to back passes then sort by program,
+ * material and mesh, so that draws sharing state end up together, and
+ * by depth among those. Blending needs back to front passes in depth
+ * order whatever the state, so there depth comes before it. @program,
+ * @material and @mesh are small indices chosen by the caller and must
+ * fit their fields. @depth is clamped to [0, 1], 0 being the nearest
+ */
+uint64_t makeSortKey(
+	unsigned pass,
+	DepthOrder order,
+	unsigned program,
+	unsigned material,
+	unsigned mesh,
+	float depth);
+
+unsigned sortKeyPass(uint64_t key);
+DepthOrder sortKeyOrder(uint64_t key);
+unsigned sortKeyProgram(uint64_t key);
+unsigned sortKeyMaterial(uint64_t key);
+unsigned sortKeyMesh(uint64_t key);
+
+// Times a field differs from the one of the previous draw
+struct RenderQueueStats
+{
+	unsigned draws = 0u;
+	unsigned pass_changes = 0u;
+	unsigned program_changes = 0u;
+	unsigned material_changes = 0u;
+	unsigned mesh_changes = 0u;
+};
+
+/*
+ * Draws of a frame, each a sort key and an index into whatever the
+ * caller keeps per draw. Keys and indices are kept in separate arrays
+ * so that the sort moves 12 bytes per draw and pass
+ */
+class RenderQueue
+{
+public:
+	void clear();
+	void push(uint64_t key, uint32_t draw);
+
+	// Least significant digit radix sort, a byte per pass. It's
+	// stable, and bytes that are the same in every key are skipped
+	void sort();
+
+	size_t getSize() const;
+	uint64_t getKey(size_t i) const;
+	uint32_t getDraw(size_t i) const;
+
+	// Counted over the current order, so before and after sort()
+	// they tell what sorting saves
+	RenderQueueStats countStateChanges() const;
+
+private:
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> draws;
+
+	// Destination of every other pass of the sort
+	std::vector<uint64_t> sorted_keys;
+	std::vector<uint32_t> sorted_draws;
+};
+
+#endif // RENDER_QUEUE_HPP
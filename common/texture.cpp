@@ -80,7 +80,7 @@ Texture2D::Texture2D(
 	:
 	Texture(file_path)
 {
-	stbi_set_flip_vertically_on_load(flip_on_load);
+	stbi_set_flip_vertically_on_load_thread(flip_on_load);
 
 	unsigned char* image = stbi_load(path.c_str(),
 		&width, &height, &channels, n_desired_channels);
@@ -293,7 +293,7 @@ TextureCube::TextureCube(
 	:
 	Texture(folder)
 {
-	stbi_set_flip_vertically_on_load(flip_on_load);
+	stbi_set_flip_vertically_on_load_thread(flip_on_load);
 
 	std::string faces[]
 	{
@@ -490,6 +490,78 @@ Empty16FTextureCube::Empty16FTextureCube(
 	}
 }
 
+Texture2DArray::Texture2DArray(
+	int width,
+	int height,
+	int layers,
+	GLenum internal_format,
+	GLint wrap_s,
+	GLint wrap_t,
+	GLint min_filter,
+	GLint mag_filter)
+	:
+	Texture("Empty Texture 2D Array", width, height),
+	layers{ layers }
+{
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &id);
+
+	if (!glIsTexture(id))
+	{
+		std::cerr << "ERROR: Could not create texture from " + path + '\n';
+		abort();
+	}
+
+	GLsizei n_mipmap_levels = 1;
+
+	if (min_filter == GL_NEAREST_MIPMAP_NEAREST ||
+		min_filter == GL_NEAREST_MIPMAP_LINEAR ||
+		min_filter == GL_LINEAR_MIPMAP_NEAREST ||
+		min_filter == GL_LINEAR_MIPMAP_LINEAR)
+	{
+		n_mipmap_levels = 1 + floor(std::log2(std::max(width, height)));
+	}
+
+	glTextureStorage3D(id, n_mipmap_levels, internal_format, width, height, layers);
+
+	glTextureParameteri(id, GL_TEXTURE_WRAP_S, wrap_s);
+	glTextureParameteri(id, GL_TEXTURE_WRAP_T, wrap_t);
+	glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, min_filter);
+	glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, mag_filter);
+}
+
+int Texture2DArray::getLayers() const
+{
+	return layers;
+}
+
+HDRImage decodeHDRImage(std::string const& file_path, bool flip_on_load)
+{
+	HDRImage image;
+	image.path = file_path;
+
+	// The thread local flag keeps concurrent decodes from racing
+	stbi_set_flip_vertically_on_load_thread(flip_on_load);
+
+	image.data = stbi_loadf(file_path.c_str(),
+		&image.width, &image.height, &image.channels, 0);
+
+	if (!image.data)
+	{
+		std::cerr << "ERROR: Could not load texture " +
+			file_path + ": " + stbi_failure_reason() + '\n';
+
+		abort();
+	}
+
+	return image;
+}
+
+void freeHDRImage(HDRImage& image)
+{
+	stbi_image_free(image.data);
+	image.data = nullptr;
+}
+
 TextureHDREnvironment::TextureHDREnvironment(
 	std::string const& file_path,
 	GLint wrap_s,
@@ -500,20 +572,38 @@ TextureHDREnvironment::TextureHDREnvironment(
 	:
 	Texture(file_path)
 {
-	stbi_set_flip_vertically_on_load(flip_on_load);
+	HDRImage image = decodeHDRImage(file_path, flip_on_load);
 
-	float* image = stbi_loadf(file_path.c_str(), &width, &height, &channels, 0);
+	width = image.width;
+	height = image.height;
+	channels = image.channels;
 
-	if (!image)
-	{
-		std::cerr << "ERROR: Could not load texture " +
-			path + ": " + stbi_failure_reason() + '\n';
+	upload(image.data, wrap_s, wrap_t, min_filter, mag_filter);
 
-		abort();
-	}
+	freeHDRImage(image);
+}
 
-	GLenum internal_format, data_format;
+TextureHDREnvironment::TextureHDREnvironment(
+	HDRImage const& image,
+	GLint wrap_s,
+	GLint wrap_t,
+	GLint min_filter,
+	GLint mag_filter)
+	:
+	Texture(image.path, image.width, image.height)
+{
+	channels = image.channels;
 
+	upload(image.data, wrap_s, wrap_t, min_filter, mag_filter);
+}
+
+void TextureHDREnvironment::upload(
+	float const* data,
+	GLint wrap_s,
+	GLint wrap_t,
+	GLint min_filter,
+	GLint mag_filter)
+{
 	glCreateTextures(GL_TEXTURE_2D, 1, &id);
 
 	if (!glIsTexture(id))
@@ -539,7 +629,7 @@ TextureHDREnvironment::TextureHDREnvironment(
 	glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, min_filter);
 	glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, mag_filter);
 
-	glTextureSubImage2D(id, 0, 0, 0, width, height, GL_RGB, GL_FLOAT, image);
+	glTextureSubImage2D(id, 0, 0, 0, width, height, GL_RGB, GL_FLOAT, data);
 
 	if (min_filter == GL_NEAREST_MIPMAP_NEAREST ||
 		min_filter == GL_NEAREST_MIPMAP_LINEAR ||
@@ -548,7 +638,4 @@ TextureHDREnvironment::TextureHDREnvironment(
 	{
 		glGenerateTextureMipmap(id);
 	}
-
-	stbi_image_free(image);
 }
-
@@ -84,6 +84,30 @@ public:
 	{}
 };
 
+// Empty 2D array texture. Mipmap levels are allocated
+// when @min_filter samples from them
+class Texture2DArray : public Texture
+{
+public:
+	Texture2DArray(
+		int width,
+		int height,
+		int layers,
+		GLenum internal_format,
+		GLint wrap_s,
+		GLint wrap_t,
+		GLint min_filter,
+		GLint mag_filter);
+
+	Texture2DArray()
+	{}
+
+	int getLayers() const;
+
+private:
+	int layers;
+};
+
 class TextureCube : public Texture
 {
 public:
@@ -112,6 +136,23 @@ public:
 		bool allocate_mipmap_space);
 };
 
+// HDR image decoded to floats in system memory.
+// Decoding doesn't touch OpenGL, so it can run on any thread
+struct HDRImage
+{
+	std::string path;
+
+	float* data = nullptr;
+
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+};
+
+// Aborts if the file can't be decoded
+HDRImage decodeHDRImage(std::string const& file_path, bool flip_on_load);
+void freeHDRImage(HDRImage& image);
+
 class TextureHDREnvironment : public Texture
 {
 public:
@@ -122,6 +163,22 @@ public:
 		GLint min_filter,
 		GLint mag_filter,
 		bool flip_on_load);
+
+	// Uploads an image already decoded with decodeHDRImage
+	TextureHDREnvironment(
+		HDRImage const& image,
+		GLint wrap_s,
+		GLint wrap_t,
+		GLint min_filter,
+		GLint mag_filter);
+
+private:
+	void upload(
+		float const* data,
+		GLint wrap_s,
+		GLint wrap_t,
+		GLint min_filter,
+		GLint mag_filter);
 };
 
 #endif // TEXTURE_HPP
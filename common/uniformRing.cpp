@@ -0,0 +1,142 @@
+#include "uniformRing.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+UniformBufferRing::UniformBufferRing(GLsizeiptr frame_size, int n_frames)
+	:
+	n_frames{ n_frames },
+	current_frame{ n_frames - 1 },
+	cursor{ 0 },
+	fences(n_frames, nullptr),
+	n_stalls{ 0u }
+{
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+	// Keeping each region aligned keeps every offset aligned
+	this->frame_size = (frame_size + alignment - 1) / alignment * alignment;
+
+	glCreateBuffers(1, &id);
+
+	if (!glIsBuffer(id))
+	{
+		std::cerr << "ERROR: Could not create uniform buffer ring\n";
+		abort();
+	}
+
+	GLbitfield flags =
+		GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glNamedBufferStorage(id, this->frame_size * n_frames, nullptr, flags);
+
+	mapped = (unsigned char*)glMapNamedBufferRange(
+		id, 0, this->frame_size * n_frames, flags);
+
+	if (!mapped)
+	{
+		std::cerr << "ERROR: Could not map uniform buffer ring\n";
+		abort();
+	}
+}
+
+void UniformBufferRing::destroy()
+{
+	for (GLsync& fence : fences)
+	{
+		if (fence)
+		{
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+
+	if (glIsBuffer(id))
+	{
+		glUnmapNamedBuffer(id);
+		glDeleteBuffers(1, &id);
+	}
+}
+
+void UniformBufferRing::beginFrame()
+{
+	current_frame = (current_frame + 1) % n_frames;
+	cursor = 0;
+
+	GLsync& fence = fences[current_frame];
+
+	if (!fence)
+	{
+		return;
+	}
+
+	GLenum status = glClientWaitSync(fence, 0, 0);
+
+	if (status == GL_TIMEOUT_EXPIRED)
+	{
+		++n_stalls;
+
+		// One second per try, flushing in case the fence wasn't submitted
+		do
+		{
+			status = glClientWaitSync(fence,
+				GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		} while (status == GL_TIMEOUT_EXPIRED);
+	}
+
+	if (status == GL_WAIT_FAILED)
+	{
+		std::cerr << "ERROR: Waiting on uniform buffer ring fence failed\n";
+		abort();
+	}
+
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+void UniformBufferRing::endFrame()
+{
+	fences[current_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLintptr UniformBufferRing::push(void const* data, GLsizeiptr size)
+{
+	if (cursor + size > frame_size)
+	{
+		std::cerr << "ERROR: Uniform buffer ring region of "
+			<< frame_size << " bytes is full\n";
+
+		abort();
+	}
+
+	GLintptr offset = current_frame * frame_size + cursor;
+
+	std::memcpy(mapped + offset, data, size);
+
+	cursor += (size + alignment - 1) / alignment * alignment;
+
+	return offset;
+}
+
+void UniformBufferRing::bindRange(
+	GLuint binding,
+	GLintptr offset,
+	GLsizeiptr size)
+{
+	glBindBufferRange(GL_UNIFORM_BUFFER, binding, id, offset, size);
+}
+
+GLuint UniformBufferRing::getId() const
+{
+	return id;
+}
+
+GLsizeiptr UniformBufferRing::getUsedSize() const
+{
+	return cursor;
+}
+
+unsigned UniformBufferRing::getStalls() const
+{
+	return n_stalls;
+}
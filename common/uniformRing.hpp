@@ -0,0 +1,78 @@
+#ifndef UNIFORM_RING_HPP
+#define UNIFORM_RING_HPP
+
+#include <glad/glad.h>
+
+#include <vector>
+
+/*
+ * Persistently mapped uniform buffer split in one region per
+ * frame in flight. Blocks are written straight into the mapping
+ * and bound with glBindBufferRange. Before a region is reused,
+ * the CPU waits on the fence placed when it was last submitted,
+ * so nothing the GPU may still read gets overwritten.
+ */
+class UniformBufferRing
+{
+public:
+	// @frame_size bytes can be pushed each frame
+	UniformBufferRing(GLsizeiptr frame_size, int n_frames = 3);
+
+	UniformBufferRing()
+	{}
+
+	virtual ~UniformBufferRing()
+	{}
+
+	void destroy();
+
+	// Moves to the next region, waiting for the GPU if needed
+	void beginFrame();
+
+	// Fences the commands that read the current region
+	void endFrame();
+
+	// Copies @size bytes into the current region and returns their
+	// offset, aligned to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT.
+	// Aborts if the region is full
+	GLintptr push(void const* data, GLsizeiptr size);
+
+	template <typename T>
+	GLintptr push(T const& block)
+	{
+		return push(&block, sizeof(T));
+	}
+
+	// Pushes @block and binds it to @binding
+	template <typename T>
+	void pushAndBind(GLuint binding, T const& block)
+	{
+		bindRange(binding, push(block), sizeof(T));
+	}
+
+	void bindRange(GLuint binding, GLintptr offset, GLsizeiptr size);
+
+	GLuint getId() const;
+
+	// Bytes pushed in the current frame, including padding
+	GLsizeiptr getUsedSize() const;
+
+	// Frames in which the CPU had to wait for the GPU
+	unsigned getStalls() const;
+
+private:
+	GLuint id = 0u;
+	unsigned char* mapped = nullptr;
+
+	GLsizeiptr frame_size = 0;
+	GLint alignment = 0;
+
+	int n_frames = 0;
+	int current_frame = 0;
+	GLsizeiptr cursor = 0;
+
+	std::vector<GLsync> fences;
+	unsigned n_stalls = 0u;
+};
+
+#endif // UNIFORM_RING_HPP